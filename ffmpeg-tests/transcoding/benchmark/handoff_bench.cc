@@ -0,0 +1,152 @@
+// Decode-to-encode frame handoff: the previous `Encoding` queue (std::queue
+// under a mutex, producer sleep-polls 10ms while full, consumer `wait_for`
+// 50ms) against `SPSCQueue`. Decoder and encoder are simulated by spinning
+// for a given cost per frame, or sleeping on single core machines where the
+// two threads would compete for the core, so only the handoff differs between
+// runs. Reports end-to-end frames/sec and the latency from push to pop, which
+// includes waiting behind a full queue; with a small capacity the 10ms sleep
+// of the previous producer starves the encoder.
+//
+// Usage: handoff_bench [frames] [capacity]
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_queue.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Item {
+  int64_t seq = 0;
+  Clock::time_point push_time;
+};
+
+// what `Encoding::pushFrame`/`Encoding::run` did before
+class LegacyQueue {
+public:
+  explicit LegacyQueue(size_t capacity) : capacity_(capacity) {}
+
+  void Push(Item v) {
+    while (true) {
+      std::unique_lock<std::mutex> mtx(mtx_);
+      if (q_.size() >= capacity_) {
+        mtx.unlock();
+        using namespace std::chrono_literals;
+        std::this_thread::sleep_for(10ms);
+        continue;
+      }
+      q_.push(v);
+      break;
+    }
+    cv_.notify_one();
+  }
+
+  Item Pop() {
+    while (true) {
+      std::unique_lock<std::mutex> lk(mtx_);
+      if (q_.empty()) {
+        using namespace std::chrono_literals;
+        cv_.wait_for(lk, 50ms);
+      }
+      if (q_.empty()) {
+        continue;
+      }
+      auto v = q_.front();
+      q_.pop();
+      return v;
+    }
+  }
+
+private:
+  const size_t capacity_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::queue<Item> q_;
+};
+
+struct Scenario {
+  const char *name;
+  int decode_us;   // per frame
+  int burst;       // frames decoded back to back before `decode_us` * burst
+  int encode_us;   // per frame
+  int slow_every;  // every n-th frame encodes `slow_us` instead, 0 never
+  int slow_us;
+};
+
+static bool g_sleep = false;
+
+static void Spin(int us) {
+  auto end = Clock::now() + std::chrono::microseconds(us);
+  if (g_sleep) {
+    std::this_thread::sleep_until(end);
+    return;
+  }
+  while (Clock::now() < end) {
+  }
+}
+
+template <typename Queue>
+static void Run(const Scenario &s, int frames, size_t capacity,
+                const char *queue_name) {
+  Queue q(capacity);
+  std::vector<int64_t> latency_us;
+  latency_us.reserve(frames);
+
+  auto start = Clock::now();
+  std::thread producer([&] {
+    for (int i = 0; i < frames; ++i) {
+      if (i % s.burst == 0) {
+        Spin(s.decode_us * s.burst);
+      }
+      q.Push(Item{i, Clock::now()});
+    }
+  });
+  for (int i = 0; i < frames; ++i) {
+    auto item = q.Pop();
+    latency_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                             Clock::now() - item.push_time)
+                             .count());
+    bool slow = s.slow_every > 0 && item.seq % s.slow_every == 0;
+    Spin(slow ? s.slow_us : s.encode_us);
+  }
+  producer.join();
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::sort(latency_us.begin(), latency_us.end());
+  auto percentile = [&latency_us](double p) {
+    return latency_us[static_cast<size_t>(p * (latency_us.size() - 1))];
+  };
+  printf("%-16s %-7s %8.1f fps, latency p50 %6lld us, p99 %6lld us, max "
+         "%6lld us\n",
+         s.name, queue_name, frames / seconds,
+         static_cast<long long>(percentile(0.5)),
+         static_cast<long long>(percentile(0.99)),
+         static_cast<long long>(latency_us.back()));
+}
+
+int main(int argc, char *argv[]) {
+  int frames = argc > 1 ? atoi(argv[1]) : 600;
+  size_t capacity = argc > 2 ? atoi(argv[2]) : 60; // `max_cache_frames`
+
+  const Scenario scenarios[] = {
+      {"decoder-bound", 3000, 1, 2000, 0, 0},
+      {"encoder-bound", 1000, 1, 2000, 30, 20000},
+      {"bursty-decoder", 1500, 8, 1400, 0, 0},
+  };
+  g_sleep = std::thread::hardware_concurrency() < 2;
+  printf("%d frames, capacity %zu, %s work\n", frames, capacity,
+         g_sleep ? "sleeping" : "spinning");
+  for (auto &s : scenarios) {
+    Run<LegacyQueue>(s, frames, capacity, "legacy");
+    Run<SPSCQueue<Item>>(s, frames, capacity, "spsc");
+  }
+  return 0;
+}
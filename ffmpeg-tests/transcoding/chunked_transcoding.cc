@@ -0,0 +1,498 @@
+#include "chunked_transcoding.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "decoding.h"
+#include "encoding.h"
+#include "frame_pool.h"
+
+namespace {
+
+int IndexEntriesCount(AVStream *st) {
+#if LIBAVFORMAT_VERSION_MAJOR >= 59
+  return avformat_index_get_entries_count(st);
+#else
+  return st->nb_index_entries;
+#endif
+}
+
+const AVIndexEntry *IndexEntry(AVStream *st, int i) {
+#if LIBAVFORMAT_VERSION_MAJOR >= 59
+  return avformat_index_get_entry(st, i);
+#else
+  return &st->index_entries[i];
+#endif
+}
+
+// Pts of the first keyframe read from the index timestamp `ts`, which is the
+// dts for some formats, e.g. mp4, or from the current position if it's
+// AV_NOPTS_VALUE. In `kFundamentalTimeBase`.
+int64_t KeyframePts(AVFormatContext *ifmt_ctx, int stream_index, int64_t ts) {
+  if (ts != AV_NOPTS_VALUE &&
+      av_seek_frame(ifmt_ctx, stream_index, ts, AVSEEK_FLAG_BACKWARD) < 0) {
+    return AV_NOPTS_VALUE;
+  }
+
+  auto pkt = av_packet_alloc();
+  if (!pkt) {
+    return AV_NOPTS_VALUE;
+  }
+  int64_t pts = AV_NOPTS_VALUE;
+  while (av_read_frame(ifmt_ctx, pkt) >= 0) {
+    bool key = pkt->stream_index == stream_index &&
+               (pkt->flags & AV_PKT_FLAG_KEY) != 0;
+    if (key) {
+      pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    }
+    av_packet_unref(pkt);
+    if (key) {
+      break;
+    }
+  }
+  av_packet_free(&pkt);
+
+  if (pts == AV_NOPTS_VALUE) {
+    return AV_NOPTS_VALUE;
+  }
+  return av_rescale_q(pts, ifmt_ctx->streams[stream_index]->time_base,
+                      kFundamentalTimeBase);
+}
+
+// Reads the parts of one media type one after another, as packets of one
+// output stream. Each part is shifted so that its first packet is at its
+// `first_pts`, wherever the part's muxer put it.
+struct PartReader {
+  std::vector<const std::string *> files;
+  std::vector<int64_t> first_pts;
+  size_t next_part = 0;
+
+  AVFormatContext *ifmt_ctx = nullptr; // current part
+  int64_t offset = AV_NOPTS_VALUE;     // in the part's time base
+
+  AVFormatContext *ofmt_ctx = nullptr;
+  int out_index = -1;
+  AVPacket *pkt = nullptr; // next packet to write, in the output time base
+  bool eof = false;
+};
+
+int OpenNextPart(PartReader *r) {
+  auto &file = *r->files[r->next_part];
+  auto ret = avformat_open_input(&r->ifmt_ctx, file.c_str(), NULL, NULL);
+  if (ret < 0) {
+    av_log(NULL, AV_LOG_ERROR, "open part %s failed, err (%d)%s\n",
+           file.c_str(), ret, av_err2str(ret));
+    return ret;
+  }
+  if (r->ifmt_ctx->nb_streams != 1) {
+    av_log(NULL, AV_LOG_ERROR, "part %s has %u streams, expect 1\n",
+           file.c_str(), r->ifmt_ctx->nb_streams);
+    avformat_close_input(&r->ifmt_ctx);
+    return AVERROR_INVALIDDATA;
+  }
+  r->offset = AV_NOPTS_VALUE;
+  ++r->next_part;
+
+  if (r->out_index >= 0) {
+    // parameter sets of the output are the first part's
+    auto in = r->ifmt_ctx->streams[0]->codecpar;
+    auto out = r->ofmt_ctx->streams[r->out_index]->codecpar;
+    if (in->extradata_size != out->extradata_size ||
+        (in->extradata_size > 0 &&
+         memcmp(in->extradata, out->extradata, in->extradata_size) != 0)) {
+      av_log(NULL, AV_LOG_WARNING,
+             "part %s has other codec extradata than the first part\n",
+             file.c_str());
+    }
+  }
+  return AVERROR_OK;
+}
+
+// next packet into `r->pkt`, AVERROR_EOF after the last part
+int ReadPacket(PartReader *r) {
+  while (true) {
+    if (!r->ifmt_ctx) {
+      if (r->next_part == r->files.size()) {
+        r->eof = true;
+        return AVERROR_EOF;
+      }
+      auto ret = OpenNextPart(r);
+      if (ret < 0) {
+        return ret;
+      }
+    }
+
+    auto ret = av_read_frame(r->ifmt_ctx, r->pkt);
+    if (ret == AVERROR_EOF) {
+      avformat_close_input(&r->ifmt_ctx);
+      continue;
+    }
+    if (ret < 0) {
+      av_log(NULL, AV_LOG_ERROR, "read part %s failed, err (%d)%s\n",
+             r->files[r->next_part - 1]->c_str(), ret, av_err2str(ret));
+      return ret;
+    }
+
+    auto pkt = r->pkt;
+    auto in_st = r->ifmt_ctx->streams[0];
+    if (r->offset == AV_NOPTS_VALUE) {
+      // the first packet is the keyframe the part starts with
+      auto first = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+      r->offset = av_rescale_q(r->first_pts[r->next_part - 1],
+                               kFundamentalTimeBase, in_st->time_base) -
+                  first;
+    }
+    if (pkt->pts != AV_NOPTS_VALUE) {
+      pkt->pts += r->offset;
+    }
+    if (pkt->dts != AV_NOPTS_VALUE) {
+      pkt->dts += r->offset;
+    }
+    av_packet_rescale_ts(pkt, in_st->time_base,
+                         r->ofmt_ctx->streams[r->out_index]->time_base);
+    pkt->stream_index = r->out_index;
+    pkt->pos = -1;
+    return AVERROR_OK;
+  }
+}
+
+int64_t PacketTime(const AVPacket *pkt) {
+  return pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+}
+
+// interleaves the packets of all readers by time
+int Remux(AVFormatContext *ofmt_ctx, std::vector<PartReader> &readers) {
+  for (auto &r : readers) {
+    auto ret = ReadPacket(&r);
+    if (ret < 0 && ret != AVERROR_EOF) {
+      return ret;
+    }
+  }
+
+  while (true) {
+    PartReader *next = nullptr;
+    for (auto &r : readers) {
+      if (r.eof) {
+        continue;
+      }
+      if (!next ||
+          av_compare_ts(PacketTime(r.pkt),
+                        ofmt_ctx->streams[r.out_index]->time_base,
+                        PacketTime(next->pkt),
+                        ofmt_ctx->streams[next->out_index]->time_base) < 0) {
+        next = &r;
+      }
+    }
+    if (!next) {
+      break; // all parts written
+    }
+
+    auto ret = av_interleaved_write_frame(ofmt_ctx, next->pkt);
+    if (ret < 0) {
+      av_log(NULL, AV_LOG_ERROR,
+             "write stream %d packet dts %" PRId64 " failed, err (%d)%s\n",
+             next->out_index, next->pkt->dts, ret, av_err2str(ret));
+      return ret;
+    }
+    ret = ReadPacket(next);
+    if (ret < 0 && ret != AVERROR_EOF) {
+      return ret;
+    }
+  }
+
+  return av_write_trailer(ofmt_ctx);
+}
+
+} // namespace
+
+ChunkedTranscoding::ChunkedTranscoding(
+    const std::string &input_file, const std::string &output_file,
+    const std::shared_ptr<ConfigurationContext> config_ctx, int jobs)
+    : input_file_(input_file), output_file_(output_file),
+      jobs_(std::max(jobs, 1)),
+      config_ctx_(std::make_shared<ConfigurationContext>(
+          config_ctx ? *config_ctx : ConfigurationContext{})) {
+  if (config_ctx_->encoder_threads == 0) {
+    // the jobs share the cores
+    config_ctx_->encoder_threads =
+        std::max<int>(1, std::thread::hardware_concurrency() / jobs_);
+  }
+}
+
+int ChunkedTranscoding::Run() {
+  auto ret = split();
+  if (ret < 0) {
+    return ret;
+  }
+
+  std::atomic<size_t> next_part{0};
+  std::atomic<int> err{AVERROR_OK};
+  std::vector<std::thread> threads;
+  auto nb_threads = std::min<size_t>(jobs_, parts_.size());
+  for (size_t i = 0; i < nb_threads; ++i) {
+    threads.emplace_back([this, &next_part, &err] {
+      for (auto part = next_part++; part < parts_.size() && err == AVERROR_OK;
+           part = next_part++) {
+        auto ret = transcode(&parts_[part]);
+        if (ret < 0) {
+          err = ret;
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  ret = err;
+  if (ret == AVERROR_OK) {
+    ret = concat();
+  }
+  removeParts();
+  return ret;
+}
+
+int ChunkedTranscoding::split() {
+  AVFormatContext *ifmt_ctx = nullptr;
+  auto ret = avformat_open_input(&ifmt_ctx, input_file_.c_str(), NULL, NULL);
+  if (ret != 0) {
+    av_log(NULL, AV_LOG_ERROR, "open input failed, err: (%d)%s\n", ret,
+           av_err2str(ret));
+    return ret;
+  }
+  ret = avformat_find_stream_info(ifmt_ctx, NULL);
+  if (ret < 0) {
+    av_log(NULL, AV_LOG_ERROR, "find input stream info failed, err: (%d)%s\n",
+           ret, av_err2str(ret));
+    avformat_close_input(&ifmt_ctx);
+    return ret;
+  }
+
+  auto v = av_find_best_stream(ifmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+  if (v < 0) {
+    av_log(NULL, AV_LOG_ERROR, "no video stream to split at\n");
+    avformat_close_input(&ifmt_ctx);
+    return v;
+  }
+  auto a = av_find_best_stream(ifmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+  auto st = ifmt_ctx->streams[v];
+
+  std::vector<int64_t> starts; // keyframe pts of the segments
+  auto first_pts = KeyframePts(ifmt_ctx, v, AV_NOPTS_VALUE);
+  if (first_pts == AV_NOPTS_VALUE) {
+    av_log(NULL, AV_LOG_ERROR, "no video keyframe\n");
+    avformat_close_input(&ifmt_ctx);
+    return AVERROR_INVALIDDATA;
+  }
+  starts.push_back(first_pts);
+
+  auto nb_entries = IndexEntriesCount(st);
+  if (nb_entries < 2) {
+    av_log(NULL, AV_LOG_WARNING,
+           "no index of video stream %d, transcode in one segment\n", v);
+  } else {
+    // segments of about the same duration, at the keyframe at or before each
+    // target time
+    auto count = jobs_ * kSegmentsPerJob;
+    auto first = IndexEntry(st, 0)->timestamp;
+    auto last = IndexEntry(st, nb_entries - 1)->timestamp;
+    auto prev = first;
+    for (int k = 1; k < count; ++k) {
+      auto target = first + (last - first) * k / count;
+      auto i = av_index_search_timestamp(st, target, AVSEEK_FLAG_BACKWARD);
+      if (i < 0) {
+        continue;
+      }
+      auto ts = IndexEntry(st, i)->timestamp;
+      if (ts <= prev) {
+        continue; // no other keyframe since the previous segment
+      }
+      prev = ts;
+      auto pts = KeyframePts(ifmt_ctx, v, ts);
+      if (pts != AV_NOPTS_VALUE && pts > starts.back()) {
+        starts.push_back(pts);
+      }
+    }
+  }
+
+  // nut keeps the encoder time bases, no rounding of timestamps on the way
+  parts_.clear();
+  if (a >= 0) {
+    Part part;
+    part.file = output_file_ + ".audio.nut";
+    part.media_type = AVMEDIA_TYPE_AUDIO;
+    auto audio_st = ifmt_ctx->streams[a];
+    part.start = audio_st->start_time != AV_NOPTS_VALUE
+                     ? av_rescale_q(audio_st->start_time, audio_st->time_base,
+                                    kFundamentalTimeBase)
+                     : 0;
+    parts_.push_back(part); // `first_pts` once the encoder is open
+  }
+  for (size_t i = 0; i < starts.size(); ++i) {
+    Part part;
+    part.file = output_file_ + ".part" + std::to_string(i) + ".nut";
+    part.media_type = AVMEDIA_TYPE_VIDEO;
+    part.start = starts[i];
+    part.end = i + 1 < starts.size() ? starts[i + 1] : AV_NOPTS_VALUE;
+    part.first_pts = part.start;
+    parts_.push_back(part);
+  }
+  av_log(NULL, AV_LOG_INFO,
+         "[ChunkedTranscoding] %zu video segments%s, %d jobs\n", starts.size(),
+         a >= 0 ? " and audio" : "", jobs_);
+
+  avformat_close_input(&ifmt_ctx);
+  return AVERROR_OK;
+}
+
+int ChunkedTranscoding::transcode(Part *part) {
+  auto frame_pool = std::make_shared<FramePool>();
+  auto enc = std::make_unique<Encoding>(part->file, config_ctx_, frame_pool);
+  auto data_func = [&enc](int stream_index, const AVMediaType media_type,
+                          PooledFrame f) -> int {
+    return enc->SendFrame(std::move(f), media_type);
+  };
+  auto dec = std::make_unique<Decoding>(input_file_, std::move(data_func),
+                                       config_ctx_, frame_pool);
+  dec->SetMediaType(part->media_type);
+  if (part->media_type == AVMEDIA_TYPE_VIDEO) {
+    dec->SetRange(part->start, part->end);
+  }
+  auto ret = dec->Open();
+  if (ret != AVERROR_OK) {
+    return ret;
+  }
+  ret = enc->Open(dec->CodecContext(AVMEDIA_TYPE_VIDEO),
+                  dec->CodecContext(AVMEDIA_TYPE_AUDIO));
+  if (ret != AVERROR_OK) {
+    return ret;
+  }
+
+  if (part->media_type == AVMEDIA_TYPE_AUDIO) {
+    // the encoder outputs its priming samples before the first frame
+    auto enc_ctx = enc->CodecContext(AVMEDIA_TYPE_AUDIO);
+    part->first_pts =
+        part->start - av_rescale_q(enc_ctx->initial_padding,
+                                   AVRational{1, enc_ctx->sample_rate},
+                                   kFundamentalTimeBase);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  enc->RunAsync();
+  ret = dec->Run();
+  if (ret < 0) {
+    // the encoder only finishes after a flush
+    auto blank = av_frame_alloc();
+    if (blank) {
+      enc->SendFrame(blank, part->media_type);
+      av_frame_free(&blank);
+    }
+  }
+  enc->Join();
+  dec->Close();
+  enc->Close();
+
+  av_log(NULL, AV_LOG_INFO,
+         "[ChunkedTranscoding] %s [%" PRId64 ", %" PRId64 ") done in %.2f s\n",
+         part->file.c_str(), part->start, part->end,
+         std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+             .count());
+  return ret;
+}
+
+int ChunkedTranscoding::concat() {
+  AVFormatContext *ofmt_ctx = nullptr;
+  auto ret = avformat_alloc_output_context2(&ofmt_ctx, nullptr, nullptr,
+                                            output_file_.c_str());
+  if (ret < 0) {
+    av_log(NULL, AV_LOG_ERROR, "open output failed, err: (%d)%s\n", ret,
+           av_err2str(ret));
+    return ret;
+  }
+
+  // video first, as `Encoding` orders the streams
+  std::vector<PartReader> readers;
+  for (auto media_type : {AVMEDIA_TYPE_VIDEO, AVMEDIA_TYPE_AUDIO}) {
+    PartReader r;
+    for (auto &part : parts_) {
+      if (part.media_type == media_type) {
+        r.files.push_back(&part.file);
+        r.first_pts.push_back(part.first_pts);
+      }
+    }
+    if (!r.files.empty()) {
+      readers.push_back(std::move(r));
+    }
+  }
+
+  for (auto &r : readers) {
+    r.ofmt_ctx = ofmt_ctx;
+    r.pkt = av_packet_alloc();
+    if (!r.pkt) {
+      ret = AVERROR(ENOMEM);
+      break;
+    }
+    ret = OpenNextPart(&r);
+    if (ret < 0) {
+      break;
+    }
+    auto in_st = r.ifmt_ctx->streams[0];
+    auto out_st = avformat_new_stream(ofmt_ctx, NULL);
+    if (!out_st) {
+      ret = AVERROR(ENOMEM);
+      break;
+    }
+    ret = avcodec_parameters_copy(out_st->codecpar, in_st->codecpar);
+    if (ret < 0) {
+      break;
+    }
+    out_st->codecpar->codec_tag = 0; // the tag of the part's container
+    out_st->time_base = in_st->time_base;
+    r.out_index = out_st->index;
+  }
+
+  if (ret >= 0 && !(ofmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+    ret = avio_open(&ofmt_ctx->pb, output_file_.c_str(), AVIO_FLAG_WRITE);
+    if (ret < 0) {
+      av_log(NULL, AV_LOG_ERROR,
+             "Could not open output file '%s', err (%d)%s\n",
+             output_file_.c_str(), ret, av_err2str(ret));
+    }
+  }
+  if (ret >= 0) {
+    ret = avformat_write_header(ofmt_ctx, NULL);
+    if (ret < 0) {
+      av_log(NULL, AV_LOG_ERROR, "write header failed, err (%d)%s\n", ret,
+             av_err2str(ret));
+    }
+  }
+  if (ret >= 0) {
+    ret = Remux(ofmt_ctx, readers);
+  }
+
+  for (auto &r : readers) {
+    avformat_close_input(&r.ifmt_ctx);
+    av_packet_free(&r.pkt);
+  }
+  if (!(ofmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+    avio_closep(&ofmt_ctx->pb);
+  }
+  avformat_free_context(ofmt_ctx);
+
+  if (ret >= 0) {
+    av_log(NULL, AV_LOG_INFO, "[ChunkedTranscoding] concatenated %zu parts\n",
+           parts_.size());
+  }
+  return ret;
+}
+
+void ChunkedTranscoding::removeParts() {
+  for (auto &part : parts_) {
+    std::remove(part.file.c_str());
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "config_ctx.h"
+#include "libav_headers.h"
+
+// Transcodes one input on many cores. The input is split at video keyframes
+// found in the demuxer index, up to `jobs` segments are transcoded at a time,
+// each by its own `Decoding`/`Encoding` pair into a part file next to the
+// output, and the parts are remuxed one after another into the output without
+// re-encoding. Every part starts with the first frame of a fresh encoder, so
+// no GOP references across a boundary.
+// Audio isn't split but transcoded in one piece by a job of its own: an AAC
+// encoder starts with priming samples (`initial_padding`), every audio segment
+// would add them as a gap at its boundary.
+class ChunkedTranscoding {
+public:
+  ChunkedTranscoding() = delete;
+  ChunkedTranscoding(const ChunkedTranscoding &) = delete;
+  ChunkedTranscoding(ChunkedTranscoding &&) = delete;
+  ChunkedTranscoding(const std::string &input_file,
+                     const std::string &output_file,
+                     const std::shared_ptr<ConfigurationContext> config_ctx,
+                     int jobs);
+
+public:
+  int Run();
+
+  // segments per job, more but shorter segments balance the jobs better
+  const static int kSegmentsPerJob = 4;
+
+private:
+  struct Part {
+    std::string file;
+    AVMediaType media_type = AVMEDIA_TYPE_UNKNOWN;
+    // video segment, pts of its keyframes in `kFundamentalTimeBase`
+    int64_t start = AV_NOPTS_VALUE;
+    int64_t end = AV_NOPTS_VALUE; // AV_NOPTS_VALUE for the last one
+    // where the first packet belongs in the output, `kFundamentalTimeBase`
+    int64_t first_pts = AV_NOPTS_VALUE;
+  };
+
+private:
+  // fills `parts_`, audio first as the longest job
+  int split();
+  int transcode(Part *part);
+  // remuxes the parts into `output_file_`
+  int concat();
+  void removeParts();
+
+private:
+  std::vector<Part> parts_;
+
+  const std::string input_file_;
+  const std::string output_file_;
+  const int jobs_;
+
+  const std::shared_ptr<ConfigurationContext> config_ctx_{nullptr};
+};
@@ -16,9 +16,27 @@ struct ConfigurationContext {
   // hwaccel, suggest to enable it in such case.
   bool enable_cuda_frames_caching{false};
 
-  // How many decoded frames can be cached in memory or GPU memory,
-  // 0 means no limitation.
+  // How many decoded frames per output stream can be cached in memory or GPU
+  // memory, decoding blocks once it's reached. 0 means the default of
+  // `Encoding`.
   int max_cache_frames{0};
 
   std::string hw_encoder_name; // set hardware encoder name if expect to use
+
+  // Encoding output, e.g. a rendition of an ABR ladder. 0 keeps the source
+  // resolution or the encoder's default. Software frames that differ from
+  // `width`x`height` or the encoder's pixel format are converted by
+  // libswscale.
+  int width{0};
+  int height{0};
+  int64_t video_bit_rate{0};
+  int64_t video_max_rate{0}; // vbv, together with `video_buffer_size`
+  int video_buffer_size{0};  // in bits
+  int64_t audio_bit_rate{0}; // 0 means 192k
+  // max keyframe interval, closed GOPs if set. Keyframes are only at the same
+  // frames in every rendition if the frames sent are forced to be
+  // `AV_PICTURE_TYPE_I` every `gop_size` frames, see `Transcode` in main.cc.
+  int gop_size{0};
+  int scale_threads{0};      // swscale slice threads, 0 means auto
+  int encoder_threads{0};    // 0 means the encoder's default
 };
\ No newline at end of file
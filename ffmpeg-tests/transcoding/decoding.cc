@@ -138,6 +138,10 @@ int Decoding::Open() {
              av_get_media_type_string(stream->codecpar->codec_type));
       continue;
     }
+    if (media_type_ != AVMEDIA_TYPE_UNKNOWN &&
+        stream->codecpar->codec_type != media_type_) {
+      continue; // not wanted
+    }
 
     auto dec = avcodec_find_decoder(stream->codecpar->codec_id);
     if (!dec) {
@@ -225,6 +229,22 @@ int Decoding::Run() {
 int Decoding::run() {
   auto ret = AVERROR_OK;
 
+  if (range_start_ != AV_NOPTS_VALUE) {
+    // to the keyframe at or before, earlier frames are dropped once decoded
+    ret = av_seek_frame(ifmt_ctx_, -1,
+                        av_rescale_q(range_start_, kFundamentalTimeBase,
+                                     AVRational{1, AV_TIME_BASE}),
+                        AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+      av_log(NULL, AV_LOG_ERROR, "seek to %" PRId64 " failed, err (%d)%s\n",
+             range_start_, ret, av_err2str(ret));
+      if (error_callback_) {
+        error_callback_(ret);
+      }
+      return ret;
+    }
+  }
+
   while (true) {
     ret = av_read_frame(ifmt_ctx_, pkt_);
     if (ret < 0) {
@@ -241,7 +261,7 @@ int Decoding::run() {
     }
 
     int i = pkt_->stream_index;
-    if (!dec_ctx_[i].codec_ctx) {
+    if (!dec_ctx_[i].codec_ctx || dec_ctx_[i].range_done) {
       // av_log(NULL, AV_LOG_ERROR, "stream %d is not invalid\n", i);
       av_packet_unref(pkt_);
       continue; // ignored stream
@@ -250,6 +270,26 @@ int Decoding::run() {
     av_packet_rescale_ts(pkt_, ifmt_ctx_->streams[i]->time_base,
                          kFundamentalTimeBase); // convert to unified timebase
 
+    if (range_end_ != AV_NOPTS_VALUE) {
+      // dts never decreases and pts >= dts, so no later packet of this stream
+      // has a frame before `range_end_`
+      auto ts = pkt_->dts != AV_NOPTS_VALUE ? pkt_->dts : pkt_->pts;
+      if (ts != AV_NOPTS_VALUE && ts >= range_end_) {
+        dec_ctx_[i].range_done = true;
+        av_packet_unref(pkt_);
+        bool all_done = true;
+        for (auto j = 0; j < nb_streams_; ++j) {
+          if (dec_ctx_[j].codec_ctx && !dec_ctx_[j].range_done) {
+            all_done = false;
+          }
+        }
+        if (all_done) {
+          break; // flush
+        }
+        continue;
+      }
+    }
+
     av_log(NULL, AV_LOG_VERBOSE,
            "<decoding> stream %d type %s read packet pts %" PRId64
            ", dts %" PRId64 ", duration %" PRId64 ", time_base %d/%d\n",
@@ -366,6 +406,11 @@ int Decoding::receive_frames(int stream_index) {
     if (ret == AVERROR_OK) {
       dec_ctx.out_count++;
 
+      if (outOfRange(dec_ctx.frame->best_effort_timestamp)) {
+        av_frame_unref(dec_ctx.frame);
+        continue;
+      }
+
       if (dec_ctx.codec_ctx->codec_type == AVMEDIA_TYPE_VIDEO && config_ctx_ &&
           config_ctx_->hwaccel_device_type ==
               AV_HWDEVICE_TYPE_CUDA) { // hwaccel cuda
@@ -435,6 +480,16 @@ int Decoding::receive_frames(int stream_index) {
     if (data_callback_) {
       data_callback_(stream_index, dec_ctx.codec_ctx->codec_type,
                      dec_ctx.frame);
+    } else if (frame_callback_ && frame_pool_) {
+      auto f = frame_pool_->Get();
+      if (!f) {
+        av_log(NULL, AV_LOG_ERROR, "get frame from pool failed\n");
+        ret = AVERROR(ENOMEM);
+        break;
+      }
+      av_frame_move_ref(f.get(), dec_ctx.frame); // leaves dec_ctx.frame blank
+      frame_callback_(stream_index, dec_ctx.codec_ctx->codec_type,
+                      std::move(f));
     }
 
     av_frame_unref(dec_ctx.frame);
@@ -465,7 +520,8 @@ const AVCodecContext *Decoding::CodecContext(AVMediaType media_type) const {
   }
 
   for (int i = 0; i < nb_streams_; ++i) {
-    if (dec_ctx_[i].codec_ctx->codec_type == media_type) {
+    if (dec_ctx_[i].codec_ctx &&
+        dec_ctx_[i].codec_ctx->codec_type == media_type) {
       return dec_ctx_[i].codec_ctx;
     }
   }
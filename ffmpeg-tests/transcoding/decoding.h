@@ -3,14 +3,22 @@
 
 #include <cassert>
 #include <functional>
+#include <memory>
 #include <string>
 #include <thread>
 
 #include "config_ctx.h"
+#include "frame_pool.h"
 #include "libav_headers.h"
 
+// `f` is only valid during the call, it's unref'ed afterwards.
 using DataCallback = int(int stream_index, const AVMediaType media_type,
                          AVFrame *f);
+// Ownership transferring variant: the decoded frame is moved into a shell of
+// the `FramePool` given to `Decoding`, the callee keeps it as long as it likes.
+// A blank frame (no `buf[0]`) flushes as with `DataCallback`.
+using FrameCallback = int(int stream_index, const AVMediaType media_type,
+                          PooledFrame f);
 using ErrorCallback = int(int);
 
 class Decoding {
@@ -23,9 +31,27 @@ public:
            const std::shared_ptr<ConfigurationContext> config_ctx)
       : input_file_(input_file), data_callback_(std::move(data_callback)),
         config_ctx_(config_ctx) {}
+  Decoding(const std::string &input_file,
+           std::function<FrameCallback> frame_callback,
+           const std::shared_ptr<ConfigurationContext> config_ctx,
+           std::shared_ptr<FramePool> frame_pool)
+      : input_file_(input_file), frame_callback_(std::move(frame_callback)),
+        frame_pool_(std::move(frame_pool)), config_ctx_(config_ctx) {}
   ~Decoding();
 
 public:
+  // Decodes streams of `media_type` only, all A/V streams if it's
+  // AVMEDIA_TYPE_UNKNOWN. Set before `Open`.
+  void SetMediaType(AVMediaType media_type) { media_type_ = media_type; }
+  // Decodes only frames with pts in [start, end) in `kFundamentalTimeBase`,
+  // e.g. a segment between two keyframes, AV_NOPTS_VALUE leaves a side open.
+  // Reading starts at the keyframe at or before `start` and stops once every
+  // stream is past `end`. Set before `Run`/`RunAsync`.
+  void SetRange(int64_t start, int64_t end) {
+    range_start_ = start;
+    range_end_ = end;
+  }
+
   int Open();
   void Close();
 
@@ -52,8 +78,17 @@ private:
 
     int in_count;
     int out_count;
+
+    bool range_done; // read up to `range_end_`
   };
 
+  // whether frames of `pts` are outside of `SetRange`
+  bool outOfRange(int64_t pts) const {
+    return pts != AV_NOPTS_VALUE &&
+           ((range_start_ != AV_NOPTS_VALUE && pts < range_start_) ||
+            (range_end_ != AV_NOPTS_VALUE && pts >= range_end_));
+  }
+
 private:
   AVFormatContext *ifmt_ctx_{nullptr};
 
@@ -76,7 +111,13 @@ private:
   bool opened{false};
   std::thread t_;
 
+  AVMediaType media_type_{AVMEDIA_TYPE_UNKNOWN};
+  int64_t range_start_{AV_NOPTS_VALUE};
+  int64_t range_end_{AV_NOPTS_VALUE};
+
   std::function<DataCallback> data_callback_ = nullptr;
+  std::function<FrameCallback> frame_callback_ = nullptr;
+  std::shared_ptr<FramePool> frame_pool_{nullptr}; // for `frame_callback_`
   std::function<ErrorCallback> error_callback_ = nullptr;
 
   const std::string input_file_;
@@ -1,6 +1,25 @@
 
 #include "encoding.h"
 
+Encoding::Encoding(const std::string &output_file,
+                   const std::shared_ptr<ConfigurationContext> config_ctx,
+                   std::shared_ptr<FramePool> frame_pool)
+    : frame_pool_(std::move(frame_pool)), output_file_(output_file),
+      config_ctx_(config_ctx) {
+  if (!frame_pool_) {
+    frame_pool_ = std::make_shared<FramePool>();
+  }
+  int capacity = kDefaultQueueCapacity;
+  if (config_ctx_ && config_ctx_->max_cache_frames > 0) {
+    capacity = config_ctx_->max_cache_frames;
+  }
+  for (int i = 0; i < kMaxStreams; ++i) {
+    frame_queues_.push_back(
+        std::make_unique<SPSCQueue<AVFrameWithMediaType>>(capacity));
+  }
+  handoff_latency_us_.resize(kMaxStreams);
+}
+
 int Encoding::hw_encoder_init(AVCodecContext *ctx,
                               const enum AVHWDeviceType type) {
   int err = 0;
@@ -42,22 +61,23 @@ void Encoding::Close() { release(); }
 void Encoding::release() {
   Join();
 
-  if (!frame_queue_.empty()) {
-    assert(false);
-    while (!frame_queue_.empty()) {
-      auto f = frame_queue_.front();
-      frame_queue_.pop();
-
-      if (f.frame) {
-        av_frame_free(&f.frame);
-      }
+  for (auto &q : frame_queues_) {
+    AVFrameWithMediaType f;
+    while (q->TryPop(&f)) {
+      assert(false);
+      f.frame.reset(); // back to the pool
     }
   }
+  while (!packet_queue_.empty()) {
+    assert(false);
+    av_packet_free(&packet_queue_.front());
+    packet_queue_.pop();
+  }
 
   if (enc_ctx_) {
     for (auto i = 0; i < nb_streams_; ++i) {
-      avcodec_free_context(&enc_ctx_->codec_ctx);
-      av_packet_free(&enc_ctx_->pkt);
+      avcodec_free_context(&enc_ctx_[i].codec_ctx);
+      av_packet_free(&enc_ctx_[i].pkt);
     }
     av_free(enc_ctx_);
     enc_ctx_ = nullptr;
@@ -68,6 +88,9 @@ void Encoding::release() {
     av_buffer_unref(&hw_device_ctx_);
   }
 
+  sws_freeContext(sws_ctx_);
+  sws_ctx_ = nullptr;
+
   if (ofmt_ctx_) {
     if (!(ofmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
       avio_closep(&ofmt_ctx_->pb);
@@ -149,6 +172,50 @@ int Encoding::Open(const AVCodecContext *v_dec_ctx,
       enc_ctx->height = dec_ctx->height;
       enc_ctx->width = dec_ctx->width;
       enc_ctx->sample_aspect_ratio = dec_ctx->sample_aspect_ratio;
+      if (config_ctx_ && (config_ctx_->width > 0 || config_ctx_->height > 0)) {
+        if (!config_ctx_->hw_encoder_name.empty()) {
+          av_log(NULL, AV_LOG_ERROR, "scaling of hw frames is not supported\n");
+          release();
+          return AVERROR(ENOSYS);
+        }
+        // keeps the display aspect ratio if only one of them is set
+        int width = config_ctx_->width;
+        int height = config_ctx_->height;
+        if (width <= 0) {
+          width = av_rescale(dec_ctx->width, height, dec_ctx->height) & ~1;
+        } else if (height <= 0) {
+          height = av_rescale(dec_ctx->height, width, dec_ctx->width) & ~1;
+        }
+        enc_ctx->width = width;
+        enc_ctx->height = height;
+        if (enc_ctx->sample_aspect_ratio.num > 0) {
+          av_reduce(&enc_ctx->sample_aspect_ratio.num,
+                    &enc_ctx->sample_aspect_ratio.den,
+                    int64_t(dec_ctx->sample_aspect_ratio.num) *
+                        dec_ctx->width * enc_ctx->height,
+                    int64_t(dec_ctx->sample_aspect_ratio.den) *
+                        dec_ctx->height * enc_ctx->width,
+                    INT_MAX);
+        }
+      }
+      if (config_ctx_) {
+        if (config_ctx_->video_bit_rate > 0) {
+          enc_ctx->bit_rate = config_ctx_->video_bit_rate;
+        }
+        if (config_ctx_->video_max_rate > 0) {
+          enc_ctx->rc_max_rate = config_ctx_->video_max_rate;
+        }
+        if (config_ctx_->video_buffer_size > 0) {
+          enc_ctx->rc_buffer_size = config_ctx_->video_buffer_size;
+        }
+        if (config_ctx_->gop_size > 0) {
+          // only an upper bound of the keyframe interval, encoders still add
+          // keyframes at scene cuts. Renditions are aligned by the caller
+          // forcing `AV_PICTURE_TYPE_I` on every `gop_size`th frame.
+          enc_ctx->gop_size = config_ctx_->gop_size;
+          enc_ctx->flags |= AV_CODEC_FLAG_CLOSED_GOP;
+        }
+      }
 
       // set pix_fmt for software or hardware encoder
       if (config_ctx_ &&
@@ -183,6 +250,9 @@ int Encoding::Open(const AVCodecContext *v_dec_ctx,
              dec_ctx->framerate.num, dec_ctx->framerate.den);
     } else if (dec_ctx->codec_type == AVMEDIA_TYPE_AUDIO) {
       enc_ctx->bit_rate = 192000;
+      if (config_ctx_ && config_ctx_->audio_bit_rate > 0) {
+        enc_ctx->bit_rate = config_ctx_->audio_bit_rate;
+      }
       enc_ctx->sample_rate = dec_ctx->sample_rate;
       enc_ctx->sample_fmt = dec_ctx->sample_fmt;
       enc_ctx->channels = dec_ctx->channels;
@@ -195,7 +265,7 @@ int Encoding::Open(const AVCodecContext *v_dec_ctx,
       enc_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
     }
 
-    if (v_dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO && config_ctx_ &&
+    if (dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO && config_ctx_ &&
         !config_ctx_->hw_encoder_name.empty() &&
         config_ctx_->hwaccel_device_type !=
             AV_HWDEVICE_TYPE_NONE) { // init hardware encoder
@@ -206,6 +276,10 @@ int Encoding::Open(const AVCodecContext *v_dec_ctx,
       }
     }
 
+    if (config_ctx_ && config_ctx_->encoder_threads > 0) {
+      enc_ctx->thread_count = config_ctx_->encoder_threads;
+    }
+
     AVDictionary *opts = NULL;
     ret = avcodec_open2(enc_ctx, encoder, &opts);
     if (ret != 0) {
@@ -278,94 +352,126 @@ void Encoding::DumpInputFormat() const {
 }
 
 void Encoding::Join() {
-  if (!t_.joinable()) {
-    return;
+  for (auto &t : workers_) {
+    t.join();
+  }
+  workers_.clear();
+  if (mux_t_.joinable()) {
+    mux_t_.join();
   }
-  t_.join();
 }
 
 int Encoding::RunAsync() {
   if (!opened) {
     return AVERROR_OK;
   }
-  t_ = std::thread(&Encoding::run, this);
+  start_time_ = std::chrono::steady_clock::now();
+  for (int i = 0; i < nb_streams_; ++i) {
+    workers_.emplace_back(&Encoding::encode_stream, this, i);
+  }
+  mux_t_ = std::thread(&Encoding::mux, this);
 
   return AVERROR_OK;
 }
 
-int Encoding::pushFrame(const AVFrame *frame, AVMediaType media_type) {
-  while (true) {
-    std::unique_lock<std::mutex> mtx(mtx_);
-
-    if (config_ctx_ && config_ctx_->max_cache_frames > 0) {
-      if (frame_queue_.size() >= config_ctx_->max_cache_frames) {
-        mtx.unlock();
-        using namespace std::chrono_literals;
-        std::this_thread::sleep_for(10ms);
-        continue;
-      }
-    }
-
-    auto new_f = av_frame_clone(frame);
-    frame_queue_.emplace(AVFrameWithMediaType{new_f, media_type});
-    break;
+int Encoding::pushFrame(PooledFrame frame, AVMediaType media_type) {
+  int stream_index = findEncodingContextIndex(media_type);
+  if (stream_index < 0) {
+    return AVERROR_OK; // no such output stream, frame back to the pool
   }
-  cv_.notify_one();
-
+  // blocks while `max_cache_frames` are queued for this stream, until its
+  // worker pops one
+  frame_queues_[stream_index]->Push(AVFrameWithMediaType{
+      std::move(frame), media_type, std::chrono::steady_clock::now()});
   return AVERROR_OK;
 }
 
+void Encoding::pushPacket(AVPacket *pkt) {
+  {
+    // the mux thread never waits for a worker, so it always makes room
+    std::unique_lock<std::mutex> lk(pkt_mtx_);
+    pkt_full_cv_.wait(
+        lk, [this] { return packet_queue_.size() < kPacketQueueCapacity; });
+    packet_queue_.push(pkt);
+  }
+  pkt_cv_.notify_one();
+}
+
 int Encoding::SendFrame(const AVFrame *frame, AVMediaType media_type) {
   auto it = enabled_media_types_.find(media_type);
   if (it == enabled_media_types_.end()) {
     return AVERROR_OK; // ignore disabled media type
   }
-  return pushFrame(frame, media_type);
-}
 
-int Encoding::run() {
-  int finished_streams = 0;
-
-  auto last_time = std::chrono::high_resolution_clock::now();
+  auto new_f = frame_pool_->Get();
+  if (!new_f) {
+    return AVERROR(ENOMEM);
+  }
+  if (frame->buf[0]) { // blank frame for flushing stays blank
+    auto ret = av_frame_ref(new_f.get(), frame);
+    if (ret < 0) {
+      av_log(NULL, AV_LOG_ERROR, "ref frame failed, err (%d)%s\n", ret,
+             av_err2str(ret));
+      return ret;
+    }
+  }
+  return pushFrame(std::move(new_f), media_type);
+}
 
-  while (finished_streams != nb_streams_) {
-    AVFrameWithMediaType new_frame;
-    {
-      std::unique_lock<std::mutex> lk(mtx_);
-      if (frame_queue_.empty()) {
-        using namespace std::chrono_literals;
-        cv_.wait_for(lk, 50ms);
-      }
+int Encoding::SendFrame(PooledFrame frame, AVMediaType media_type) {
+  auto it = enabled_media_types_.find(media_type);
+  if (it == enabled_media_types_.end()) {
+    return AVERROR_OK; // ignore disabled media type, frame back to the pool
+  }
+  return pushFrame(std::move(frame), media_type);
+}
 
-      auto curr_time = std::chrono::high_resolution_clock::now();
-      auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                             curr_time - last_time)
-                             .count();
-      if (duration_ms >= 1000) {
-        av_log(NULL, AV_LOG_VERBOSE, "frame queue size %lu\n",
-               frame_queue_.size());
-        last_time = curr_time;
-      }
+int Encoding::encode_stream(int stream_index) {
+  auto &enc_ctx = enc_ctx_[stream_index];
+  auto &frame_queue = *frame_queues_[stream_index];
+  auto &latency_us = handoff_latency_us_[stream_index];
+  auto media_type = enc_ctx.codec_ctx->codec_type;
 
-      if (frame_queue_.empty()) {
-        continue; // maybe empty even if notified
-      }
+  auto last_time = std::chrono::steady_clock::now();
+  latency_us.Clear();
+  auto err = AVERROR_OK;
 
-      new_frame = frame_queue_.front();
-      frame_queue_.pop();
+  while (true) {
+    // blocks until the decoder pushes a frame of this stream, no polling
+    AVFrameWithMediaType new_frame = frame_queue.Pop();
+
+    auto curr_time = std::chrono::steady_clock::now();
+    latency_us.Add(std::chrono::duration_cast<std::chrono::microseconds>(
+                       curr_time - new_frame.push_time)
+                       .count());
+    auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           curr_time - last_time)
+                           .count();
+    if (duration_ms >= 1000) {
+      av_log(NULL, AV_LOG_VERBOSE, "stream %d frame queue size %zu\n",
+             stream_index, frame_queue.Size());
+      last_time = curr_time;
     }
 
-    int stream_index = findEncodingContextIndex(new_frame.media_type);
-    if (stream_index < 0) {
-      //   av_log(NULL, AV_LOG_WARNING, "ignore media type %s\n",
-      //          av_get_media_type_string(new_frame.media_type));
-      if (new_frame.frame) {
-        av_frame_free(&new_frame.frame);
+    if (new_frame.frame && !new_frame.frame->buf[0]) {
+      new_frame.frame.reset(); // blank frame, flush the encoder
+    }
+    bool flushing = !new_frame.frame;
+    if (err != AVERROR_OK) {
+      // failed, still drain until the flush so the decoder never blocks
+      if (flushing) {
+        break;
       }
       continue;
     }
-    auto &enc_ctx = enc_ctx_[stream_index];
 
+    if (new_frame.frame && media_type == AVMEDIA_TYPE_VIDEO) {
+      auto ret = scale(enc_ctx, new_frame.frame);
+      if (ret < 0) {
+        err = ret;
+        continue;
+      }
+    }
     if (new_frame.frame) { // convert to encoder time base,
                            // nvenc may output dts<pts without this
       new_frame.frame->pts =
@@ -379,21 +485,20 @@ int Encoding::run() {
                        enc_ctx.codec_ctx->time_base);
     }
 
-    auto ret = avcodec_send_frame(enc_ctx.codec_ctx, new_frame.frame);
+    auto ret = avcodec_send_frame(enc_ctx.codec_ctx, new_frame.frame.get());
     if (new_frame.frame) {
-      if (new_frame.frame->buf[0]) {
-        enc_ctx.in_count++; // ignore blank frame
-      }
-
-      av_frame_free(&new_frame.frame);
+      enc_ctx.in_count++;
+      new_frame.frame.reset(); // back to the pool
     }
     if (ret < 0) {
-      av_log(NULL, AV_LOG_WARNING, "send frame failed, err (%d)%s\n", ret,
+      av_log(NULL, AV_LOG_WARNING,
+             "stream %d send frame failed, err (%d)%s\n", stream_index, ret,
              av_err2str(ret));
-      //   if (error_callback_) {
-      //     error_callback_(ret);
-      //   }
-      return ret;
+      err = ret;
+      if (flushing) {
+        break;
+      }
+      continue;
     }
 
     ret = receive_packets(stream_index, enc_ctx);
@@ -405,25 +510,75 @@ int Encoding::run() {
                "fill in "
                "more data and try "
                "again later\n",
-               stream_index, av_get_media_type_string(new_frame.media_type),
+               stream_index, av_get_media_type_string(media_type),
                enc_ctx.in_count);
       }
     } else if (ret == AVERROR_EOF) {
       av_log(NULL, AV_LOG_INFO,
              "[Encoding] stream %d type %s encoder has been flushed\n",
-             stream_index, av_get_media_type_string(new_frame.media_type));
-      ++finished_streams;
-      continue;
+             stream_index, av_get_media_type_string(media_type));
+      break;
     } else {
       av_log(NULL, AV_LOG_ERROR,
              "stream %d receive frame failed unexpectly, err (%d)%s\n",
              stream_index, ret, av_err2str(ret));
-      //   if (error_callback_) {
-      //     error_callback_(ret);
-      //   }
-      return ret;
+      err = ret;
+      if (flushing) {
+        break;
+      }
     }
   }
+  pushPacket(nullptr); // this stream is done
+
+  if (latency_us.Count() > 0) {
+    // time frames spent in the queue, i.e. decoded until picked up
+    av_log(NULL, AV_LOG_INFO,
+           "[Encoding] stream %d type %s frames %" PRIu64
+           ", handoff latency p50 %" PRId64 " us, p99 %" PRId64
+           " us, max %" PRId64 " us\n",
+           stream_index, av_get_media_type_string(media_type),
+           latency_us.Count(), latency_us.Percentile(0.5),
+           latency_us.Percentile(0.99), latency_us.Max());
+  }
+
+  return err;
+}
+
+int Encoding::mux() {
+  int finished_streams = 0;
+  auto err = AVERROR_OK;
+
+  std::queue<AVPacket *> packets;
+  while (finished_streams != nb_streams_) {
+    {
+      // take everything the workers queued so far at once
+      std::unique_lock<std::mutex> lk(pkt_mtx_);
+      pkt_cv_.wait(lk, [this] { return !packet_queue_.empty(); });
+      std::swap(packets, packet_queue_);
+    }
+    pkt_full_cv_.notify_all();
+
+    for (; !packets.empty(); packets.pop()) {
+      auto pkt = packets.front();
+      if (!pkt) {
+        ++finished_streams;
+        continue;
+      }
+      if (err == AVERROR_OK) {
+        /* mux encoded frame */
+        err = av_interleaved_write_frame(ofmt_ctx_, pkt);
+        if (err < 0) {
+          av_log(NULL, AV_LOG_ERROR,
+                 "[Encoding] stream %d write frame failed, err (%d)%s\n",
+                 pkt->stream_index, err, av_err2str(err));
+        }
+      }
+      av_packet_free(&pkt); // drop the rest after a failure
+    }
+  }
+  if (err != AVERROR_OK) {
+    return err;
+  }
 
   auto ret = av_write_trailer(ofmt_ctx_);
   if (ret != AVERROR_OK) {
@@ -432,21 +587,104 @@ int Encoding::run() {
     return ret;
   }
 
-  // statistics
+  // statistics, all workers are done
+  auto seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start_time_)
+                     .count();
   for (auto i = 0; i < nb_streams_; i++) {
     if (!enc_ctx_[i].codec_ctx) {
       continue;
     }
     av_log(NULL, AV_LOG_INFO,
-           "[Encoding] stream %d type %s total read frames %d, encoded "
-           "packets %d\n",
-           i, av_get_media_type_string(enc_ctx_[i].codec_ctx->codec_type),
-           enc_ctx_[i].in_count, enc_ctx_[i].out_count);
+           "[Encoding] %s stream %d type %s total read frames %d, encoded "
+           "packets %d, %.1f frames/s\n",
+           output_file_.c_str(), i,
+           av_get_media_type_string(enc_ctx_[i].codec_ctx->codec_type),
+           enc_ctx_[i].in_count, enc_ctx_[i].out_count,
+           enc_ctx_[i].in_count / seconds);
   }
 
   return AVERROR_OK;
 }
 
+int Encoding::scale(const EncodingContext &enc_ctx, PooledFrame &frame) {
+  auto codec_ctx = enc_ctx.codec_ctx;
+  if (frame->hw_frames_ctx ||
+      (frame->width == codec_ctx->width && frame->height == codec_ctx->height &&
+       frame->format == codec_ctx->pix_fmt)) {
+    return AVERROR_OK; // as is
+  }
+
+  if (!sws_ctx_ || frame->width != sws_src_width_ ||
+      frame->height != sws_src_height_ || frame->format != sws_src_format_) {
+    sws_freeContext(sws_ctx_);
+    sws_ctx_ = sws_alloc_context();
+    if (!sws_ctx_) {
+      return AVERROR(ENOMEM);
+    }
+    av_opt_set_int(sws_ctx_, "srcw", frame->width, 0);
+    av_opt_set_int(sws_ctx_, "srch", frame->height, 0);
+    av_opt_set_int(sws_ctx_, "src_format", frame->format, 0);
+    av_opt_set_int(sws_ctx_, "dstw", codec_ctx->width, 0);
+    av_opt_set_int(sws_ctx_, "dsth", codec_ctx->height, 0);
+    av_opt_set_int(sws_ctx_, "dst_format", codec_ctx->pix_fmt, 0);
+    av_opt_set_int(sws_ctx_, "sws_flags", SWS_BICUBIC, 0);
+#if LIBSWSCALE_VERSION_MAJOR >= 6
+    // slices of a frame are scaled in parallel
+    av_opt_set_int(sws_ctx_, "threads",
+                   config_ctx_ ? config_ctx_->scale_threads : 0, 0);
+#endif
+    auto ret = sws_init_context(sws_ctx_, nullptr, nullptr);
+    if (ret < 0) {
+      av_log(NULL, AV_LOG_ERROR,
+             "init scaler %dx%d %d -> %dx%d %d failed, err (%d)%s\n",
+             frame->width, frame->height, frame->format, codec_ctx->width,
+             codec_ctx->height, codec_ctx->pix_fmt, ret, av_err2str(ret));
+      sws_freeContext(sws_ctx_);
+      sws_ctx_ = nullptr;
+      return ret;
+    }
+    sws_src_width_ = frame->width;
+    sws_src_height_ = frame->height;
+    sws_src_format_ = frame->format;
+  }
+
+  auto scaled = frame_pool_->Get();
+  if (!scaled) {
+    return AVERROR(ENOMEM);
+  }
+  scaled->width = codec_ctx->width;
+  scaled->height = codec_ctx->height;
+  scaled->format = codec_ctx->pix_fmt;
+  auto ret = av_frame_get_buffer(scaled.get(), 0);
+  if (ret >= 0) {
+    ret = av_frame_copy_props(scaled.get(), frame.get());
+  }
+  if (ret >= 0) {
+#if LIBSWSCALE_VERSION_MAJOR >= 6
+    ret = sws_scale_frame(sws_ctx_, scaled.get(), frame.get());
+#else
+    ret = sws_scale(sws_ctx_, frame->data, frame->linesize, 0, frame->height,
+                    scaled->data, scaled->linesize);
+#endif
+  }
+  if (ret < 0) {
+    av_log(NULL, AV_LOG_ERROR, "scale frame failed, err (%d)%s\n", ret,
+           av_err2str(ret));
+    return ret;
+  }
+  frame = std::move(scaled); // the source frame back to the pool
+  return AVERROR_OK;
+}
+
+const AVCodecContext *Encoding::CodecContext(AVMediaType media_type) const {
+  int stream_index = findEncodingContextIndex(media_type);
+  if (stream_index < 0) {
+    return nullptr;
+  }
+  return enc_ctx_[stream_index].codec_ctx;
+}
+
 int Encoding::findEncodingContextIndex(AVMediaType media_type) const {
   if (!enc_ctx_) {
     return -1;
@@ -495,10 +733,15 @@ int Encoding::receive_packets(int stream_index, EncodingContext &enc_ctx) {
 #endif
     );
 
-    /* mux encoded frame */
-    ret = av_interleaved_write_frame(ofmt_ctx_, enc_ctx.pkt);
-
-    av_packet_unref(enc_ctx.pkt);
+    /* hand the encoded frame to the mux thread */
+    auto pkt = av_packet_alloc();
+    if (!pkt) {
+      av_packet_unref(enc_ctx.pkt);
+      ret = AVERROR(ENOMEM);
+      break;
+    }
+    av_packet_move_ref(pkt, enc_ctx.pkt);
+    pushPacket(pkt);
 
   } while (ret == AVERROR_OK);
 
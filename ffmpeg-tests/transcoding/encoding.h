@@ -1,24 +1,39 @@
 
 
 #include <cassert>
+#include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <set>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "config_ctx.h"
+#include "frame_pool.h"
+#include "latency_histogram.h"
 #include "libav_headers.h"
-
+#include "spsc_queue.h"
+
+// Encodes every output stream on its own worker thread, fed by its own frame
+// queue, so a slow video frame doesn't hold up audio and vice versa. Encoded
+// packets of all workers go through one bounded packet queue to a mux thread,
+// the only one calling `av_interleaved_write_frame`, which interleaves them.
+// Workers block while the packet queue is full, i.e. a slow output holds up
+// encoding instead of buffering packets without limit.
 class Encoding {
 public:
   Encoding() = delete;
   Encoding(const Encoding &) = delete;
   Encoding(Encoding &&) = delete;
+  // Queued frames are kept in shells of `frame_pool`, share it with
+  // `Decoding` to hand frames over without any allocation. A private pool is
+  // used if it's nullptr.
   Encoding(const std::string &output_file,
-           const std::shared_ptr<ConfigurationContext> config_ctx)
-      : output_file_(output_file), config_ctx_(config_ctx) {}
+           const std::shared_ptr<ConfigurationContext> config_ctx,
+           std::shared_ptr<FramePool> frame_pool = nullptr);
   ~Encoding();
 
 public:
@@ -29,9 +44,14 @@ public:
   int RunAsync();
   void Join();
 
+  // references `frame`
   int SendFrame(const AVFrame *frame, AVMediaType media_type);
+  // takes over `frame`, no reference counting or allocation
+  int SendFrame(PooledFrame frame, AVMediaType media_type);
 
   void DumpInputFormat() const;
+  // opened encoder, e.g. for its `initial_padding`
+  const AVCodecContext *CodecContext(AVMediaType media_type) const;
 
 private:
   struct EncodingContext {
@@ -43,20 +63,37 @@ private:
   };
 
   struct AVFrameWithMediaType {
-    AVFrame *frame = nullptr;
+    PooledFrame frame; // blank for flushing
     AVMediaType media_type = AVMEDIA_TYPE_UNKNOWN;
+    std::chrono::steady_clock::time_point push_time; // handoff latency
   };
 
+  // queue capacity per stream if `max_cache_frames` is 0, the ring is always
+  // bounded
+  const static int kDefaultQueueCapacity = 256;
+  // packets of all workers waiting for the mux thread
+  const static size_t kPacketQueueCapacity = 256;
+
 private:
   void release();
 
-  int run();
+  // worker of one output stream
+  int encode_stream(int stream_index);
+  // writes packets of all streams, then the trailer
+  int mux();
+
+  // converts `frame` to the size and pixel format of the video encoder, on
+  // the video worker
+  int scale(const EncodingContext &enc_ctx, PooledFrame &frame);
 
-  int pushFrame(const AVFrame *frame, AVMediaType media_type);
+  int pushFrame(PooledFrame frame, AVMediaType media_type);
+  // nullptr: `stream_index` has been flushed. Blocks while the packet queue
+  // is full.
+  void pushPacket(AVPacket *pkt);
 
   int findEncodingContextIndex(AVMediaType media_type) const;
 
-  // receive all packets on a stream
+  // receive all packets on a stream and pass them to the mux thread
   int receive_packets(int stream_index, EncodingContext &enc_ctx);
 
 private:
@@ -72,13 +109,28 @@ private:
   int hw_encoder_init(AVCodecContext *ctx, const enum AVHWDeviceType type);
   AVBufferRef *hw_device_ctx_{nullptr};
 
+  // for scaling on the video worker, recreated if the source changes
+  SwsContext *sws_ctx_{nullptr};
+  int sws_src_width_{0};
+  int sws_src_height_{0};
+  int sws_src_format_{-1};
+
 private:
   bool opened{false};
-  std::thread t_;
-
-  std::mutex mtx_;
-  std::condition_variable cv_;
-  std::queue<AVFrameWithMediaType> frame_queue_;
+  std::vector<std::thread> workers_; // per stream
+  std::thread mux_t_;
+  std::chrono::steady_clock::time_point start_time_;
+
+  std::shared_ptr<FramePool> frame_pool_; // outlives `frame_queues_`
+  // decoding thread -> worker per stream, `kMaxStreams` long
+  std::vector<std::unique_ptr<SPSCQueue<AVFrameWithMediaType>>> frame_queues_;
+  std::vector<LatencyHistogram> handoff_latency_us_; // per worker
+
+  // workers -> mux thread, at most `kPacketQueueCapacity` packets
+  std::mutex pkt_mtx_;
+  std::condition_variable pkt_cv_;      // not empty
+  std::condition_variable pkt_full_cv_; // not full
+  std::queue<AVPacket *> packet_queue_;
 
   //   std::function<DataCallback> data_callback_ = nullptr;
   //   std::function<ErrorCallback> error_callback_ = nullptr;
@@ -0,0 +1,48 @@
+#include "frame_pool.h"
+
+void FrameRecycler::operator()(AVFrame *f) const {
+  if (pool) {
+    pool->put(f);
+  } else {
+    av_frame_free(&f);
+  }
+}
+
+FramePool::~FramePool() {
+  for (auto f : free_) {
+    av_frame_free(&f);
+  }
+  free_.clear();
+}
+
+PooledFrame FramePool::Get() {
+  ++gets_;
+  AVFrame *f = nullptr;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!free_.empty()) {
+      f = free_.back();
+      free_.pop_back();
+    }
+  }
+  if (!f) {
+    f = av_frame_alloc();
+    if (!f) {
+      return PooledFrame(nullptr, FrameRecycler{this});
+    }
+    ++allocated_;
+  }
+  return PooledFrame(f, FrameRecycler{this});
+}
+
+void FramePool::put(AVFrame *f) {
+  av_frame_unref(f); // drop the data references right away, outside the lock
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (free_.size() < kMaxFreeFrames) {
+      free_.push_back(f);
+      return;
+    }
+  }
+  av_frame_free(&f);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "libav_headers.h"
+
+class FramePool;
+
+// Returns the frame to its pool when a `PooledFrame` goes out of scope.
+struct FrameRecycler {
+  FramePool *pool = nullptr;
+  void operator()(AVFrame *f) const;
+};
+
+// An `AVFrame` shell borrowed from a `FramePool`, the pool has to outlive it.
+using PooledFrame = std::unique_ptr<AVFrame, FrameRecycler>;
+
+// Recycles `AVFrame` shells, i.e. the struct without data, between threads.
+// Frames are handed over with `av_frame_move_ref` into a shell from `Get` and
+// unref'ed when it's returned, so after warming up neither side allocates an
+// `AVFrame` per frame any more. Thread safe.
+class FramePool {
+public:
+  FramePool() = default;
+  FramePool(const FramePool &) = delete;
+  FramePool(FramePool &&) = delete;
+  ~FramePool();
+
+public:
+  // blank shell, nullptr if allocation failed
+  PooledFrame Get();
+
+  uint64_t allocated() const { return allocated_; } // av_frame_alloc calls
+  uint64_t gets() const { return gets_; }
+
+private:
+  friend struct FrameRecycler;
+  void put(AVFrame *f);
+
+private:
+  // shells kept for reuse, more are freed, well above any queue depth
+  const static size_t kMaxFreeFrames = 1024;
+
+  std::mutex mtx_;
+  std::vector<AVFrame *> free_;
+
+  std::atomic<uint64_t> allocated_{0};
+  std::atomic<uint64_t> gets_{0};
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// Fixed-size histogram of non-negative values, e.g. latencies in us, so that
+// percentiles of arbitrarily long runs take no memory per value.
+// Values below 8 are exact, larger ones are bucketed by their power of 2
+// split into 8 linear sub-buckets, i.e. a percentile is the upper bound of
+// its bucket and at most 12.5% above the exact value. The max is exact.
+// Not thread-safe.
+class LatencyHistogram {
+public:
+  void Add(int64_t v) {
+    v = std::max<int64_t>(v, 0);
+    ++buckets_[bucket(v)];
+    ++count_;
+    max_ = std::max(max_, v);
+  }
+
+  void Clear() { *this = LatencyHistogram(); }
+
+  uint64_t Count() const { return count_; }
+  int64_t Max() const { return max_; }
+
+  // 0 <= p <= 1, 0 if empty
+  int64_t Percentile(double p) const {
+    if (count_ == 0) {
+      return 0;
+    }
+    auto rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(p * static_cast<double>(count_) + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        return std::min(upperBound(i), max_);
+      }
+    }
+    return max_;
+  }
+
+private:
+  const static int kSubBits = 3;
+  const static int kSubBuckets = 1 << kSubBits;
+  // exact values, then 8 sub-buckets for every shift up to 2^62
+  const static int kBuckets = (64 - kSubBits) * kSubBuckets;
+
+  static int bucket(int64_t v) {
+    if (v < kSubBuckets) {
+      return static_cast<int>(v);
+    }
+    int shift = 0;
+    while ((v >> shift) >= 2 * kSubBuckets) {
+      ++shift;
+    }
+    return (shift + 1) * kSubBuckets +
+           static_cast<int>((v >> shift) & (kSubBuckets - 1));
+  }
+
+  static int64_t upperBound(int index) {
+    if (index < kSubBuckets) {
+      return index;
+    }
+    int shift = index / kSubBuckets - 1;
+    int64_t lower = static_cast<int64_t>(kSubBuckets + index % kSubBuckets)
+                    << shift;
+    return lower + (int64_t(1) << shift) - 1;
+  }
+
+private:
+  uint64_t buckets_[kBuckets] = {};
+  uint64_t count_ = 0;
+  int64_t max_ = 0;
+};
@@ -6,6 +6,8 @@ extern "C" {
 #include "libavcodec/avcodec.h"
 #include "libavformat/avformat.h"
 #include "libavutil/avutil.h"
+#include "libavutil/opt.h"
+#include "libswscale/swscale.h"
 }
 
 constexpr static int AVERROR_OK = 0;
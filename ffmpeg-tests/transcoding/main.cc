@@ -1,36 +1,136 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "chunked_transcoding.h"
 #include "config_ctx.h"
 #include "decoding.h"
 #include "encoding.h"
+#include "frame_pool.h"
 
-int main(int argc, char *argv[]) {
-  av_log_set_level(AV_LOG_INFO);
-  if (argc != 3) {
-    av_log(NULL, AV_LOG_ERROR, "Usage: %s <input file> <output file>\n",
-           argv[0]);
-    return -1;
+// a rung of the ABR ladder, the width follows the source aspect ratio
+struct Rendition {
+  int height;
+  int64_t video_bit_rate;
+  int64_t audio_bit_rate;
+};
+
+const Rendition kLadder[] = {
+    {1080, 5000000, 192000}, {720, 3000000, 128000}, {540, 2000000, 128000},
+    {480, 1200000, 96000},   {360, 800000, 96000},   {240, 400000, 64000},
+};
+const int kLadderGopSeconds = 2;
+
+struct Output {
+  std::string url;
+  std::shared_ptr<ConfigurationContext> config_ctx;
+};
+
+// user + system time of all threads
+static double ProcessCpuSeconds() {
+#ifdef _WIN32
+  FILETIME creation, exit, kernel, user;
+  GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+  auto to_seconds = [](const FILETIME &t) {
+    return ((uint64_t(t.dwHighDateTime) << 32) | t.dwLowDateTime) * 1e-7;
+  };
+  return to_seconds(kernel) + to_seconds(user);
+#else
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+// out.mp4 -> out_720p.mp4
+static std::string RenditionUrl(const std::string &url, int height) {
+  auto dot = url.find_last_of('.');
+  auto slash = url.find_last_of("/\\");
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    dot = url.size();
   }
-  const char *input_url = argv[1];
-  const char *output_url = argv[2];
-  av_log(NULL, AV_LOG_INFO, "transcoding task: %s -> %s\n", input_url,
-         output_url);
+  return url.substr(0, dot) + "_" + std::to_string(height) + "p" +
+         url.substr(dot);
+}
 
-  // configuration
-  std::shared_ptr<ConfigurationContext> config_ctx =
-      std::make_shared<ConfigurationContext>();
-  // config_ctx->hwaccel_device_type = AV_HWDEVICE_TYPE_CUDA;
-  // config_ctx->hwaccel_output_format_cuda = true;
-  // config_ctx->hw_encoder_name = "h264_nvenc";
-  // config_ctx->enable_cuda_frames_caching = true;
-  config_ctx->max_cache_frames = 60;
+// Rungs of `kLadder` up to the source height, at least the lowest one. All
+// renditions have the same `gop_size`, `Transcode` forces keyframes by it so
+// that they are at the same frames and players can switch between them.
+static std::vector<Output>
+Ladder(const std::string &url, const AVCodecContext *v_dec_ctx,
+       const std::shared_ptr<ConfigurationContext> &config_ctx) {
+  std::vector<const Rendition *> rungs;
+  for (auto &r : kLadder) {
+    if (!v_dec_ctx || r.height <= v_dec_ctx->height) {
+      rungs.push_back(&r);
+    }
+  }
+  if (rungs.empty()) {
+    rungs.push_back(&kLadder[std::size(kLadder) - 1]);
+  }
+
+  int gop_size = 0;
+  if (v_dec_ctx && v_dec_ctx->framerate.num > 0) {
+    gop_size = static_cast<int>(av_q2d(v_dec_ctx->framerate) *
+                                    kLadderGopSeconds +
+                                0.5);
+  }
+  // renditions scale concurrently, share the cores among them
+  int scale_threads = std::max<int>(
+      1, std::thread::hardware_concurrency() / static_cast<int>(rungs.size()));
+
+  std::vector<Output> outputs;
+  for (auto r : rungs) {
+    auto c = std::make_shared<ConfigurationContext>(*config_ctx);
+    c->height = r->height;
+    c->video_bit_rate = r->video_bit_rate;
+    c->video_max_rate = r->video_bit_rate * 3 / 2;
+    c->video_buffer_size = static_cast<int>(r->video_bit_rate * 2);
+    c->audio_bit_rate = r->audio_bit_rate;
+    c->gop_size = gop_size;
+    c->scale_threads = scale_threads;
+    outputs.push_back(Output{RenditionUrl(url, r->height), c});
+  }
+  return outputs;
+}
 
-  auto enc = std::make_unique<Encoding>(output_url, config_ctx);
+// Decodes `input_url` once and fans every frame out to the `Encoding` of each
+// output given by `make_outputs`. All but the last output reference the
+// decoded frame, the last one takes it over, the picture is never copied.
+static int Transcode(
+    const char *input_url,
+    const std::shared_ptr<ConfigurationContext> &config_ctx,
+    const std::function<std::vector<Output>(const AVCodecContext *v_dec_ctx)>
+        &make_outputs) {
+  // frames are moved from the decoder into shells of this pool and recycled
+  // by the encoders, i.e. no AVFrame allocation per frame
+  auto frame_pool = std::make_shared<FramePool>();
+  std::vector<std::unique_ptr<Encoding>> encs;
 
   int64_t total_decoded_video = 0, total_decoded_audio = 0;
-  auto data_func = [&total_decoded_video, &total_decoded_audio,
-                    &enc](int stream_index, const AVMediaType media_type,
-                          AVFrame *f) -> int {
+  // Keyframes of the renditions are aligned by forcing them on the decoded
+  // frame before the fan-out rather than relying on the encoders: x264 clamps
+  // `keyint_min` to half the GOP and still adds keyframes at scene cuts, and
+  // hardware encoders have options of their own.
+  int gop_size = 0;
+  auto data_func = [&total_decoded_video, &total_decoded_audio, &gop_size,
+                    &encs](int stream_index, const AVMediaType media_type,
+                           PooledFrame f) -> int {
     assert(f);
     if (!f->buf[0]) {
       av_log(NULL, AV_LOG_INFO,
@@ -51,6 +151,12 @@ int main(int argc, char *argv[]) {
                0, 0
 #endif
         );
+        if (gop_size > 0) {
+          // the source picture type would force keyframes as well
+          f->pict_type = total_decoded_video % gop_size == 0
+                             ? AV_PICTURE_TYPE_I
+                             : AV_PICTURE_TYPE_NONE;
+        }
         ++total_decoded_video;
       } else if (media_type == AVMEDIA_TYPE_AUDIO) {
         av_log(NULL, AV_LOG_VERBOSE,
@@ -61,7 +167,10 @@ int main(int argc, char *argv[]) {
       // ignore other types
     }
 
-    enc->SendFrame(f, media_type);
+    for (size_t i = 0; i + 1 < encs.size(); ++i) {
+      encs[i]->SendFrame(f.get(), media_type); // shares the buffers
+    }
+    encs.back()->SendFrame(std::move(f), media_type);
 
     return 0;
   };
@@ -71,8 +180,8 @@ int main(int argc, char *argv[]) {
     return 0;
   };
 
-  auto dec =
-      std::make_unique<Decoding>(input_url, std::move(data_func), config_ctx);
+  auto dec = std::make_unique<Decoding>(input_url, std::move(data_func),
+                                       config_ctx, frame_pool);
   auto ret = dec->Open();
   if (ret != AVERROR_OK) {
     return ret;
@@ -80,25 +189,133 @@ int main(int argc, char *argv[]) {
   dec->DumpInputFormat();
   av_log(NULL, AV_LOG_INFO, "\n\n\n");
 
-  ret = enc->Open(dec->CodecContext(AVMEDIA_TYPE_VIDEO),
-                  dec->CodecContext(AVMEDIA_TYPE_AUDIO));
-  if (ret != AVERROR_OK) {
-    return ret;
+  auto outputs = make_outputs(dec->CodecContext(AVMEDIA_TYPE_VIDEO));
+  if (!outputs.empty()) {
+    gop_size = outputs.front().config_ctx->gop_size;
+  }
+  for (auto &output : outputs) {
+    auto enc = std::make_unique<Encoding>(output.url, output.config_ctx,
+                                          frame_pool);
+    ret = enc->Open(dec->CodecContext(AVMEDIA_TYPE_VIDEO),
+                    dec->CodecContext(AVMEDIA_TYPE_AUDIO));
+    if (ret != AVERROR_OK) {
+      return ret;
+    }
+    enc->DumpInputFormat();
+    encs.push_back(std::move(enc));
   }
-  enc->DumpInputFormat();
 
-  enc->RunAsync();
+  auto start = std::chrono::steady_clock::now();
+  for (auto &enc : encs) {
+    enc->RunAsync();
+  }
   dec->RunAsync(std::move(err_func));
 
   dec->Join();
   dec->Close();
-  enc->Join();
-  enc->Close();
+  for (auto &enc : encs) {
+    enc->Join();
+    enc->Close();
+  }
+  auto seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
 
   av_log(NULL, AV_LOG_INFO,
-         "transcoding done, total decoded video frames %" PRId64
-         " audio samples %" PRId64 "\n",
-         total_decoded_video, total_decoded_audio);
+         "transcoding done, %zu outputs, total decoded video frames %" PRId64
+         " audio samples %" PRId64 ", %.2f s, %.1f video fps\n",
+         encs.size(), total_decoded_video, total_decoded_audio, seconds,
+         total_decoded_video / seconds);
+  av_log(NULL, AV_LOG_INFO,
+         "frame pool: %" PRIu64 " frames handed over, %" PRIu64
+         " AVFrame allocated\n",
+         frame_pool->gets(), frame_pool->allocated());
+
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  av_log_set_level(AV_LOG_INFO);
+  if (argc < 3) {
+    av_log(NULL, AV_LOG_ERROR,
+           "Usage: %s <input file> <output file> [--abr [--independent] | "
+           "--chunks <jobs>]\n"
+           "  --abr          encode every rendition of the ladder from one "
+           "decoding, output files are suffixed by the height, e.g. "
+           "out_720p.mp4\n"
+           "  --independent  transcode the renditions one after another, each "
+           "decoding the input on its own, for comparison\n"
+           "  --chunks       split the input at keyframes and transcode "
+           "<jobs> segments at a time, then concatenate them\n",
+           argv[0]);
+    return -1;
+  }
+  const char *input_url = argv[1];
+  const char *output_url = argv[2];
+  bool abr = false;
+  bool independent = false;
+  int jobs = 0;
+  for (int i = 3; i < argc; ++i) {
+    if (0 == strcmp(argv[i], "--abr")) {
+      abr = true;
+    } else if (0 == strcmp(argv[i], "--independent")) {
+      independent = true;
+    } else if (0 == strcmp(argv[i], "--chunks") && i + 1 < argc) {
+      jobs = std::max(atoi(argv[++i]), 1);
+    }
+  }
+  if (abr && jobs > 0) {
+    av_log(NULL, AV_LOG_ERROR, "--abr and --chunks can't be combined\n");
+    return -1;
+  }
+  av_log(NULL, AV_LOG_INFO, "transcoding task: %s -> %s%s\n", input_url,
+         output_url,
+         abr ? (independent ? " (abr, independent)" : " (abr)") : "");
+
+  // configuration
+  std::shared_ptr<ConfigurationContext> config_ctx =
+      std::make_shared<ConfigurationContext>();
+  // config_ctx->hwaccel_device_type = AV_HWDEVICE_TYPE_CUDA;
+  // config_ctx->hwaccel_output_format_cuda = true;
+  // config_ctx->hw_encoder_name = "h264_nvenc";
+  // config_ctx->enable_cuda_frames_caching = true;
+  config_ctx->max_cache_frames = 60;
+
+  auto start = std::chrono::steady_clock::now();
+  auto cpu_start = ProcessCpuSeconds();
+  int ret = 0;
+  size_t renditions = 1;
+  if (jobs > 0) {
+    ChunkedTranscoding chunked(input_url, output_url, config_ctx, jobs);
+    ret = chunked.Run();
+  } else if (!abr) {
+    ret = Transcode(input_url, config_ctx, [&](const AVCodecContext *) {
+      return std::vector<Output>{Output{output_url, config_ctx}};
+    });
+  } else if (!independent) {
+    ret = Transcode(input_url, config_ctx, [&](const AVCodecContext *v) {
+      auto outputs = Ladder(output_url, v, config_ctx);
+      renditions = outputs.size();
+      return outputs;
+    });
+  } else {
+    for (size_t i = 0; i < renditions && ret == 0; ++i) {
+      ret = Transcode(input_url, config_ctx, [&](const AVCodecContext *v) {
+        auto outputs = Ladder(output_url, v, config_ctx);
+        renditions = outputs.size();
+        return std::vector<Output>{outputs[i]};
+      });
+    }
+  }
+  if (ret != 0) {
+    return ret;
+  }
+  auto seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  auto cpu_seconds = ProcessCpuSeconds() - cpu_start;
+  av_log(NULL, AV_LOG_INFO, "%zu outputs in %.2f s, cpu %.2f s (%.2f cores)\n",
+         renditions, seconds, cpu_seconds, cpu_seconds / seconds);
 
   return 0;
-}
\ No newline at end of file
+}
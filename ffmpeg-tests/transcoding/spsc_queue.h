@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free single producer/single consumer ring.
+// `Push`/`Pop` only touch the two indices while the ring is neither full nor
+// empty. The producer blocks on a condition variable only when it's full, the
+// consumer only when it's empty, and each side locks the mutex to wake the
+// other only if that one is actually sleeping, so the steady state has no
+// locks, no syscalls and no polling delays.
+// Exactly one thread may push and one thread may pop at a time.
+template <typename T> class SPSCQueue {
+public:
+  SPSCQueue() = delete;
+  SPSCQueue(const SPSCQueue &) = delete;
+  SPSCQueue(SPSCQueue &&) = delete;
+  // capacity is rounded up to a power of 2
+  explicit SPSCQueue(size_t capacity) {
+    size_t n = 2;
+    while (n < capacity) {
+      n <<= 1;
+    }
+    ring_.resize(n);
+    mask_ = n - 1;
+  }
+
+public:
+  // blocks while full
+  void Push(T v) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head - cached_tail_ > mask_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head - cached_tail_ > mask_) {
+        wait(producer_waiting_, not_full_, [this, head] {
+          return head - tail_.load(std::memory_order_acquire) <= mask_;
+        });
+        cached_tail_ = tail_.load(std::memory_order_acquire);
+      }
+    }
+    ring_[head & mask_] = std::move(v);
+    head_.store(head + 1, std::memory_order_release);
+    wake(consumer_waiting_, not_empty_);
+  }
+
+  // blocks while empty
+  T Pop() {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail == cached_head_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail == cached_head_) {
+        wait(consumer_waiting_, not_empty_, [this, tail] {
+          return tail != head_.load(std::memory_order_acquire);
+        });
+        cached_head_ = head_.load(std::memory_order_acquire);
+      }
+    }
+    T v = std::move(ring_[tail & mask_]);
+    tail_.store(tail + 1, std::memory_order_release);
+    wake(producer_waiting_, not_full_);
+    return v;
+  }
+
+  // consumer side, false if empty
+  bool TryPop(T *v) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail == cached_head_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail == cached_head_) {
+        return false;
+      }
+    }
+    *v = std::move(ring_[tail & mask_]);
+    tail_.store(tail + 1, std::memory_order_release);
+    wake(producer_waiting_, not_full_);
+    return true;
+  }
+
+  size_t Size() const {
+    return head_.load(std::memory_order_acquire) -
+           tail_.load(std::memory_order_acquire);
+  }
+  size_t Capacity() const { return mask_ + 1; }
+
+private:
+  // The waiter publishes `waiting` before re-checking the indices, the other
+  // side publishes its index before checking `waiting`. The fences order both
+  // pairs, so either the waiter sees the new index or the other side sees the
+  // flag and notifies under the mutex, never neither.
+  template <typename Ready>
+  void wait(std::atomic<bool> &waiting, std::condition_variable &cv,
+            Ready ready) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    waiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    cv.wait(lk, ready);
+    waiting.store(false, std::memory_order_relaxed);
+  }
+
+  void wake(std::atomic<bool> &waiting, std::condition_variable &cv) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed)) {
+      { std::lock_guard<std::mutex> lk(mtx_); }
+      cv.notify_one();
+    }
+  }
+
+private:
+  std::vector<T> ring_;
+  size_t mask_{0};
+
+  // producer and consumer state on separate cache lines
+  alignas(64) std::atomic<size_t> head_{0}; // next to push
+  size_t cached_tail_{0};                   // producer's view of `tail_`
+  alignas(64) std::atomic<size_t> tail_{0}; // next to pop
+  size_t cached_head_{0};                   // consumer's view of `head_`
+
+  alignas(64) std::atomic<bool> producer_waiting_{false};
+  std::atomic<bool> consumer_waiting_{false};
+  std::mutex mtx_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+};
@@ -0,0 +1,600 @@
+#include "FlvAmf.h"
+
+#include <string.h>
+
+#include <typeinfo>
+
+namespace {
+
+enum Amf0Marker {
+  kAmf0Number = 0x00,
+  kAmf0Boolean = 0x01,
+  kAmf0String = 0x02,
+  kAmf0Object = 0x03,
+  kAmf0MovieClip = 0x04, // reserved
+  kAmf0Null = 0x05,
+  kAmf0Undefined = 0x06,
+  kAmf0Reference = 0x07,
+  kAmf0EcmaArray = 0x08,
+  kAmf0ObjectEnd = 0x09,
+  kAmf0StrictArray = 0x0A,
+  kAmf0Date = 0x0B,
+  kAmf0LongString = 0x0C,
+  kAmf0Unsupported = 0x0D,
+  kAmf0RecordSet = 0x0E, // reserved
+  kAmf0XmlDocument = 0x0F,
+  kAmf0TypedObject = 0x10,
+  kAmf0AvmPlusObject = 0x11, // switch to AMF3
+};
+
+enum Amf3Marker {
+  kAmf3Undefined = 0x00,
+  kAmf3Null = 0x01,
+  kAmf3False = 0x02,
+  kAmf3True = 0x03,
+  kAmf3Integer = 0x04,
+  kAmf3Double = 0x05,
+  kAmf3String = 0x06,
+  kAmf3XmlDoc = 0x07,
+  kAmf3Date = 0x08,
+  kAmf3Array = 0x09,
+  kAmf3Object = 0x0A,
+  kAmf3Xml = 0x0B,
+  kAmf3ByteArray = 0x0C,
+};
+
+double ReadDouble(const char *p) {
+  uint64_t bits = FlvCommonUtils::ReadUInt64BE(p);
+  double v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+bool KeyEquals(const char *key, int len, const char *expected) {
+  return key && static_cast<int>(strlen(expected)) == len &&
+         0 == memcmp(key, expected, len);
+}
+
+} // namespace
+
+FlvErrorCode FlvAmfDecoder::Decode(const char *buff, int len,
+                                   FlvAmfVisitor *visitor) {
+  if (NULL == buff || len <= 0) {
+    return kFlvErrorBufferEmptyOrTooLessData;
+  }
+  buff_ = buff;
+  end_ = buff + len;
+  strings_.clear(); // keep capacity
+  traits_.clear();
+  sealed_names_.clear();
+  objects_ = 0;
+
+  while (buff_ < end_) {
+    if (!decodeAmf0(visitor, 0)) {
+      return kFlvErrorAmfDataInvalid;
+    }
+  }
+  return kFlvErrorOK;
+}
+
+bool FlvAmfDecoder::read(int n, const char **p) {
+  if (end_ - buff_ < n) {
+    return false;
+  }
+  *p = buff_;
+  buff_ += n;
+  return true;
+}
+
+bool FlvAmfDecoder::readAmf0String(bool long_string, const char **s,
+                                   uint32_t *len) {
+  const char *p;
+  if (!read(long_string ? 4 : 2, &p)) {
+    return false;
+  }
+  *len = long_string ? FlvCommonUtils::ReadUInt32BE(p)
+                     : FlvCommonUtils::ReadUInt16BE(p);
+  if (static_cast<uint64_t>(end_ - buff_) < *len) {
+    return false;
+  }
+  *s = buff_;
+  buff_ += *len;
+  return true;
+}
+
+bool FlvAmfDecoder::decodeAmf0Properties(FlvAmfVisitor *visitor, int depth) {
+  while (true) {
+    const char *key;
+    uint32_t key_len;
+    if (!readAmf0String(false, &key, &key_len)) {
+      return false;
+    }
+    if (key_len == 0 && buff_ < end_ && *buff_ == kAmf0ObjectEnd) {
+      ++buff_;
+      return true;
+    }
+    visitor->OnKey(key, key_len);
+    if (!decodeAmf0(visitor, depth + 1)) {
+      return false;
+    }
+  }
+}
+
+bool FlvAmfDecoder::decodeAmf0(FlvAmfVisitor *visitor, int depth) {
+  const char *p;
+  if (depth > kMaxDepth || !read(1, &p)) {
+    return false;
+  }
+
+  switch (static_cast<uint8_t>(*p)) {
+  case kAmf0Number:
+    if (!read(8, &p)) {
+      return false;
+    }
+    visitor->OnNumber(ReadDouble(p));
+    return true;
+  case kAmf0Boolean:
+    if (!read(1, &p)) {
+      return false;
+    }
+    visitor->OnBoolean(*p != 0);
+    return true;
+  case kAmf0String:
+  case kAmf0LongString:
+  case kAmf0XmlDocument: {
+    const char *s;
+    uint32_t len;
+    if (!readAmf0String(*p != kAmf0String, &s, &len)) {
+      return false;
+    }
+    visitor->OnString(s, len);
+    return true;
+  }
+  case kAmf0Null:
+    visitor->OnNull();
+    return true;
+  case kAmf0Undefined:
+  case kAmf0Unsupported:
+    visitor->OnUndefined();
+    return true;
+  case kAmf0Reference:
+    if (!read(2, &p)) {
+      return false;
+    }
+    visitor->OnReference(FlvCommonUtils::ReadUInt16BE(p));
+    return true;
+  case kAmf0TypedObject:
+  case kAmf0Object: {
+    const char *class_name; // ignored
+    uint32_t len;
+    if (*p == kAmf0TypedObject &&
+        !readAmf0String(false, &class_name, &len)) {
+      return false;
+    }
+    visitor->OnObjectBegin();
+    if (!decodeAmf0Properties(visitor, depth)) {
+      return false;
+    }
+    visitor->OnObjectEnd();
+    return true;
+  }
+  case kAmf0EcmaArray:
+    if (!read(4, &p)) {
+      return false;
+    }
+    visitor->OnEcmaArrayBegin(FlvCommonUtils::ReadUInt32BE(p));
+    if (!decodeAmf0Properties(visitor, depth)) {
+      return false;
+    }
+    visitor->OnArrayEnd();
+    return true;
+  case kAmf0StrictArray: {
+    if (!read(4, &p)) {
+      return false;
+    }
+    uint32_t count = FlvCommonUtils::ReadUInt32BE(p);
+    if (count > static_cast<uint64_t>(end_ - buff_)) {
+      return false; // every value costs at least one byte
+    }
+    visitor->OnStrictArrayBegin(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      if (!decodeAmf0(visitor, depth + 1)) {
+        return false;
+      }
+    }
+    visitor->OnArrayEnd();
+    return true;
+  }
+  case kAmf0Date:
+    if (!read(10, &p)) {
+      return false;
+    }
+    visitor->OnDate(ReadDouble(p),
+                    static_cast<int16_t>(FlvCommonUtils::ReadUInt16BE(p + 8)));
+    return true;
+  case kAmf0AvmPlusObject:
+    return decodeAmf3(visitor, depth);
+  default: // MovieClip, RecordSet, unknown
+    return false;
+  }
+}
+
+bool FlvAmfDecoder::readU29(uint32_t *v) {
+  *v = 0;
+  for (int i = 0; i < 4; ++i) {
+    if (buff_ >= end_) {
+      return false;
+    }
+    uint8_t b = static_cast<uint8_t>(*buff_++);
+    if (i == 3) {
+      *v = (*v << 8) | b;
+      return true;
+    }
+    *v = (*v << 7) | (b & 0x7F);
+    if (!(b & 0x80)) {
+      return true;
+    }
+  }
+  return true;
+}
+
+bool FlvAmfDecoder::readAmf3String(const char **s, uint32_t *len) {
+  uint32_t v;
+  if (!readU29(&v)) {
+    return false;
+  }
+  if (!(v & 1)) { // reference
+    if ((v >> 1) >= strings_.size()) {
+      return false;
+    }
+    *s = strings_[v >> 1].s;
+    *len = strings_[v >> 1].len;
+    return true;
+  }
+
+  *len = v >> 1;
+  if (static_cast<uint64_t>(end_ - buff_) < *len) {
+    return false;
+  }
+  *s = buff_;
+  buff_ += *len;
+  if (*len > 0) { // empty string is never sent by reference
+    strings_.push_back(StringRef{*s, *len});
+  }
+  return true;
+}
+
+bool FlvAmfDecoder::decodeAmf3(FlvAmfVisitor *visitor, int depth) {
+  const char *p;
+  if (depth > kMaxDepth || !read(1, &p)) {
+    return false;
+  }
+
+  uint32_t v;
+  switch (static_cast<uint8_t>(*p)) {
+  case kAmf3Undefined:
+    visitor->OnUndefined();
+    return true;
+  case kAmf3Null:
+    visitor->OnNull();
+    return true;
+  case kAmf3False:
+  case kAmf3True:
+    visitor->OnBoolean(*p == kAmf3True);
+    return true;
+  case kAmf3Integer:
+    if (!readU29(&v)) {
+      return false;
+    }
+    visitor->OnInteger(static_cast<int32_t>((v ^ 0x10000000) - 0x10000000));
+    return true;
+  case kAmf3Double:
+    if (!read(8, &p)) {
+      return false;
+    }
+    visitor->OnNumber(ReadDouble(p));
+    return true;
+  case kAmf3String: {
+    const char *s;
+    uint32_t len;
+    if (!readAmf3String(&s, &len)) {
+      return false;
+    }
+    visitor->OnString(s, len);
+    return true;
+  }
+  case kAmf3XmlDoc:
+  case kAmf3Xml:
+  case kAmf3ByteArray:
+  case kAmf3Date: {
+    uint8_t marker = static_cast<uint8_t>(*p);
+    if (!readU29(&v)) {
+      return false;
+    }
+    if (!(v & 1)) {
+      visitor->OnReference(v >> 1);
+      return true;
+    }
+    ++objects_;
+    if (marker == kAmf3Date) {
+      if (!read(8, &p)) {
+        return false;
+      }
+      visitor->OnDate(ReadDouble(p), 0);
+      return true;
+    }
+    if (!read(v >> 1, &p)) {
+      return false;
+    }
+    if (marker == kAmf3ByteArray) {
+      visitor->OnBytes(p, v >> 1);
+    } else {
+      visitor->OnString(p, v >> 1);
+    }
+    return true;
+  }
+  case kAmf3Array: {
+    if (!readU29(&v)) {
+      return false;
+    }
+    if (!(v & 1)) {
+      visitor->OnReference(v >> 1);
+      return true;
+    }
+    ++objects_;
+    uint32_t dense = v >> 1;
+    if (dense > static_cast<uint64_t>(end_ - buff_)) {
+      return false;
+    }
+    visitor->OnStrictArrayBegin(dense);
+    while (true) { // associative part
+      const char *key;
+      uint32_t key_len;
+      if (!readAmf3String(&key, &key_len)) {
+        return false;
+      }
+      if (key_len == 0) {
+        break;
+      }
+      visitor->OnKey(key, key_len);
+      if (!decodeAmf3(visitor, depth + 1)) {
+        return false;
+      }
+    }
+    for (uint32_t i = 0; i < dense; ++i) {
+      if (!decodeAmf3(visitor, depth + 1)) {
+        return false;
+      }
+    }
+    visitor->OnArrayEnd();
+    return true;
+  }
+  case kAmf3Object: {
+    if (!readU29(&v)) {
+      return false;
+    }
+    if (!(v & 1)) {
+      visitor->OnReference(v >> 1);
+      return true;
+    }
+    ++objects_;
+
+    Traits traits;
+    if (!(v & 2)) { // traits reference
+      if ((v >> 2) >= traits_.size()) {
+        return false;
+      }
+      traits = traits_[v >> 2];
+    } else {
+      if (v & 4) {
+        return false; // TODO: externalizable traits are not supported
+      }
+      const char *class_name; // ignored
+      uint32_t class_name_len;
+      if (!readAmf3String(&class_name, &class_name_len)) {
+        return false;
+      }
+      traits.dynamic = (v & 8) != 0;
+      traits.sealed_count = v >> 4;
+      traits.first_sealed = static_cast<uint32_t>(sealed_names_.size());
+      if (traits.sealed_count > static_cast<uint64_t>(end_ - buff_)) {
+        return false;
+      }
+      for (uint32_t i = 0; i < traits.sealed_count; ++i) {
+        StringRef name;
+        if (!readAmf3String(&name.s, &name.len)) {
+          return false;
+        }
+        sealed_names_.push_back(name);
+      }
+      traits_.push_back(traits);
+    }
+
+    visitor->OnObjectBegin();
+    for (uint32_t i = 0; i < traits.sealed_count; ++i) {
+      const StringRef &name = sealed_names_[traits.first_sealed + i];
+      visitor->OnKey(name.s, name.len);
+      if (!decodeAmf3(visitor, depth + 1)) {
+        return false;
+      }
+    }
+    while (traits.dynamic) {
+      const char *key;
+      uint32_t key_len;
+      if (!readAmf3String(&key, &key_len)) {
+        return false;
+      }
+      if (key_len == 0) {
+        break;
+      }
+      visitor->OnKey(key, key_len);
+      if (!decodeAmf3(visitor, depth + 1)) {
+        return false;
+      }
+    }
+    visitor->OnObjectEnd();
+    return true;
+  }
+  default: // vectors, dictionary, unknown
+    return false;
+  }
+}
+
+void FlvAmfEncoder::writeUInt16(uint32_t v) {
+  data_.push_back(static_cast<char>((v >> 8) & 0xFF));
+  data_.push_back(static_cast<char>(v & 0xFF));
+}
+
+void FlvAmfEncoder::writeUInt32(uint32_t v) {
+  writeUInt16(v >> 16);
+  writeUInt16(v & 0xFFFF);
+}
+
+void FlvAmfEncoder::WriteNumber(double v) {
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  data_.push_back(kAmf0Number);
+  writeUInt32(static_cast<uint32_t>(bits >> 32));
+  writeUInt32(static_cast<uint32_t>(bits));
+}
+
+void FlvAmfEncoder::WriteBoolean(bool v) {
+  data_.push_back(kAmf0Boolean);
+  data_.push_back(v ? 1 : 0);
+}
+
+void FlvAmfEncoder::WriteString(const char *s, int len) {
+  if (len > 0xFFFF) {
+    data_.push_back(kAmf0LongString);
+    writeUInt32(len);
+  } else {
+    data_.push_back(kAmf0String);
+    writeUInt16(len);
+  }
+  data_.insert(data_.end(), s, s + len);
+}
+
+void FlvAmfEncoder::WriteNull() { data_.push_back(kAmf0Null); }
+
+void FlvAmfEncoder::WriteKey(const char *key, int len) {
+  writeUInt16(len);
+  data_.insert(data_.end(), key, key + len);
+}
+
+void FlvAmfEncoder::BeginObject() { data_.push_back(kAmf0Object); }
+
+void FlvAmfEncoder::EndObject() {
+  writeUInt16(0); // empty key
+  data_.push_back(kAmf0ObjectEnd);
+}
+
+void FlvAmfEncoder::BeginEcmaArray(uint32_t count) {
+  data_.push_back(kAmf0EcmaArray);
+  writeUInt32(count);
+}
+
+void FlvAmfEncoder::BeginStrictArray(uint32_t count) {
+  data_.push_back(kAmf0StrictArray);
+  writeUInt32(count);
+}
+
+void FlvMetaData::Clear() {
+  duration = file_size = width = height = frame_rate = 0;
+  video_codec_id = video_data_rate = 0;
+  audio_codec_id = audio_data_rate = audio_sample_rate = 0;
+  keyframe_file_positions.clear(); // keep capacity
+  keyframe_times.clear();
+}
+
+void FlvMetaData::Dump() {
+  std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(duration) << ": " << duration << std::endl;
+  std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(file_size) << ": " << file_size << std::endl;
+  std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(width) << ": " << width << std::endl;
+  std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(height) << ": " << height << std::endl;
+  std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(frame_rate) << ": " << frame_rate << std::endl;
+  std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(video_codec_id) << ": " << video_codec_id << std::endl;
+  std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(video_data_rate) << ": " << video_data_rate << std::endl;
+  std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(audio_codec_id) << ": " << audio_codec_id << std::endl;
+  std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(audio_data_rate) << ": " << audio_data_rate << std::endl;
+  std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(audio_sample_rate) << ": " << audio_sample_rate << std::endl;
+  std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(keyframe_file_positions) << ": " << keyframe_file_positions.size() << " entries" << std::endl;
+  std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(keyframe_times) << ": " << keyframe_times.size() << " entries" << std::endl;
+}
+
+FlvErrorCode FlvMetaDataCollector::Collect(const char *buff, int len) {
+  meta_data_.Clear();
+  values_ = 0;
+  is_meta_data_ = false;
+  depth_ = 0;
+  memset(keys_, 0, sizeof(keys_));
+
+  FlvErrorCode err = decoder_.Decode(buff, len, this);
+  if (err != kFlvErrorOK) {
+    return err;
+  }
+  return is_meta_data_ ? kFlvErrorOK : kFlvErrorTagTypeInvalid;
+}
+
+bool FlvMetaDataCollector::keyIs(int depth, const char *key) const {
+  return KeyEquals(keys_[depth].s, keys_[depth].len, key);
+}
+
+void FlvMetaDataCollector::OnKey(const char *key, int len) {
+  if (depth_ >= 1 && depth_ <= 2) {
+    keys_[depth_].s = key;
+    keys_[depth_].len = len;
+  }
+}
+
+void FlvMetaDataCollector::OnString(const char *s, int len) {
+  if (depth_ == 0 && values_++ == 0) {
+    is_meta_data_ = KeyEquals(s, len, "onMetaData");
+  }
+}
+
+void FlvMetaDataCollector::OnStrictArrayBegin(uint32_t count) {
+  if (is_meta_data_ && depth_ == 2 && keyIs(1, "keyframes")) {
+    if (keyIs(2, "filepositions")) {
+      meta_data_.keyframe_file_positions.reserve(count);
+    } else if (keyIs(2, "times")) {
+      meta_data_.keyframe_times.reserve(count);
+    }
+  }
+  ++depth_;
+}
+
+void FlvMetaDataCollector::OnNumber(double v) {
+  if (!is_meta_data_) {
+    return;
+  }
+
+  if (depth_ == 1) {
+    if (keyIs(1, "duration")) {
+      meta_data_.duration = v;
+    } else if (keyIs(1, "filesize")) {
+      meta_data_.file_size = v;
+    } else if (keyIs(1, "width")) {
+      meta_data_.width = v;
+    } else if (keyIs(1, "height")) {
+      meta_data_.height = v;
+    } else if (keyIs(1, "framerate")) {
+      meta_data_.frame_rate = v;
+    } else if (keyIs(1, "videocodecid")) {
+      meta_data_.video_codec_id = v;
+    } else if (keyIs(1, "videodatarate")) {
+      meta_data_.video_data_rate = v;
+    } else if (keyIs(1, "audiocodecid")) {
+      meta_data_.audio_codec_id = v;
+    } else if (keyIs(1, "audiodatarate")) {
+      meta_data_.audio_data_rate = v;
+    } else if (keyIs(1, "audiosamplerate")) {
+      meta_data_.audio_sample_rate = v;
+    }
+  } else if (depth_ == 3 && keyIs(1, "keyframes")) {
+    if (keyIs(2, "filepositions")) {
+      meta_data_.keyframe_file_positions.push_back(v);
+    } else if (keyIs(2, "times")) {
+      meta_data_.keyframe_times.push_back(v);
+    }
+  }
+}
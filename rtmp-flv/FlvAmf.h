@@ -0,0 +1,171 @@
+#ifndef FLV_AMF_H_
+#define FLV_AMF_H_
+
+#include <string>
+#include <vector>
+
+#include "FlvCommon.h"
+
+// SAX-style receiver of decoded AMF values.
+// Strings and byte arrays point into the decoded buffer, nothing is copied.
+// Object/ECMA array members are reported as `OnKey` followed by the value.
+class FlvAmfVisitor {
+public:
+  virtual ~FlvAmfVisitor() {}
+
+  virtual void OnNumber(double v) {}
+  virtual void OnInteger(int32_t v) { OnNumber(v); } // AMF3 only
+  virtual void OnBoolean(bool v) {}
+  virtual void OnString(const char *s, int len) {}
+  virtual void OnBytes(const char *p, int len) {} // AMF3 ByteArray
+  virtual void OnNull() {}
+  virtual void OnUndefined() {}
+  virtual void OnDate(double ms, int16_t time_zone) {}
+
+  // reference to an already decoded complex value, which is not reported again
+  virtual void OnReference(uint32_t index) {}
+
+  virtual void OnKey(const char *key, int len) {}
+  virtual void OnObjectBegin() {}
+  virtual void OnObjectEnd() {}
+  // `count` is the announced ECMA array length or dense length for strict
+  // arrays, which may be used to reserve storage.
+  virtual void OnEcmaArrayBegin(uint32_t count) {}
+  virtual void OnStrictArrayBegin(uint32_t count) {}
+  virtual void OnArrayEnd() {}
+};
+
+// Decodes script data (AMF0 values, switching to AMF3 on the avmplus marker)
+// into a `FlvAmfVisitor` without per value allocations.
+// The AMF3 string/traits reference tables are kept in the decoder and reused
+// across `Decode` calls, so reuse a decoder instance on hot paths.
+class FlvAmfDecoder {
+public:
+  // Decode all values in `buff`, e.g. the data of a script data tag.
+  FlvErrorCode Decode(const char *buff, int len, FlvAmfVisitor *visitor);
+
+  const static int kMaxDepth{64}; // nesting limit for untrusted input
+
+private:
+  bool decodeAmf0(FlvAmfVisitor *visitor, int depth);
+  bool decodeAmf0Properties(FlvAmfVisitor *visitor, int depth);
+  bool readAmf0String(bool long_string, const char **s, uint32_t *len);
+
+  bool decodeAmf3(FlvAmfVisitor *visitor, int depth);
+  bool readU29(uint32_t *v);
+  bool readAmf3String(const char **s, uint32_t *len);
+
+  bool read(int n, const char **p);
+
+private:
+  struct StringRef {
+    const char *s;
+    uint32_t len;
+  };
+  struct Traits {
+    bool dynamic;
+    uint32_t sealed_count;
+    uint32_t first_sealed; // index into `sealed_names_`
+  };
+
+  const char *buff_{nullptr};
+  const char *end_{nullptr};
+
+  // AMF3 reference tables, reset per `Decode`
+  std::vector<StringRef> strings_;
+  std::vector<Traits> traits_;
+  std::vector<StringRef> sealed_names_;
+  uint32_t objects_{0};
+};
+
+// Encodes AMF0 values into a reusable buffer, e.g. RTMP commands or script
+// data. Callers are responsible for matching begin/end calls.
+class FlvAmfEncoder {
+public:
+  void Clear() { data_.clear(); } // keep capacity
+  const std::vector<char> &data() const { return data_; }
+
+  void WriteNumber(double v);
+  void WriteBoolean(bool v);
+  void WriteString(const char *s, int len); // long string if >= 64KB
+  void WriteString(const std::string &s) {
+    WriteString(s.data(), static_cast<int>(s.size()));
+  }
+  void WriteNull();
+
+  // object/ECMA array member name, followed by its value
+  void WriteKey(const char *key, int len);
+  void WriteKey(const std::string &key) {
+    WriteKey(key.data(), static_cast<int>(key.size()));
+  }
+  void BeginObject();
+  void EndObject();
+  void BeginEcmaArray(uint32_t count);
+  void EndEcmaArray() { EndObject(); }
+  // followed by exactly `count` values, no end marker
+  void BeginStrictArray(uint32_t count);
+
+private:
+  void writeUInt16(uint32_t v);
+  void writeUInt32(uint32_t v);
+
+private:
+  std::vector<char> data_;
+};
+
+// Common onMetaData fields, 0 if absent.
+struct FlvMetaData {
+  double duration{0};
+  double file_size{0};
+  double width{0};
+  double height{0};
+  double frame_rate{0};
+  double video_codec_id{0};
+  double video_data_rate{0};
+  double audio_codec_id{0};
+  double audio_data_rate{0};
+  double audio_sample_rate{0};
+
+  // keyframes.filepositions / keyframes.times written by e.g. yamdi, flvtool2
+  std::vector<double> keyframe_file_positions;
+  std::vector<double> keyframe_times;
+
+  void Clear();
+  void Dump();
+};
+
+// Collects `FlvMetaData` from a onMetaData script tag, reuse the instance to
+// keep the keyframe vectors' capacity.
+class FlvMetaDataCollector : public FlvAmfVisitor {
+public:
+  // Returns `kFlvErrorTagTypeInvalid` if it's not a onMetaData script tag.
+  FlvErrorCode Collect(const char *buff, int len);
+  FlvMetaData &meta_data() { return meta_data_; }
+
+public:
+  void OnNumber(double v) override;
+  void OnString(const char *s, int len) override;
+  void OnKey(const char *key, int len) override;
+  void OnObjectBegin() override { ++depth_; }
+  void OnObjectEnd() override { --depth_; }
+  void OnEcmaArrayBegin(uint32_t count) override { ++depth_; }
+  void OnStrictArrayBegin(uint32_t count) override;
+  void OnArrayEnd() override { --depth_; }
+
+private:
+  bool keyIs(int depth, const char *key) const;
+
+private:
+  FlvAmfDecoder decoder_;
+  FlvMetaData meta_data_;
+
+  int values_{0}; // top level values
+  bool is_meta_data_{false};
+  int depth_{0};
+  struct {
+    const char *s;
+    int len;
+  } keys_[3]{}; // latest key at depth 1 and 2
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "FlvAsyncFileWriter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+bool FlvAsyncFileWriter::Open(const std::string &path,
+                              const Options &options) {
+  Close();
+
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  direct_io_ = false;
+#ifdef O_DIRECT
+  if (options.direct_io) {
+    fd_ = open(path.c_str(), flags | O_DIRECT, 0644);
+    direct_io_ = fd_ >= 0;
+  }
+#endif
+  if (fd_ < 0) {
+    fd_ = open(path.c_str(), flags, 0644);
+    if (fd_ < 0) {
+      return false;
+    }
+  }
+
+  buffer_size_ = (std::max(options.buffer_size, 1) + kAlignment - 1) /
+                 kAlignment * kAlignment;
+  int count = std::max(options.buffer_count, 2);
+  buffers_.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    void *p = nullptr;
+    if (posix_memalign(&p, kAlignment, buffer_size_) != 0) {
+      Close();
+      return false;
+    }
+    buffers_.push_back(Buffer{static_cast<char *>(p), 0});
+  }
+  for (auto &b : buffers_) {
+    free_.push_back(&b);
+  }
+
+  offset_ = 0;
+  stop_ = false;
+  failed_ = false;
+  queue_depth_ = 0;
+  max_queue_depth_ = 0;
+  bytes_written_ = 0;
+  stall_us_ = 0;
+  stalls_ = 0;
+  writer_ = std::thread(&FlvAsyncFileWriter::run, this);
+  return true;
+}
+
+bool FlvAsyncFileWriter::Close() {
+  if (writer_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    queue_cv_.notify_one();
+    writer_.join();
+  }
+
+  bool ok = !failed_;
+  if (current_ && current_->len > 0) { // tail, always unaligned
+#ifdef O_DIRECT
+    if (direct_io_) {
+      fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+    }
+#endif
+    ok = ok && writeBuffer(*current_);
+  }
+  current_ = nullptr;
+
+  if (fd_ >= 0) {
+    ok = close(fd_) == 0 && ok;
+    fd_ = -1;
+  }
+  for (auto &b : buffers_) {
+    free(b.data);
+  }
+  buffers_.clear();
+  free_.clear();
+  queue_.clear();
+  return ok;
+}
+
+bool FlvAsyncFileWriter::Write(const char *buff, int len) {
+  if (!writer_.joinable()) {
+    return false;
+  }
+  while (len > 0) {
+    if (failed_) {
+      return false;
+    }
+    if (!current_ && !acquireBuffer()) {
+      return false;
+    }
+    int n = std::min(len, buffer_size_ - current_->len);
+    memcpy(current_->data + current_->len, buff, n);
+    current_->len += n;
+    buff += n;
+    len -= n;
+    if (current_->len == buffer_size_) {
+      submitBuffer();
+    }
+  }
+  return !failed_;
+}
+
+FlvAsyncFileWriter::Stats FlvAsyncFileWriter::stats() const {
+  return Stats{queue_depth_, max_queue_depth_, bytes_written_, stall_us_,
+               stalls_};
+}
+
+bool FlvAsyncFileWriter::acquireBuffer() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (free_.empty()) {
+    auto start = std::chrono::steady_clock::now();
+    free_cv_.wait(lock, [this] { return !free_.empty() || failed_; });
+    stall_us_ += std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+    ++stalls_;
+    if (free_.empty()) {
+      return false;
+    }
+  }
+  current_ = free_.back();
+  free_.pop_back();
+  current_->len = 0;
+  return true;
+}
+
+void FlvAsyncFileWriter::submitBuffer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(current_);
+    int depth = ++queue_depth_;
+    if (depth > max_queue_depth_) {
+      max_queue_depth_ = depth;
+    }
+  }
+  current_ = nullptr;
+  queue_cv_.notify_one();
+}
+
+bool FlvAsyncFileWriter::writeBuffer(const Buffer &buffer) {
+  int written = 0;
+  while (written < buffer.len) {
+    ssize_t n = pwrite(fd_, buffer.data + written, buffer.len - written,
+                       offset_ + written);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    written += n;
+  }
+  offset_ += written;
+  bytes_written_ += written;
+  return true;
+}
+
+void FlvAsyncFileWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    queue_cv_.wait(lock, [this] { return !queue_.empty() || stop_; });
+    if (queue_.empty()) {
+      break; // stopped and drained
+    }
+    Buffer *buffer = queue_.front();
+    queue_.pop_front();
+
+    lock.unlock();
+    bool ok = !failed_ && writeBuffer(*buffer);
+    lock.lock();
+
+    if (!ok) {
+      failed_ = true;
+    }
+    --queue_depth_;
+    free_.push_back(buffer);
+    free_cv_.notify_one();
+  }
+}
@@ -0,0 +1,94 @@
+#ifndef FLV_ASYNC_FILE_WRITER_H_
+#define FLV_ASYNC_FILE_WRITER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Appends to a file from a dedicated writer thread.
+// `Write` only copies into the current buffer of a bounded pool of large
+// aligned buffers, full buffers are queued and written with `pwrite` by the
+// writer thread, so the caller never waits for storage unless all buffers are
+// in flight (counted as stall time).
+// With `direct_io` the file is opened with `O_DIRECT` to bypass the page cache,
+// all writes except the final tail are then buffer sized and aligned.
+class FlvAsyncFileWriter {
+public:
+  struct Options {
+    int buffer_size{1024 * 1024}; // rounded up to `kAlignment`
+    int buffer_count{8};
+    bool direct_io{false};
+  };
+
+  struct Stats {
+    int queue_depth;     // buffers waiting for or in `pwrite`
+    int max_queue_depth; // since `Open`
+    uint64_t bytes_written;
+    int64_t stall_us; // time `Write` waited for a free buffer
+    uint64_t stalls;
+  };
+
+  const static int kAlignment{4096};
+
+public:
+  FlvAsyncFileWriter() = default;
+  FlvAsyncFileWriter(const FlvAsyncFileWriter &) = delete;
+  FlvAsyncFileWriter &operator=(const FlvAsyncFileWriter &) = delete;
+  ~FlvAsyncFileWriter() { Close(); }
+
+public:
+  // Truncates/creates `path`. `direct_io` falls back to buffered I/O if the
+  // file system doesn't support it.
+  bool Open(const std::string &path, const Options &options);
+  bool Open(const std::string &path) { return Open(path, Options()); }
+
+  // Returns false once a write to the file has failed.
+  bool Write(const char *buff, int len);
+
+  // Writes everything pending and closes the file, false if anything failed.
+  bool Close();
+
+  Stats stats() const;
+  bool direct_io() const { return direct_io_; }
+
+private:
+  struct Buffer {
+    char *data;
+    int len;
+  };
+
+  void run();
+  bool acquireBuffer();
+  void submitBuffer();
+  bool writeBuffer(const Buffer &buffer);
+
+private:
+  int fd_{-1};
+  bool direct_io_{false};
+  int buffer_size_{0};
+  uint64_t offset_{0}; // writer thread only
+
+  std::vector<Buffer> buffers_; // owns all buffers
+  Buffer *current_{nullptr};    // being filled by `Write`
+
+  std::mutex mutex_;
+  std::condition_variable queue_cv_; // writer waits for full buffers
+  std::condition_variable free_cv_;  // `Write` waits for free buffers
+  std::deque<Buffer *> queue_;
+  std::vector<Buffer *> free_;
+  bool stop_{false};
+  std::thread writer_;
+
+  std::atomic<bool> failed_{false};
+  std::atomic<int> queue_depth_{0};
+  std::atomic<int> max_queue_depth_{0};
+  std::atomic<uint64_t> bytes_written_{0};
+  std::atomic<int64_t> stall_us_{0};
+  std::atomic<uint64_t> stalls_{0};
+};
+
+#endif
@@ -2,6 +2,7 @@
 #include "FlvCommon.h"
 
 #include <sys/time.h>
+#include <time.h>
 
 using namespace std;
 
@@ -12,6 +13,12 @@ ostream & operator << (ostream& out, FlvException& e) {
 int64_t FlvCommonUtils::GetCurrentTimeMillseconds() {
     struct timeval tv;
     gettimeofday(&tv, NULL);
-    int64_t us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
-    return us;
+    int64_t ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    return ms;
+}
+
+int64_t FlvCommonUtils::GetMonotonicTimeMicroseconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
\ No newline at end of file
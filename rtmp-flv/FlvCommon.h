@@ -14,6 +14,12 @@ enum FlvErrorCode {
     kFlvErrorNotImplemented,
     kFlvErrorBufferEmptyOrTooLessData,
     kFlvErrorTagTypeInvalid,
+    kFlvErrorTagDataSizeInvalid,
+    kFlvErrorHeaderInvalid,
+    kFlvErrorIOFailed,
+    kFlvErrorAmfDataInvalid,
+    kFlvErrorCodecConfigInvalid,
+    kFlvErrorCodecDataInvalid,
 
 };
 
@@ -43,7 +49,38 @@ protected:
 
 class FlvCommonUtils {
 public:
-    static int64_t GetCurrentTimeMillseconds();
+    static int64_t GetCurrentTimeMillseconds();     // wall clock
+    static int64_t GetMonotonicTimeMicroseconds();  // for intervals
+
+public:
+    // big-endian readers for the FLV byte stream, callers guarantee the length
+    static uint32_t ReadUInt16BE(const char* p) {
+        return (static_cast<uint32_t>(static_cast<uint8_t>(p[0])) << 8) |
+               static_cast<uint8_t>(p[1]);
+    }
+    static uint32_t ReadUInt24BE(const char* p) {
+        return (static_cast<uint32_t>(static_cast<uint8_t>(p[0])) << 16) |
+               (static_cast<uint32_t>(static_cast<uint8_t>(p[1])) << 8) |
+               static_cast<uint8_t>(p[2]);
+    }
+    static uint32_t ReadUInt32BE(const char* p) {
+        return (static_cast<uint32_t>(static_cast<uint8_t>(p[0])) << 24) |
+               ReadUInt24BE(p + 1);
+    }
+    static int32_t ReadInt24BE(const char* p) {   // SI24, sign extended
+        uint32_t v = ReadUInt24BE(p);
+        return static_cast<int32_t>((v ^ 0x800000) - 0x800000);
+    }
+    static uint64_t ReadUInt64BE(const char* p) {
+        return (static_cast<uint64_t>(ReadUInt32BE(p)) << 32) | ReadUInt32BE(p + 4);
+    }
+
+    static void WriteUInt32BE(uint32_t v, char* p) {
+        p[0] = static_cast<char>((v >> 24) & 0xFF);
+        p[1] = static_cast<char>((v >> 16) & 0xFF);
+        p[2] = static_cast<char>((v >> 8) & 0xFF);
+        p[3] = static_cast<char>(v & 0xFF);
+    }
 };
 
 
@@ -0,0 +1,330 @@
+#include "FlvEsExtractor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace {
+
+const char kAnnexBStartCode[4]{0, 0, 0, 1};
+
+const int kNaluTypeSPS = 7;
+const int kNaluTypeAUD = 9;
+
+const int kAacSampleRates[13]{96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                              22050, 16000, 12000, 11025, 8000,  7350};
+
+const int kAudioObjectTypeSBR = 5;
+const int kAudioObjectTypePS = 29;
+
+void AppendIovec(const char *p, int len, std::vector<struct iovec> *iov) {
+  iov->push_back(iovec{const_cast<char *>(p), static_cast<size_t>(len)});
+}
+
+class BitReader {
+public:
+  BitReader(const char *buff, int len) : buff_(buff), bits_(len * 8) {}
+
+  // false if less than `n` bits left
+  bool Read(int n, uint32_t *v) {
+    if (pos_ + n > bits_) {
+      return false;
+    }
+    *v = 0;
+    for (int i = 0; i < n; ++i, ++pos_) {
+      uint8_t byte = static_cast<uint8_t>(buff_[pos_ / 8]);
+      *v = (*v << 1) | ((byte >> (7 - pos_ % 8)) & 1);
+    }
+    return true;
+  }
+
+private:
+  const char *buff_;
+  int bits_;
+  int pos_{0};
+};
+
+// samplingFrequencyIndex, with escape to explicit frequency
+bool ReadSamplingFrequencyIndex(BitReader *br, uint32_t *index) {
+  if (!br->Read(4, index)) {
+    return false;
+  }
+  if (*index != 0x0F) {
+    return *index < sizeof(kAacSampleRates) / sizeof(kAacSampleRates[0]);
+  }
+  uint32_t frequency;
+  if (!br->Read(24, &frequency)) {
+    return false;
+  }
+  // ADTS can only signal an index
+  for (uint32_t i = 0; i < sizeof(kAacSampleRates) / sizeof(kAacSampleRates[0]);
+       ++i) {
+    if (static_cast<uint32_t>(kAacSampleRates[i]) == frequency) {
+      *index = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ReadAudioObjectType(BitReader *br, uint32_t *aot) {
+  if (!br->Read(5, aot)) {
+    return false;
+  }
+  if (*aot == 31) {
+    uint32_t ext;
+    if (!br->Read(6, &ext)) {
+      return false;
+    }
+    *aot = 32 + ext;
+  }
+  return true;
+}
+
+} // namespace
+
+FlvErrorCode FlvAvcAnnexBConverter::parseConfig(const char *buff, int len) {
+  nalu_length_size_ = 0;
+  parameter_sets_.clear();
+  config_.assign(buff, buff + len);
+
+  // AVCDecoderConfigurationRecord, ISO/IEC 14496-15 5.2.4.1
+  if (len < 6 || buff[0] != 1) {
+    return kFlvErrorCodecConfigInvalid;
+  }
+  int nalu_length_size = (buff[4] & 0x03) + 1;
+  if (nalu_length_size == 3) {
+    return kFlvErrorCodecConfigInvalid;
+  }
+
+  int p = 5;
+  for (int set = 0; set < 2; ++set) { // SPS, then PPS
+    if (p >= len) {
+      return kFlvErrorCodecConfigInvalid;
+    }
+    int count = set == 0 ? (buff[p] & 0x1F) : static_cast<uint8_t>(buff[p]);
+    ++p;
+    for (int i = 0; i < count; ++i) {
+      if (p + 2 > len) {
+        return kFlvErrorCodecConfigInvalid;
+      }
+      int size = FlvCommonUtils::ReadUInt16BE(buff + p);
+      p += 2;
+      if (size == 0 || p + size > len) {
+        return kFlvErrorCodecConfigInvalid;
+      }
+      parameter_sets_.push_back(ParameterSet{p, size});
+      p += size;
+    }
+  }
+
+  nalu_length_size_ = nalu_length_size;
+  return kFlvErrorOK;
+}
+
+FlvErrorCode FlvAvcAnnexBConverter::Convert(const FlvTagView &view,
+                                            std::vector<struct iovec> *iov) {
+  if (view.GetTagType() != kFlyTagTypeVideo ||
+      view.video.codec_id != kFlvCodecIDAVC) {
+    return kFlvErrorNotImplemented;
+  }
+  if (view.video.avc_packet_type == kFlvAVCPacketTypeAVCSequenceHeader) {
+    return parseConfig(view.data_pointer, view.data_length);
+  }
+  if (view.video.avc_packet_type != kFlvAVCPacketTypeAVCNALU) {
+    return kFlvErrorOK; // end of sequence carries no data
+  }
+  if (!has_config()) {
+    return kFlvErrorCodecConfigInvalid;
+  }
+
+  const size_t begin = iov->size();
+  const char *p = view.data_pointer;
+  const char *end = p + view.data_length;
+  bool has_sps = false;
+  bool has_aud = false;
+  while (p < end) {
+    if (end - p < nalu_length_size_) {
+      iov->resize(begin);
+      return kFlvErrorCodecDataInvalid;
+    }
+    uint32_t size = 0;
+    for (int i = 0; i < nalu_length_size_; ++i) {
+      size = (size << 8) | static_cast<uint8_t>(p[i]);
+    }
+    p += nalu_length_size_;
+    if (size == 0) {
+      continue;
+    }
+    if (size > static_cast<uint32_t>(end - p)) {
+      iov->resize(begin);
+      return kFlvErrorCodecDataInvalid;
+    }
+
+    int nalu_type = p[0] & 0x1F;
+    has_sps = has_sps || nalu_type == kNaluTypeSPS;
+    has_aud = has_aud || (iov->size() == begin && nalu_type == kNaluTypeAUD);
+    AppendIovec(kAnnexBStartCode, sizeof(kAnnexBStartCode), iov);
+    AppendIovec(p, size, iov);
+    p += size;
+  }
+
+  // out-of-band SPS/PPS in front of keyframes, after the AUD if any
+  if (view.IsVideoKeyFrame() && !has_sps && !parameter_sets_.empty()) {
+    std::vector<struct iovec> sets;
+    for (auto &ps : parameter_sets_) {
+      AppendIovec(kAnnexBStartCode, sizeof(kAnnexBStartCode), &sets);
+      AppendIovec(config_.data() + ps.offset, ps.len, &sets);
+    }
+    iov->insert(iov->begin() + begin + (has_aud ? 2 : 0), sets.begin(),
+                sets.end());
+  }
+  return kFlvErrorOK;
+}
+
+int FlvAacAdtsConverter::sample_rate() const {
+  return has_config() ? kAacSampleRates[sampling_frequency_index_] : 0;
+}
+
+FlvErrorCode FlvAacAdtsConverter::Convert(const FlvTagView &view,
+                                          std::vector<struct iovec> *iov) {
+  if (view.GetTagType() != kFlyTagTypeAudio ||
+      view.audio.sound_format != kFlvSoundFormatAAC) {
+    return kFlvErrorNotImplemented;
+  }
+
+  if (view.audio.aac_packet_type == kFlvAACPacketTypeSequenceHeader) {
+    // AudioSpecificConfig, ISO/IEC 14496-3 1.6.2.1
+    sampling_frequency_index_ = -1;
+    BitReader br(view.data_pointer, view.data_length);
+    uint32_t aot, index, channels;
+    if (!ReadAudioObjectType(&br, &aot) ||
+        !ReadSamplingFrequencyIndex(&br, &index) || !br.Read(4, &channels)) {
+      return kFlvErrorCodecConfigInvalid;
+    }
+    if (aot == kAudioObjectTypeSBR || aot == kAudioObjectTypePS) {
+      // explicit HE-AAC signalling, ADTS carries the core with implicit SBR
+      uint32_t extension_index;
+      if (!ReadSamplingFrequencyIndex(&br, &extension_index) ||
+          !ReadAudioObjectType(&br, &aot)) {
+        return kFlvErrorCodecConfigInvalid;
+      }
+    }
+    // ADTS profile is 2 bits, channel configuration 0 needs a PCE
+    if (aot < 1 || aot > 4 || channels == 0 || channels > 7) {
+      return kFlvErrorCodecConfigInvalid;
+    }
+    profile_ = aot - 1;
+    sampling_frequency_index_ = index;
+    channel_configuration_ = channels;
+    return kFlvErrorOK;
+  }
+
+  if (!has_config()) {
+    return kFlvErrorCodecConfigInvalid;
+  }
+  uint32_t frame_length = kAdtsHeaderLength + view.data_length;
+  if (frame_length > 0x1FFF) { // 13 bits
+    return kFlvErrorCodecDataInvalid;
+  }
+
+  // ADTS fixed + variable header, MPEG-4, no CRC, ISO/IEC 13818-7 6.2
+  adts_header_[0] = static_cast<char>(0xFF);
+  adts_header_[1] = static_cast<char>(0xF1);
+  adts_header_[2] = static_cast<char>((profile_ << 6) |
+                                      (sampling_frequency_index_ << 2) |
+                                      ((channel_configuration_ >> 2) & 0x01));
+  adts_header_[3] = static_cast<char>(((channel_configuration_ & 0x03) << 6) |
+                                      (frame_length >> 11));
+  adts_header_[4] = static_cast<char>((frame_length >> 3) & 0xFF);
+  adts_header_[5] = static_cast<char>(((frame_length & 0x07) << 5) | 0x1F);
+  adts_header_[6] = static_cast<char>(0xFC); // buffer fullness VBR, 1 block
+
+  AppendIovec(adts_header_, kAdtsHeaderLength, iov);
+  AppendIovec(view.data_pointer, view.data_length, iov);
+  return kFlvErrorOK;
+}
+
+bool FlvEsExtractor::Open(const std::string &video_file,
+                          const std::string &audio_file) {
+  Close();
+  if (!video_file.empty()) {
+    video_fd_ = open(video_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (video_fd_ < 0) {
+      return false;
+    }
+  }
+  if (!audio_file.empty()) {
+    audio_fd_ = open(audio_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (audio_fd_ < 0) {
+      Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+void FlvEsExtractor::Close() {
+  if (video_fd_ >= 0) {
+    close(video_fd_);
+    video_fd_ = -1;
+  }
+  if (audio_fd_ >= 0) {
+    close(audio_fd_);
+    audio_fd_ = -1;
+  }
+}
+
+FlvErrorCode FlvEsExtractor::OnTag(const FlvTagView &view) {
+  int fd = -1;
+  uint64_t *written = nullptr;
+  FlvErrorCode err = kFlvErrorOK;
+
+  iov_.clear();
+  if (view.GetTagType() == kFlyTagTypeVideo && video_fd_ >= 0) {
+    fd = video_fd_;
+    written = &video_bytes_;
+    err = avc_.Convert(view, &iov_);
+  } else if (view.GetTagType() == kFlyTagTypeAudio && audio_fd_ >= 0) {
+    fd = audio_fd_;
+    written = &audio_bytes_;
+    err = aac_.Convert(view, &iov_);
+  }
+  if (err != kFlvErrorOK) {
+    return err;
+  }
+  if (!iov_.empty() && !writeAll(fd, written)) {
+    return kFlvErrorIOFailed;
+  }
+  return kFlvErrorOK;
+}
+
+bool FlvEsExtractor::writeAll(int fd, uint64_t *written) {
+  struct iovec *iov = iov_.data();
+  int count = static_cast<int>(iov_.size());
+  while (count > 0) {
+    ssize_t n = writev(fd, iov, std::min(count, IOV_MAX));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    *written += n;
+
+    // skip what's written, partial writes resume inside an iovec
+    while (count > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+      n -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + n;
+      iov->iov_len -= n;
+    }
+  }
+  return true;
+}
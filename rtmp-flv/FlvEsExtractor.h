@@ -0,0 +1,96 @@
+#ifndef FLV_ES_EXTRACTOR_H_
+#define FLV_ES_EXTRACTOR_H_
+
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+
+#include "FlvCommon.h"
+#include "FlvTagView.h"
+
+// Rewrites AVC tags to Annex-B.
+// The AVCDecoderConfigurationRecord of the sequence header is kept, its
+// SPS/PPS are emitted in front of every keyframe so that the output can be
+// decoded from any IDR. Length-prefixed NALUs are rewritten by gather
+// pointers only: one start code iovec plus one iovec into the tag per NALU.
+class FlvAvcAnnexBConverter {
+public:
+  // Appends the Annex-B iovecs of `view` to `iov`, nothing for sequence
+  // headers. The iovecs point into `view` and this converter, so they're valid
+  // as long as both are and no new sequence header is converted.
+  // `kFlvErrorCodecConfigInvalid` if no valid sequence header yet.
+  FlvErrorCode Convert(const FlvTagView &view, std::vector<struct iovec> *iov);
+
+  bool has_config() const { return nalu_length_size_ > 0; }
+  int nalu_length_size() const { return nalu_length_size_; }
+
+private:
+  FlvErrorCode parseConfig(const char *buff, int len);
+
+private:
+  struct ParameterSet {
+    int offset; // in `config_`
+    int len;
+  };
+  std::vector<char> config_;
+  std::vector<ParameterSet> parameter_sets_; // SPS then PPS
+  int nalu_length_size_{0};
+};
+
+// Wraps raw AAC frames in ADTS according to the AudioSpecificConfig of the
+// sequence header.
+class FlvAacAdtsConverter {
+public:
+  // Appends ADTS header + raw frame iovecs of `view` to `iov`, nothing for
+  // sequence headers. The header lives in this converter, so the iovecs are
+  // only valid until next `Convert`.
+  FlvErrorCode Convert(const FlvTagView &view, std::vector<struct iovec> *iov);
+
+  bool has_config() const { return sampling_frequency_index_ >= 0; }
+  int sample_rate() const;
+  int channels() const { return channel_configuration_; }
+
+  const static int kAdtsHeaderLength{7};
+
+private:
+  int profile_{0}; // audioObjectType - 1
+  int sampling_frequency_index_{-1};
+  int channel_configuration_{0};
+  char adts_header_[kAdtsHeaderLength];
+};
+
+// Writes Annex-B H.264 and ADTS AAC elementary streams from FLV tags with one
+// `writev` per tag straight from the receive buffer.
+class FlvEsExtractor {
+public:
+  FlvEsExtractor() = default;
+  FlvEsExtractor(const FlvEsExtractor &) = delete;
+  ~FlvEsExtractor() { Close(); }
+
+public:
+  // Empty file name disables the stream.
+  bool Open(const std::string &video_file, const std::string &audio_file);
+  void Close();
+
+  FlvErrorCode OnTag(const FlvTagView &view);
+
+  uint64_t video_bytes() const { return video_bytes_; }
+  uint64_t audio_bytes() const { return audio_bytes_; }
+
+private:
+  bool writeAll(int fd, uint64_t *written);
+
+private:
+  int video_fd_{-1};
+  int audio_fd_{-1};
+
+  FlvAvcAnnexBConverter avc_;
+  FlvAacAdtsConverter aac_;
+  std::vector<struct iovec> iov_; // reused across tags
+
+  uint64_t video_bytes_{0};
+  uint64_t audio_bytes_{0};
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "FlvFileIndex.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "FlvHeader.h"
+#include "FlvTag.h"
+#include "FlvTagView.h"
+
+void FlvFileIndex::reset() {
+  built_.clear();
+  mapped_.Close();
+  entries_ = nullptr;
+  count_ = 0;
+  flv_file_size_ = 0;
+  tags_ = 0;
+  previous_tag_size_mismatches_ = 0;
+}
+
+FlvErrorCode FlvFileIndex::Build(const std::string &flv_file) {
+  reset();
+
+  FlvMappedFile file;
+  if (!file.Open(flv_file, true)) {
+    return kFlvErrorIOFailed;
+  }
+  char *buff = const_cast<char *>(file.data()); // read only from here on
+  uint64_t len = file.size();
+
+  if (len < FlvHeader::kFlvHeaderLength + FlvTag::kPreviousTagSizeTypeLength) {
+    return kFlvErrorBufferEmptyOrTooLessData;
+  }
+  FlvHeader fh(buff, FlvHeader::kFlvHeaderLength);
+  if (!fh.Verify()) {
+    return kFlvErrorHeaderInvalid;
+  }
+
+  uint64_t offset = fh.cost_bytes();
+  uint32_t last_tag_size = 0;
+  FlvTagView view;
+  while (offset + FlvTag::kPreviousTagSizeTypeLength <= len) {
+    if (FlvTag::FetchPreviousTagSize(buff + offset,
+                                     FlvTag::kPreviousTagSizeTypeLength) !=
+        last_tag_size) {
+      ++previous_tag_size_mismatches_;
+    }
+    offset += FlvTag::kPreviousTagSizeTypeLength;
+
+    // tags never exceed 11 + 0xFFFFFF bytes, so clamping is safe
+    int remain = static_cast<int>(
+        std::min<uint64_t>(len - offset, FlvTagView::kTagHeaderLength +
+                                             0xFFFFFF + 1));
+    FlvTagParseResult result =
+        FlvTagView::TryParse(buff + offset, remain, &view);
+    if (result.status == kFlvErrorBufferEmptyOrTooLessData) {
+      break; // truncated tail, e.g. recording still in progress
+    }
+    if (result.status != kFlvErrorOK) {
+      flv_file_size_ = len;
+      return result.status;
+    }
+    ++tags_;
+
+    // sequence headers and end of sequence tags are flagged as keyframes too
+    // but carry no picture, seeking to them would start without one
+    if (view.GetTagType() == kFlyTagTypeVideo &&
+        (view.video.frame_type == kFlvFrameTypeKeyFrame ||
+         view.video.frame_type == kFlvFrameTypeGeneratedKeyFrame) &&
+        view.IsVideoFrame()) {
+      FlvKeyframeEntry entry;
+      memset(&entry, 0, sizeof(entry));
+      entry.offset = offset;
+      entry.timestamp = view.timestamp;
+      entry.frame_type = view.video.frame_type;
+      built_.push_back(entry);
+    }
+
+    last_tag_size = result.consumed;
+    offset += result.consumed;
+  }
+
+  // already in order unless timestamps regress, keep file order for ties
+  std::stable_sort(built_.begin(), built_.end(),
+                   [](const FlvKeyframeEntry &a, const FlvKeyframeEntry &b) {
+                     return a.timestamp < b.timestamp;
+                   });
+  entries_ = built_.data();
+  count_ = built_.size();
+  flv_file_size_ = len;
+  return kFlvErrorOK;
+}
+
+bool FlvFileIndex::Save(const std::string &index_file) const {
+  SidecarHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "FLVI", sizeof(header.magic));
+  header.version = kVersion;
+  header.entry_size = sizeof(FlvKeyframeEntry);
+  header.byte_order_mark = kByteOrderMark;
+  header.count = count_;
+  header.flv_file_size = flv_file_size_;
+
+  // write to a temporary file then rename, readers never see a partial index
+  std::string tmp_file = index_file + ".tmp";
+  FILE *fp = fopen(tmp_file.c_str(), "wb");
+  if (!fp) {
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            (count_ == 0 ||
+             fwrite(entries_, sizeof(FlvKeyframeEntry), count_, fp) == count_);
+  ok = (fclose(fp) == 0) && ok;
+  if (!ok || rename(tmp_file.c_str(), index_file.c_str()) != 0) {
+    remove(tmp_file.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool FlvFileIndex::Load(const std::string &index_file) {
+  reset();
+
+  if (!mapped_.Open(index_file)) {
+    return false;
+  }
+
+  SidecarHeader header;
+  if (mapped_.size() < sizeof(header)) {
+    reset();
+    return false;
+  }
+  memcpy(&header, mapped_.data(), sizeof(header));
+  if (memcmp(header.magic, "FLVI", sizeof(header.magic)) != 0 ||
+      header.version != kVersion ||
+      header.entry_size != sizeof(FlvKeyframeEntry) ||
+      header.byte_order_mark != kByteOrderMark ||
+      (mapped_.size() - sizeof(header)) / sizeof(FlvKeyframeEntry) <
+          header.count) {
+    reset();
+    return false;
+  }
+
+  // header is 32 bytes so entries stay 8 bytes aligned in the page
+  entries_ = reinterpret_cast<const FlvKeyframeEntry *>(mapped_.data() +
+                                                        sizeof(header));
+  count_ = header.count;
+  flv_file_size_ = header.flv_file_size;
+  return true;
+}
+
+const FlvKeyframeEntry *FlvFileIndex::Seek(uint32_t timestamp) const {
+  if (count_ == 0) {
+    return nullptr;
+  }
+
+  const FlvKeyframeEntry *end = entries_ + count_;
+  const FlvKeyframeEntry *it = std::upper_bound(
+      entries_, end, timestamp,
+      [](uint32_t ts, const FlvKeyframeEntry &e) { return ts < e.timestamp; });
+  return it == entries_ ? entries_ : it - 1;
+}
@@ -0,0 +1,77 @@
+#ifndef FLV_FILE_INDEX_H_
+#define FLV_FILE_INDEX_H_
+
+#include <string>
+#include <vector>
+
+#include "FlvCommon.h"
+#include "FlvMappedFile.h"
+#include "FlvTagHeader.h"
+
+// One video keyframe of a FLV file, the on-disk layout of the sidecar entries.
+struct FlvKeyframeEntry {
+  uint64_t offset;    // byte offset of the tag in the FLV file
+  uint32_t timestamp; // tag timestamp in milliseconds
+  uint8_t frame_type; // FlvFrameType
+  uint8_t reserved[3];
+};
+static_assert(sizeof(FlvKeyframeEntry) == 16,
+              "FlvKeyframeEntry is persisted as is");
+
+// Keyframe seek table of a FLV file.
+// `Build` walks the memory mapped FLV file tag by tag without touching the
+// payloads, `Save`/`Load` persist it as a sidecar file which is memory mapped
+// again on load so that reloading costs O(1) regardless of the entry count.
+//
+// Sidecar layout (host endian):
+//   "FLVI" | version u32 | entry size u32 | byte order mark u32 |
+//   entry count u64 | FLV file size u64 | FlvKeyframeEntry[count]
+class FlvFileIndex {
+public:
+  FlvErrorCode Build(const std::string &flv_file);
+
+  bool Save(const std::string &index_file) const;
+  bool Load(const std::string &index_file);
+
+public:
+  // Last keyframe whose timestamp <= `timestamp`, or the first keyframe if
+  // all are later. nullptr if no keyframe.
+  const FlvKeyframeEntry *Seek(uint32_t timestamp) const;
+
+  const FlvKeyframeEntry *entries() const { return entries_; }
+  size_t size() const { return count_; }
+  uint64_t flv_file_size() const { return flv_file_size_; }
+
+  // tags walked and PreviousTagSize mismatches during `Build`
+  uint64_t tags() const { return tags_; }
+  uint64_t previous_tag_size_mismatches() const {
+    return previous_tag_size_mismatches_;
+  }
+
+private:
+  struct SidecarHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t byte_order_mark;
+    uint64_t count;
+    uint64_t flv_file_size;
+  };
+  const static uint32_t kVersion{1};
+  const static uint32_t kByteOrderMark{0x01020304};
+
+  void reset();
+
+private:
+  std::vector<FlvKeyframeEntry> built_; // storage after `Build`
+  FlvMappedFile mapped_;                // storage after `Load`
+
+  const FlvKeyframeEntry *entries_{nullptr};
+  size_t count_{0};
+  uint64_t flv_file_size_{0};
+
+  uint64_t tags_{0};
+  uint64_t previous_tag_size_mismatches_{0};
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "FlvGopCache.h"
+
+#include <string.h>
+
+// AMF0 string marker + u16 length + name
+static bool IsOnMetaData(const FlvTagView &view) {
+  static const char kName[] = "\x02\x00\x0AonMetaData";
+  const size_t kLength = sizeof(kName) - 1;
+  return view.data_size >= kLength &&
+         memcmp(view.body_pointer(), kName, kLength) == 0;
+}
+
+void FlvGopCache::OnTag(const FlvTagBufferPtr &tag) {
+  const FlvTagView &view = tag->view();
+  if (view.tag_type == kFlyTagTypeScriptData) {
+    if (IsOnMetaData(view)) {
+      metadata_ = tag;
+    }
+    return;
+  }
+  if (view.IsAACSequenceHeader()) {
+    audio_config_ = tag;
+    return;
+  }
+
+  if (view.tag_type == kFlyTagTypeVideo) {
+    if (view.IsVideoSequenceHeader()) {
+      // frames cached so far belong to the previous config
+      video_config_ = tag;
+      has_video_ = true;
+      has_keyframe_ = false;
+      clearGop();
+      return;
+    }
+    if (!has_video_) { // audio only so far
+      has_video_ = true;
+      has_keyframe_ = false;
+      clearGop();
+    }
+    if (view.IsVideoKeyFrame() && view.IsVideoFrame()) { // not EOS
+      has_keyframe_ = true;
+      clearGop();
+    }
+  }
+  if (has_video_ && !has_keyframe_) {
+    return; // nothing decodable before the next keyframe
+  }
+
+  gop_.push_back(tag);
+  gop_bytes_ += tag->size();
+  if (gop_bytes_ <= options_.max_bytes) {
+    return;
+  }
+
+  ++overflows_;
+  if (has_video_) {
+    has_keyframe_ = false;
+    clearGop();
+    return;
+  }
+  while (gop_bytes_ > options_.max_bytes && gop_begin_ < gop_.size()) {
+    gop_bytes_ -= gop_[gop_begin_]->size();
+    gop_[gop_begin_++].reset();
+  }
+  if (gop_begin_ * 2 >= gop_.size()) { // compact
+    gop_.erase(gop_.begin(), gop_.begin() + gop_begin_);
+    gop_begin_ = 0;
+  }
+}
+
+void FlvGopCache::Clear() {
+  metadata_.reset();
+  video_config_.reset();
+  audio_config_.reset();
+  has_video_ = false;
+  has_keyframe_ = false;
+  clearGop();
+}
+
+void FlvGopCache::Snapshot(std::vector<FlvTagBufferPtr> *tags) const {
+  tags->clear();
+  tags->reserve(3 + gop_.size() - gop_begin_);
+  for (auto config : {&metadata_, &video_config_, &audio_config_}) {
+    if (*config) {
+      tags->push_back(*config);
+    }
+  }
+  tags->insert(tags->end(), gop_.begin() + gop_begin_, gop_.end());
+}
+
+void FlvGopCache::clearGop() {
+  gop_.clear();
+  gop_bytes_ = 0;
+  gop_begin_ = 0;
+}
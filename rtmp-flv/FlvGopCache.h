@@ -0,0 +1,58 @@
+#ifndef FLV_GOP_CACHE_H_
+#define FLV_GOP_CACHE_H_
+
+#include <vector>
+
+#include "FlvTagBuffer.h"
+
+struct FlvGopCacheOptions {
+  // tags of the current GOP, a GOP exceeding it isn't cached at all
+  size_t max_bytes{16 * 1024 * 1024};
+};
+
+// Latest codec configs and the current GOP of a live stream, for priming late
+// joining consumers so that they can start decoding immediately instead of
+// waiting for the next keyframe.
+// Holds the latest onMetaData, video (AVC or Enhanced RTMP SequenceStart) and
+// AAC sequence headers, plus every tag since the last video keyframe. Audio
+// only streams keep the latest tags up to `max_bytes` instead. Not thread
+// safe, `FlvRelayHub` calls it under its lock.
+class FlvGopCache {
+public:
+  explicit FlvGopCache(const FlvGopCacheOptions &options = FlvGopCacheOptions())
+      : options_(options) {}
+  FlvGopCache(const FlvGopCache &) = delete;
+
+public:
+  void OnTag(const FlvTagBufferPtr &tag);
+  void Clear();
+
+  // configs first, then the GOP in receive order
+  void Snapshot(std::vector<FlvTagBufferPtr> *tags) const;
+
+  size_t gop_tags() const { return gop_.size(); }
+  size_t gop_bytes() const { return gop_bytes_; }
+  uint64_t overflows() const { return overflows_; }
+
+private:
+  void clearGop();
+
+private:
+  const FlvGopCacheOptions options_;
+
+  FlvTagBufferPtr metadata_;
+  FlvTagBufferPtr video_config_;
+  FlvTagBufferPtr audio_config_;
+
+  // cleared but not shrunk on keyframes, the tag memory itself is recycled by
+  // the `FlvTagBufferPool` once nobody references it anymore
+  std::vector<FlvTagBufferPtr> gop_;
+  size_t gop_bytes_{0};
+  size_t gop_begin_{0}; // audio only: first valid entry of `gop_`
+
+  bool has_video_{false};
+  bool has_keyframe_{false}; // `gop_` starts with a video keyframe
+  uint64_t overflows_{0};
+};
+
+#endif
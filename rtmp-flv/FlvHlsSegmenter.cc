@@ -0,0 +1,213 @@
+#include "FlvHlsSegmenter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+// access unit delimiter, primary_pic_type 7 (any)
+const char kAud[6]{0, 0, 0, 1, 0x09, static_cast<char>(0xF0)};
+const int kNaluTypeAUD = 9;
+
+// timestamp jumps larger than this start a new segment with a discontinuity
+const uint32_t kMaxTimestampJumpMs = 10000;
+const uint32_t kMaxTimestampRegressionMs = 1000;
+
+} // namespace
+
+FlvErrorCode FlvHlsSegmenter::OnTag(const FlvTagView &view) {
+  bool video = view.GetTagType() == kFlyTagTypeVideo;
+  bool audio = view.GetTagType() == kFlyTagTypeAudio;
+  if ((video && view.video.codec_id != kFlvCodecIDAVC) ||
+      (audio && view.audio.sound_format != kFlvSoundFormatAAC) ||
+      (!video && !audio)) {
+    return kFlvErrorOK;
+  }
+
+  iov_.clear();
+  if (view.IsAVCSequenceHeader()) {
+    FlvErrorCode err = avc_.Convert(view, &iov_);
+    if (err == kFlvErrorOK && !has_video_) {
+      has_video_ = true;
+      if (fd_ >= 0) { // audio only so far, PMT lacks video
+        discontinuity_ = true;
+        if (!closeSegment(last_timestamp_)) {
+          return kFlvErrorIOFailed;
+        }
+      }
+    }
+    return err;
+  }
+  if (view.IsAACSequenceHeader()) {
+    return aac_.Convert(view, &iov_);
+  }
+  if (video && view.video.avc_packet_type != kFlvAVCPacketTypeAVCNALU) {
+    return kFlvErrorOK;
+  }
+
+  uint32_t timestamp = view.timestamp;
+  if (fd_ >= 0 && (timestamp + kMaxTimestampRegressionMs < last_timestamp_ ||
+                   timestamp > last_timestamp_ + kMaxTimestampJumpMs)) {
+    discontinuity_ = true;
+    if (!closeSegment(last_timestamp_)) {
+      return kFlvErrorIOFailed;
+    }
+  }
+
+  // segments start with a keyframe
+  bool cut_point = has_video_ ? view.IsVideoKeyFrame() : audio;
+  if (fd_ < 0) {
+    if (!cut_point) {
+      return kFlvErrorOK;
+    }
+    if (!openSegment(timestamp)) {
+      return kFlvErrorIOFailed;
+    }
+  } else if (cut_point &&
+             timestamp - segment_start_ >= options_.target_duration_ms) {
+    if (!closeSegment(timestamp) || !openSegment(timestamp)) {
+      return kFlvErrorIOFailed;
+    }
+  }
+  last_timestamp_ = timestamp;
+
+  if (video) {
+    FlvErrorCode err = avc_.Convert(view, &iov_);
+    if (err != kFlvErrorOK) {
+      return err;
+    }
+    if (iov_.size() < 2 ||
+        (static_cast<const char *>(iov_[1].iov_base)[0] & 0x1F) !=
+            kNaluTypeAUD) {
+      iov_.insert(iov_.begin(),
+                  iovec{const_cast<char *>(kAud), sizeof(kAud)});
+    }
+    ts_.WriteVideo(timestamp,
+                   static_cast<int64_t>(timestamp) +
+                       view.video.composition_time,
+                   view.IsVideoKeyFrame(), iov_, &out_);
+  } else {
+    if (!segment_audio_) {
+      return kFlvErrorOK; // config arrived after the segment started
+    }
+    FlvErrorCode err = aac_.Convert(view, &iov_);
+    if (err != kFlvErrorOK) {
+      return err;
+    }
+    ts_.WriteAudio(timestamp, iov_, &out_);
+  }
+  return flush() ? kFlvErrorOK : kFlvErrorIOFailed;
+}
+
+void FlvHlsSegmenter::Close() {
+  if (fd_ >= 0) {
+    closeSegment(last_timestamp_);
+  }
+  if (sequence_ > 0 && !ended_) {
+    writePlaylist(true);
+    ended_ = true;
+  }
+}
+
+std::string FlvHlsSegmenter::segmentName(uint64_t sequence) const {
+  return options_.name + "-" + std::to_string(sequence) + ".ts";
+}
+
+bool FlvHlsSegmenter::openSegment(uint32_t timestamp) {
+  std::string path = options_.directory + "/" + segmentName(sequence_);
+  fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    return false;
+  }
+  current_ = Segment{sequence_++, 0, discontinuity_};
+  discontinuity_ = false;
+  segment_start_ = timestamp;
+  last_timestamp_ = timestamp;
+  segment_audio_ = aac_.has_config();
+
+  out_.clear();
+  ts_.WriteTables(has_video_, segment_audio_, &out_);
+  return flush();
+}
+
+bool FlvHlsSegmenter::closeSegment(uint32_t end_timestamp) {
+  bool ok = close(fd_) == 0;
+  fd_ = -1;
+  current_.duration_ms = end_timestamp - segment_start_;
+  max_duration_ms_ = std::max(max_duration_ms_, current_.duration_ms);
+  playlist_.push_back(current_);
+
+  while (static_cast<int>(playlist_.size()) > options_.playlist_segments) {
+    if (playlist_.front().discontinuity) {
+      ++discontinuity_sequence_;
+    }
+    expired_.push_back(playlist_.front().sequence);
+    playlist_.pop_front();
+  }
+  while (static_cast<int>(expired_.size()) > options_.keep_segments) {
+    unlink((options_.directory + "/" + segmentName(expired_.front())).c_str());
+    expired_.pop_front();
+  }
+  return writePlaylist(false) && ok;
+}
+
+bool FlvHlsSegmenter::writePlaylist(bool ended) {
+  // of the whole session rather than of the segments in the playlist, so that
+  // it doesn't drop when a long segment leaves the window, RFC 8216 6.2.1
+  uint32_t max_duration_ms =
+      std::max(options_.target_duration_ms, max_duration_ms_);
+
+  std::string path = options_.directory + "/" + options_.name + ".m3u8";
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream m3u8(tmp_path);
+    m3u8 << "#EXTM3U\n"
+         << "#EXT-X-VERSION:3\n"
+         << "#EXT-X-TARGETDURATION:" << (max_duration_ms + 999) / 1000 << "\n"
+         << "#EXT-X-MEDIA-SEQUENCE:"
+         << (playlist_.empty() ? 0 : playlist_.front().sequence) << "\n";
+    if (discontinuity_sequence_ > 0) {
+      m3u8 << "#EXT-X-DISCONTINUITY-SEQUENCE:" << discontinuity_sequence_
+           << "\n";
+    }
+    char extinf[32];
+    for (auto &s : playlist_) {
+      if (s.discontinuity) {
+        m3u8 << "#EXT-X-DISCONTINUITY\n";
+      }
+      snprintf(extinf, sizeof(extinf), "#EXTINF:%.3f,\n",
+               s.duration_ms / 1000.0);
+      m3u8 << extinf << segmentName(s.sequence) << "\n";
+    }
+    if (ended) {
+      m3u8 << "#EXT-X-ENDLIST\n";
+    }
+    if (!m3u8.flush()) {
+      return false;
+    }
+  }
+  return rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+bool FlvHlsSegmenter::flush() {
+  const char *p = out_.data();
+  size_t left = out_.size();
+  while (left > 0) {
+    ssize_t n = write(fd_, p, left);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += n;
+    left -= n;
+  }
+  out_.clear();
+  return true;
+}
@@ -0,0 +1,84 @@
+#ifndef FLV_HLS_SEGMENTER_H_
+#define FLV_HLS_SEGMENTER_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "FlvCommon.h"
+#include "FlvEsExtractor.h"
+#include "FlvTagView.h"
+#include "FlvTsMuxer.h"
+
+struct FlvHlsSegmenterOptions {
+  std::string directory{"."}; // must exist
+  std::string name{"live"};   // <name>.m3u8, <name>-<sequence>.ts
+
+  // a segment is cut at the first video keyframe (any audio frame for audio
+  // only streams) at least this far from its start
+  uint32_t target_duration_ms{4000};
+  int playlist_segments{6};
+  // segments out of the playlist are kept this long for slow clients
+  int keep_segments{6};
+};
+
+// Live HLS from FLV tags, replacing a second demux in nginx-rtmp.
+// H.264/AAC tags are muxed into MPEG-TS segments cut on keyframes according
+// to the tag timestamps, with PTS = timestamp + composition time. The rolling
+// playlist is written to a temp file and renamed over the old one, so players
+// never see a partial playlist, and only lists finished segments.
+class FlvHlsSegmenter {
+public:
+  explicit FlvHlsSegmenter(const FlvHlsSegmenterOptions &options)
+      : options_(options) {}
+  FlvHlsSegmenter(const FlvHlsSegmenter &) = delete;
+  ~FlvHlsSegmenter() { Close(); }
+
+public:
+  // Tags of other codecs are ignored, errors are codec data or IO errors.
+  FlvErrorCode OnTag(const FlvTagView &view);
+  // finishes the last segment and ends the playlist
+  void Close();
+
+  uint64_t segments() const { return sequence_; }
+
+private:
+  struct Segment {
+    uint64_t sequence;
+    uint32_t duration_ms;
+    bool discontinuity;
+  };
+
+  bool openSegment(uint32_t timestamp);
+  bool closeSegment(uint32_t end_timestamp);
+  bool writePlaylist(bool ended);
+  bool flush();
+  std::string segmentName(uint64_t sequence) const;
+
+private:
+  const FlvHlsSegmenterOptions options_;
+
+  FlvAvcAnnexBConverter avc_;
+  FlvAacAdtsConverter aac_;
+  FlvTsMuxer ts_;
+  bool has_video_{false}; // AVC sequence header seen
+  std::vector<struct iovec> iov_;
+  std::vector<char> out_; // TS packets of one tag
+
+  int fd_{-1}; // current segment
+  Segment current_{0, 0, false};
+  bool segment_audio_{false}; // in the PMT of the current segment
+  uint64_t sequence_{0};      // of the next segment
+  uint32_t segment_start_{0};
+  uint32_t last_timestamp_{0};
+  bool discontinuity_{false}; // before the next segment
+  bool ended_{false};
+
+  std::deque<Segment> playlist_;
+  std::deque<uint64_t> expired_; // removed from the playlist, still on disk
+  // longest segment so far, EXT-X-TARGETDURATION must never decrease
+  uint32_t max_duration_ms_{0};
+  uint64_t discontinuity_sequence_{0};
+};
+
+#endif
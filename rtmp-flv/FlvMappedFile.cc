@@ -0,0 +1,42 @@
+#include "FlvMappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool FlvMappedFile::Open(const std::string &path, bool sequential) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+
+  void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping keeps the file referenced
+  if (p == MAP_FAILED) {
+    return false;
+  }
+  if (sequential) {
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+  }
+
+  data_ = static_cast<const char *>(p);
+  size_ = st.st_size;
+  return true;
+}
+
+void FlvMappedFile::Close() {
+  if (data_) {
+    munmap(const_cast<char *>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
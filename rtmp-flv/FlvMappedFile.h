@@ -0,0 +1,28 @@
+#ifndef FLV_MAPPED_FILE_H_
+#define FLV_MAPPED_FILE_H_
+
+#include <stddef.h>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+class FlvMappedFile {
+public:
+  FlvMappedFile() = default;
+  FlvMappedFile(const FlvMappedFile &) = delete;
+  FlvMappedFile &operator=(const FlvMappedFile &) = delete;
+  ~FlvMappedFile() { Close(); }
+
+public:
+  // `sequential` hints the kernel for read-ahead of a single forward pass.
+  bool Open(const std::string &path, bool sequential = false);
+  void Close();
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  const char *data_{nullptr};
+  size_t size_{0};
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "FlvNalScanner.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FLV_NAL_SCANNER_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define FLV_NAL_SCANNER_NEON
+#endif
+
+namespace {
+
+using FindStartCodeFunc = const char *(*)(const char *, const char *);
+
+// Looks at every 3rd byte: a start code ending in [p, p + 2] needs p[2] <= 1.
+const char *FindStartCodeScalar(const char *p, const char *end) {
+  const uint8_t *q = reinterpret_cast<const uint8_t *>(p);
+  const uint8_t *e = reinterpret_cast<const uint8_t *>(end);
+  while (e - q >= 3) {
+    if (q[2] > 1) {
+      q += 3;
+    } else if (q[2] == 1) {
+      if (q[1] == 0 && q[0] == 0) {
+        return reinterpret_cast<const char *>(q);
+      }
+      q += 3;
+    } else {
+      ++q;
+    }
+  }
+  return end;
+}
+
+// The vector versions test the rare 0x01 byte first and only check the two
+// zeros in front of it on a hit.
+#ifdef FLV_NAL_SCANNER_X86
+__attribute__((target("sse2"))) const char *
+FindStartCodeSSE2(const char *p, const char *end) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  while (end - p >= 16 + 2) {
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 2));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(c, one));
+    if (mask) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+      mask &= _mm_movemask_epi8(
+          _mm_and_si128(_mm_cmpeq_epi8(a, zero), _mm_cmpeq_epi8(b, zero)));
+      if (mask) {
+        return p + __builtin_ctz(mask);
+      }
+    }
+    p += 16;
+  }
+  return FindStartCodeScalar(p, end);
+}
+
+__attribute__((target("avx2"))) const char *
+FindStartCodeAVX2(const char *p, const char *end) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi8(1);
+  while (end - p >= 32 + 2) {
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 2));
+    uint32_t mask = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(c, one)));
+    if (mask) {
+      __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      __m256i b =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1));
+      mask &= static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(
+          _mm256_cmpeq_epi8(a, zero), _mm256_cmpeq_epi8(b, zero))));
+      if (mask) {
+        return p + __builtin_ctz(mask);
+      }
+    }
+    p += 32;
+  }
+  return FindStartCodeScalar(p, end);
+}
+#endif
+
+#ifdef FLV_NAL_SCANNER_NEON
+const char *FindStartCodeNEON(const char *p, const char *end) {
+  const uint8x16_t one = vdupq_n_u8(1);
+  while (end - p >= 16 + 2) {
+    const uint8_t *q = reinterpret_cast<const uint8_t *>(p);
+    uint8x16_t mask = vceqq_u8(vld1q_u8(q + 2), one);
+    if (vmaxvq_u8(mask)) {
+      mask = vandq_u8(mask, vandq_u8(vceqzq_u8(vld1q_u8(q)),
+                                     vceqzq_u8(vld1q_u8(q + 1))));
+      if (vmaxvq_u8(mask)) { // no movemask, locate it in these 18 bytes
+        return FindStartCodeScalar(p, p + 16 + 2);
+      }
+    }
+    p += 16;
+  }
+  return FindStartCodeScalar(p, end);
+}
+#endif
+
+struct Dispatch {
+  FlvNalScannerImpl impl;
+  FindStartCodeFunc find;
+};
+
+Dispatch Detect() {
+#ifdef FLV_NAL_SCANNER_X86
+  __builtin_cpu_init(); // may run before the constructors of libgcc
+  if (__builtin_cpu_supports("avx2")) {
+    return Dispatch{kFlvNalScannerAVX2, FindStartCodeAVX2};
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return Dispatch{kFlvNalScannerSSE2, FindStartCodeSSE2};
+  }
+#elif defined(FLV_NAL_SCANNER_NEON)
+  return Dispatch{kFlvNalScannerNEON, FindStartCodeNEON};
+#endif
+  return Dispatch{kFlvNalScannerScalar, FindStartCodeScalar};
+}
+
+Dispatch g_dispatch = Detect();
+
+} // namespace
+
+const char *FlvNalScanner::FindStartCode(const char *p, const char *end) {
+  return g_dispatch.find(p, end);
+}
+
+int FlvNalScanner::ScanAvcc(const char *buff, int len, int nalu_length_size,
+                            FlvNalUnit *units, int max_units) {
+  if (nalu_length_size < 1 || nalu_length_size > 4) {
+    return -1;
+  }
+  int count = 0;
+  int p = 0;
+  while (p < len) {
+    if (len - p < nalu_length_size) {
+      return -1;
+    }
+    uint32_t size = 0;
+    for (int i = 0; i < nalu_length_size; ++i) {
+      size = (size << 8) | static_cast<uint8_t>(buff[p + i]);
+    }
+    p += nalu_length_size;
+    if (size > static_cast<uint32_t>(len - p)) {
+      return -1;
+    }
+    if (size > 0) {
+      if (count < max_units) {
+        units[count] = FlvNalUnit{p, static_cast<int>(size),
+                                  static_cast<uint8_t>(buff[p] & 0x1F)};
+      }
+      ++count;
+    }
+    p += size;
+  }
+  return count;
+}
+
+int FlvNalScanner::ScanAnnexB(const char *buff, int len, FlvNalUnit *units,
+                              int max_units) {
+  FindStartCodeFunc find = g_dispatch.find;
+  const char *end = buff + len;
+  const char *start_code = find(buff, end);
+  int count = 0;
+  while (start_code < end) {
+    const char *nal = start_code + 3;
+    const char *next = find(nal, end);
+    const char *nal_end = next;
+    if (next < end) { // e.g. the leading zero of a 4 bytes start code
+      while (nal_end > nal && nal_end[-1] == 0) {
+        --nal_end;
+      }
+    }
+    if (nal_end > nal) {
+      if (count < max_units) {
+        units[count] = FlvNalUnit{static_cast<int>(nal - buff),
+                                  static_cast<int>(nal_end - nal),
+                                  static_cast<uint8_t>(nal[0] & 0x1F)};
+      }
+      ++count;
+    }
+    start_code = next;
+  }
+  return count;
+}
+
+bool FlvNalScanner::Use(FlvNalScannerImpl impl) {
+  switch (impl) {
+  case kFlvNalScannerScalar:
+    g_dispatch = Dispatch{impl, FindStartCodeScalar};
+    return true;
+#ifdef FLV_NAL_SCANNER_X86
+  case kFlvNalScannerSSE2:
+    if (__builtin_cpu_supports("sse2")) {
+      g_dispatch = Dispatch{impl, FindStartCodeSSE2};
+      return true;
+    }
+    return false;
+  case kFlvNalScannerAVX2:
+    if (__builtin_cpu_supports("avx2")) {
+      g_dispatch = Dispatch{impl, FindStartCodeAVX2};
+      return true;
+    }
+    return false;
+#endif
+#ifdef FLV_NAL_SCANNER_NEON
+  case kFlvNalScannerNEON:
+    g_dispatch = Dispatch{impl, FindStartCodeNEON};
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+FlvNalScannerImpl FlvNalScanner::implementation() { return g_dispatch.impl; }
+
+const char *FlvNalScanner::implementation_name(FlvNalScannerImpl impl) {
+  switch (impl) {
+  case kFlvNalScannerScalar:
+    return "scalar";
+  case kFlvNalScannerSSE2:
+    return "SSE2";
+  case kFlvNalScannerAVX2:
+    return "AVX2";
+  case kFlvNalScannerNEON:
+    return "NEON";
+  }
+  return "unknown";
+}
@@ -0,0 +1,47 @@
+#ifndef FLV_NAL_SCANNER_H_
+#define FLV_NAL_SCANNER_H_
+
+#include <stdint.h>
+
+struct FlvNalUnit {
+  int offset; // of the NAL unit header byte in the scanned payload
+  int size;   // without start code/length prefix
+  uint8_t type; // nal_unit_type
+};
+
+enum FlvNalScannerImpl {
+  kFlvNalScannerScalar = 0,
+  kFlvNalScannerSSE2,
+  kFlvNalScannerAVX2,
+  kFlvNalScannerNEON,
+};
+
+// H.264 NAL unit scanner for video tag payloads, e.g. to classify IDR/SEI/SPS
+// for analytics without decoding.
+// The Annex-B start code search runs 16/32 bytes at a time with SSE2/AVX2 on
+// x86 and NEON on aarch64, picked at runtime according to the CPU, with a
+// scalar fallback. Both scanners write at most `max_units` entries to `units`
+// and return the total count, so a larger array can be passed again if the
+// result exceeds `max_units`, or -1 if the payload is malformed.
+class FlvNalScanner {
+public:
+  // AVCC, i.e. `FlvTagView::data_pointer` of AVC NALU tags, with the
+  // `nalu_length_size` of the AVCDecoderConfigurationRecord.
+  static int ScanAvcc(const char *buff, int len, int nalu_length_size,
+                      FlvNalUnit *units, int max_units);
+  // Annex-B, 3 or 4 bytes start codes. Zero bytes in front of a start code
+  // are trailing_zero_8bits and not counted in the previous unit.
+  static int ScanAnnexB(const char *buff, int len, FlvNalUnit *units,
+                        int max_units);
+
+  // first 00 00 01 in [`p`, `end`), `end` if none
+  static const char *FindStartCode(const char *p, const char *end);
+
+  // Switches the implementation, false if it's not supported by this CPU or
+  // build. For benchmarks, not thread safe against concurrent scanning.
+  static bool Use(FlvNalScannerImpl impl);
+  static FlvNalScannerImpl implementation();
+  static const char *implementation_name(FlvNalScannerImpl impl);
+};
+
+#endif
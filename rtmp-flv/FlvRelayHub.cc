@@ -0,0 +1,170 @@
+#include "FlvRelayHub.h"
+
+#include <algorithm>
+#include <chrono>
+
+FlvTagBufferPtr FlvRelaySubscriber::Pop(int timeout_ms) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto ready = [this] { return !queue_.empty() || closed_; };
+  if (timeout_ms < 0) {
+    cv_.wait(lock, ready);
+  } else if (!cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                           ready)) {
+    return nullptr;
+  }
+  if (queue_.empty()) {
+    return nullptr; // closed
+  }
+  FlvTagBufferPtr tag = std::move(queue_.front());
+  queue_.pop_front();
+  queued_bytes_ -= tag->size();
+  return tag;
+}
+
+size_t FlvRelaySubscriber::queued_tags() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queue_.size();
+}
+
+void FlvRelaySubscriber::push(const FlvTagBufferPtr &tag, bool has_video) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      return;
+    }
+
+    size_t size = tag->size();
+    bool config = tag->IsCodecConfig();
+    // the end of sequence tag is flagged as keyframe too but isn't decodable
+    bool keyframe =
+        tag->view().IsVideoKeyFrame() && tag->view().IsVideoFrame();
+    if (waiting_keyframe_ && !config) {
+      if (!keyframe) {
+        ++dropped_tags_;
+        return;
+      }
+      waiting_keyframe_ = false;
+    }
+
+    auto full = [&] {
+      return queue_.size() >= options_.max_tags ||
+             queued_bytes_ + size > options_.max_bytes;
+    };
+    if (!config && full()) {
+      ++drops_;
+      if (has_video) {
+        dropQueued();
+        if (!keyframe) {
+          waiting_keyframe_ = true;
+          ++dropped_tags_;
+          return;
+        }
+      } else { // no keyframes to wait for, drop the oldest
+        auto it = queue_.begin();
+        while (it != queue_.end() && full()) {
+          if ((*it)->IsCodecConfig()) {
+            ++it;
+            continue;
+          }
+          queued_bytes_ -= (*it)->size();
+          it = queue_.erase(it);
+          ++dropped_tags_;
+        }
+      }
+    }
+
+    queue_.push_back(tag);
+    queued_bytes_ += size;
+  }
+  cv_.notify_one();
+}
+
+void FlvRelaySubscriber::dropQueued() {
+  std::deque<FlvTagBufferPtr> kept;
+  for (auto &tag : queue_) {
+    if (tag->IsCodecConfig()) {
+      kept.push_back(std::move(tag));
+    } else {
+      ++dropped_tags_;
+    }
+  }
+  queue_.swap(kept);
+  queued_bytes_ = 0;
+  for (auto &tag : queue_) {
+    queued_bytes_ += tag->size();
+  }
+}
+
+void FlvRelaySubscriber::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+  }
+  cv_.notify_all();
+}
+
+FlvRelaySubscriberPtr
+FlvRelayHub::Subscribe(const FlvRelaySubscriberOptions &options) {
+  FlvRelaySubscriberPtr subscriber(new FlvRelaySubscriber(options));
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (closed_) {
+    subscriber->close();
+    return subscriber;
+  }
+  if (gop_cache_) { // under the lock, so nothing is missed or duplicated
+    gop_cache_->Snapshot(&priming_);
+    for (auto &tag : priming_) {
+      subscriber->push(tag, has_video_);
+    }
+    priming_.clear();
+  }
+  subscribers_.push_back(subscriber);
+  return subscriber;
+}
+
+void FlvRelayHub::Unsubscribe(const FlvRelaySubscriberPtr &subscriber) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribers_.erase(
+        std::remove(subscribers_.begin(), subscribers_.end(), subscriber),
+        subscribers_.end());
+  }
+  subscriber->close();
+}
+
+FlvTagBufferPtr FlvRelayHub::Publish(const FlvTagView &view) {
+  FlvTagBufferPtr tag = FlvTagBuffer::Create(view, pool_);
+  Publish(tag);
+  return tag;
+}
+
+void FlvRelayHub::Publish(const FlvTagBufferPtr &tag) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (closed_) {
+    return;
+  }
+  has_video_ = has_video_ || tag->view().tag_type == kFlyTagTypeVideo;
+  if (gop_cache_) {
+    gop_cache_->OnTag(tag);
+  }
+  for (auto &subscriber : subscribers_) {
+    subscriber->push(tag, has_video_);
+  }
+}
+
+void FlvRelayHub::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  closed_ = true;
+  for (auto &subscriber : subscribers_) {
+    subscriber->close();
+  }
+  subscribers_.clear();
+  if (gop_cache_) {
+    gop_cache_->Clear();
+  }
+}
+
+size_t FlvRelayHub::subscribers() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return subscribers_.size();
+}
@@ -0,0 +1,106 @@
+#ifndef FLV_RELAY_HUB_H_
+#define FLV_RELAY_HUB_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "FlvGopCache.h"
+#include "FlvTagBuffer.h"
+
+struct FlvRelaySubscriberOptions {
+  // queue limits, exceeding either one triggers the drop policy
+  size_t max_tags{4096};
+  size_t max_bytes{32 * 1024 * 1024};
+};
+
+// Consumer end of a `FlvRelayHub`, popped from the consumer's own thread.
+// When the consumer falls behind so that its queue overflows, queued tags are
+// dropped and so is everything published afterwards until the next video
+// keyframe, so that the consumer resumes on a decodable frame. Sequence
+// headers and script data always pass. Audio only streams drop the oldest
+// tags instead.
+class FlvRelaySubscriber {
+public:
+  explicit FlvRelaySubscriber(const FlvRelaySubscriberOptions &options)
+      : options_(options) {}
+  FlvRelaySubscriber(const FlvRelaySubscriber &) = delete;
+
+public:
+  // Waits up to `timeout_ms` (forever if < 0), nullptr on timeout or if the
+  // hub is closed and everything has been popped.
+  FlvTagBufferPtr Pop(int timeout_ms = -1);
+  FlvTagBufferPtr TryPop() { return Pop(0); }
+
+  size_t queued_tags() const;
+  uint64_t dropped_tags() const { return dropped_tags_; }
+  uint64_t drops() const { return drops_; } // overflow events
+
+private:
+  friend class FlvRelayHub;
+  void push(const FlvTagBufferPtr &tag, bool has_video);
+  void close();
+  void dropQueued(); // keep codec configs only
+
+private:
+  const FlvRelaySubscriberOptions options_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<FlvTagBufferPtr> queue_;
+  size_t queued_bytes_{0};
+  bool waiting_keyframe_{false};
+  bool closed_{false};
+
+  std::atomic<uint64_t> dropped_tags_{0};
+  std::atomic<uint64_t> drops_{0};
+};
+
+using FlvRelaySubscriberPtr = std::shared_ptr<FlvRelaySubscriber>;
+
+// Fans one FLV tag stream out to many subscribers.
+// Each tag is copied once into a pooled `FlvTagBuffer` on `Publish`, every
+// subscriber only gets a shared pointer pushed to its own bounded queue, so a
+// slow subscriber never blocks the publisher or other subscribers.
+// With the GOP cache enabled, new subscribers get the codec configs and the
+// current GOP queued on `Subscribe`, so they start from a keyframe right away.
+class FlvRelayHub {
+public:
+  FlvRelayHub() : pool_(FlvTagBufferPool::Create()) {}
+  explicit FlvRelayHub(const FlvGopCacheOptions &gop_cache)
+      : pool_(FlvTagBufferPool::Create()),
+        gop_cache_(new FlvGopCache(gop_cache)) {}
+  FlvRelayHub(const FlvRelayHub &) = delete;
+  ~FlvRelayHub() { Close(); }
+
+public:
+  FlvRelaySubscriberPtr
+  Subscribe(const FlvRelaySubscriberOptions &options =
+                FlvRelaySubscriberOptions());
+  void Unsubscribe(const FlvRelaySubscriberPtr &subscriber);
+
+  // from the ingest thread, e.g. the demuxer callback
+  FlvTagBufferPtr Publish(const FlvTagView &view);
+  void Publish(const FlvTagBufferPtr &tag);
+
+  // end of stream, subscribers drain their queues then `Pop` returns nullptr
+  void Close();
+
+  size_t subscribers() const;
+  const FlvTagBufferPoolPtr &pool() const { return pool_; }
+
+private:
+  const FlvTagBufferPoolPtr pool_;
+
+  mutable std::mutex mutex_;
+  std::vector<FlvRelaySubscriberPtr> subscribers_;
+  std::unique_ptr<FlvGopCache> gop_cache_;
+  std::vector<FlvTagBufferPtr> priming_; // reused by `Subscribe`
+  bool has_video_{false};
+  bool closed_{false};
+};
+
+#endif
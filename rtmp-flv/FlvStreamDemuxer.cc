@@ -0,0 +1,114 @@
+#include "FlvStreamDemuxer.h"
+
+#include <algorithm>
+
+#include "FlvTag.h"
+
+void FlvStreamDemuxer::Reset() {
+  state_ = kStateHeader;
+  error_ = kFlvErrorOK;
+  pending_.clear(); // keep capacity
+  required_ = FlvHeader::kFlvHeaderLength;
+  last_tag_size_ = 0;
+}
+
+int FlvStreamDemuxer::parseOne(const char *buff, int len) {
+  switch (state_) {
+  case kStateHeader: {
+    if (len < FlvHeader::kFlvHeaderLength) {
+      required_ = FlvHeader::kFlvHeaderLength;
+      return 0;
+    }
+    FlvHeader fh(const_cast<char *>(buff), len);
+    if (!fh.Verify()) {
+      error_ = kFlvErrorHeaderInvalid;
+      return -1;
+    }
+    if (header_callback_) {
+      header_callback_(fh);
+    }
+    state_ = kStatePreviousTagSize;
+    last_tag_size_ = 0; // PreviousTagSize0 is always 0
+    return fh.cost_bytes();
+  }
+  case kStatePreviousTagSize: {
+    if (len < FlvTag::kPreviousTagSizeTypeLength) {
+      required_ = FlvTag::kPreviousTagSizeTypeLength;
+      return 0;
+    }
+    if (FlvCommonUtils::ReadUInt32BE(buff) != last_tag_size_) {
+      ++previous_tag_size_mismatches_; // tolerated, some muxers write garbage
+    }
+    state_ = kStateTag;
+    return FlvTag::kPreviousTagSizeTypeLength;
+  }
+  case kStateTag: {
+    FlvTagView view;
+    FlvTagParseResult result = FlvTagView::TryParse(buff, len, &view);
+    if (result.status == kFlvErrorBufferEmptyOrTooLessData) {
+      required_ = result.required;
+      return 0;
+    }
+    if (result.status != kFlvErrorOK) {
+      error_ = result.status;
+      return -1;
+    }
+    ++parsed_tags_;
+    if (tag_callback_) {
+      tag_callback_(view);
+    }
+    last_tag_size_ = result.consumed;
+    state_ = kStatePreviousTagSize;
+    return result.consumed;
+  }
+  default:
+    return -1;
+  }
+}
+
+FlvErrorCode FlvStreamDemuxer::Feed(const char *buff, int len) {
+  if (state_ == kStateError) {
+    return error_;
+  }
+
+  // complete the carried over element by appending only the bytes it still
+  // requires, the element is parsed once as soon as it's complete.
+  while (!pending_.empty() && len > 0) {
+    int n = std::min(required_ - static_cast<int>(pending_.size()), len);
+    pending_.insert(pending_.end(), buff, buff + n);
+    buff += n;
+    len -= n;
+    if (static_cast<int>(pending_.size()) < required_) {
+      return kFlvErrorOK; // all consumed, still incomplete
+    }
+
+    int consumed = parseOne(pending_.data(), static_cast<int>(pending_.size()));
+    if (consumed < 0) {
+      state_ = kStateError;
+      return error_;
+    }
+    if (consumed > 0) {
+      parsed_bytes_ += consumed;
+      pending_.clear();
+    } // else `required_` grows, e.g. fixed tag header known
+  }
+
+  // zero-copy path, parse in place from the chunk
+  while (len > 0) {
+    int consumed = parseOne(buff, len);
+    if (consumed < 0) {
+      state_ = kStateError;
+      return error_;
+    }
+    if (consumed == 0) {
+      pending_.reserve(required_);
+      pending_.assign(buff, buff + len);
+      break;
+    }
+    parsed_bytes_ += consumed;
+    buff += consumed;
+    len -= consumed;
+  }
+
+  return kFlvErrorOK;
+}
@@ -0,0 +1,77 @@
+#ifndef FLV_STREAM_DEMUXER_H_
+#define FLV_STREAM_DEMUXER_H_
+
+#include <functional>
+#include <vector>
+
+#include "FlvCommon.h"
+#include "FlvHeader.h"
+#include "FlvTagView.h"
+
+using FlvHeaderCallback = void(FlvHeader &header);
+using FlvTagCallback = void(const FlvTagView &view);
+
+// Incremental FLV demuxer, accepts arbitrary sized byte chunks and emits every
+// complete tag through the callback.
+// Tags are parsed in place from the fed chunk whenever possible, only the
+// incomplete tail is carried over in an internal buffer which is reused
+// across calls. The `FlvTagView` passed to callbacks is only valid during the
+// callback.
+class FlvStreamDemuxer {
+public:
+  FlvStreamDemuxer() = delete;
+  FlvStreamDemuxer(const FlvStreamDemuxer &) = delete;
+  explicit FlvStreamDemuxer(std::function<FlvTagCallback> tag_callback,
+                            std::function<FlvHeaderCallback> header_callback =
+                                nullptr)
+      : tag_callback_(std::move(tag_callback)),
+        header_callback_(std::move(header_callback)) {}
+
+public:
+  // Returns `kFlvErrorOK` if all bytes have been consumed or buffered,
+  // otherwise the stream is corrupted and the demuxer stays in error state
+  // until `Reset`.
+  FlvErrorCode Feed(const char *buff, int len);
+
+  // Drop buffered bytes and expect a new FlvHeader, e.g. after reconnecting.
+  void Reset();
+
+public:
+  uint64_t parsed_tags() const { return parsed_tags_; }
+  uint64_t parsed_bytes() const { return parsed_bytes_; }
+  int buffered_bytes() const { return static_cast<int>(pending_.size()); }
+  uint64_t previous_tag_size_mismatches() const {
+    return previous_tag_size_mismatches_;
+  }
+
+private:
+  enum State {
+    kStateHeader = 0,
+    kStatePreviousTagSize,
+    kStateTag,
+    kStateError,
+  };
+
+  // Parse one element of current state from `buff`.
+  // Returns consumed bytes, 0 means need more data and `required_` has been
+  // updated, negative means error and `error_` has been set.
+  int parseOne(const char *buff, int len);
+
+private:
+  State state_{kStateHeader};
+  FlvErrorCode error_{kFlvErrorOK};
+
+  std::vector<char> pending_; // incomplete element carried over
+  int required_{FlvHeader::kFlvHeaderLength};
+
+  uint32_t last_tag_size_{0};
+
+  uint64_t parsed_tags_{0};
+  uint64_t parsed_bytes_{0};
+  uint64_t previous_tag_size_mismatches_{0};
+
+  std::function<FlvTagCallback> tag_callback_{nullptr};
+  std::function<FlvHeaderCallback> header_callback_{nullptr};
+};
+
+#endif
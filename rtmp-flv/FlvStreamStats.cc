@@ -0,0 +1,225 @@
+#include "FlvStreamStats.h"
+
+#include <string.h>
+
+#include <cmath>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<FlvStreamStatsSnapshot>::value,
+              "FlvStreamStatsSnapshot is published by words");
+
+namespace {
+
+std::string EscapeLabel(const std::string &v) {
+  std::string out;
+  for (char c : v) {
+    if (c == '\\' || c == '"') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (c == '\n') {
+      out += "\\n";
+    } else {
+      out.push_back(c);
+    }
+  }
+  return out;
+}
+
+} // namespace
+
+FlvStreamStats::FlvStreamStats() {
+  memset(&current_, 0, sizeof(current_));
+  for (auto &w : words_) {
+    w.store(0, std::memory_order_relaxed);
+  }
+}
+
+void FlvStreamStats::OnTag(const FlvTagView &view, int64_t receive_us) {
+  FlvStreamStatsSnapshot &s = current_;
+  s.last_receive_us = receive_us;
+  ++s.tags;
+
+  bool is_video = view.tag_type == kFlyTagTypeVideo;
+  bool is_audio = view.tag_type == kFlyTagTypeAudio;
+  bool is_config = view.IsAACSequenceHeader() ||
+                   (is_video && !view.IsVideoFrame());
+  if ((is_video || is_audio) && !is_config) {
+    uint32_t ts = view.timestamp;
+
+    // timestamp continuity per type, a regression restarts the baselines
+    uint32_t &last = is_video ? s.last_video_timestamp : s.last_audio_timestamp;
+    bool &has = is_video ? has_video_ : has_audio_;
+    if (has && ts < last) {
+      ++s.timestamp_regressions;
+      has_base_ = false;
+      has_keyframe_ = false;
+      last_video_receive_us_ = 0;
+    }
+    if (is_video) {
+      // interarrival jitter
+      if (has && last_video_receive_us_ > 0 && ts >= last) {
+        double d = (receive_us - last_video_receive_us_) / 1000.0 -
+                   static_cast<double>(ts - last);
+        s.video_jitter_ms += (std::fabs(d) - s.video_jitter_ms) / 16;
+      }
+      last_video_receive_us_ = receive_us;
+
+      ++s.video_frames;
+      s.video_bytes += view.data_size;
+      ++window_video_frames_;
+      window_video_bytes_ += view.data_size;
+
+      if (view.IsVideoKeyFrame()) {
+        ++s.keyframes;
+        if (has_keyframe_) {
+          s.gop_frames = frames_since_keyframe_;
+          s.keyframe_interval_ms = ts - last_keyframe_timestamp_;
+        }
+        has_keyframe_ = true;
+        last_keyframe_timestamp_ = ts;
+        frames_since_keyframe_ = 0;
+      }
+      ++frames_since_keyframe_;
+    } else {
+      ++s.audio_frames;
+      s.audio_bytes += view.data_size;
+      ++window_audio_frames_;
+      window_audio_bytes_ += view.data_size;
+    }
+    last = ts;
+    has = true;
+    if (has_video_ && has_audio_) {
+      s.av_drift_ms = static_cast<int32_t>(s.last_video_timestamp -
+                                           s.last_audio_timestamp);
+    }
+
+    // receive-to-timestamp latency
+    if (!has_base_) {
+      has_base_ = true;
+      base_receive_us_ = receive_us;
+      base_timestamp_ = ts;
+    }
+    s.latency_ms = (receive_us - base_receive_us_) / 1000 -
+                   static_cast<int64_t>(ts - base_timestamp_);
+    if (s.latency_ms > s.max_latency_ms) {
+      s.max_latency_ms = s.latency_ms;
+    }
+  }
+
+  // windowed rates
+  if (window_start_us_ == 0) {
+    window_start_us_ = receive_us;
+  } else if (receive_us - window_start_us_ >= kWindowUs) {
+    double seconds = (receive_us - window_start_us_) / 1000000.0;
+    s.video_bitrate_bps = window_video_bytes_ * 8 / seconds;
+    s.audio_bitrate_bps = window_audio_bytes_ * 8 / seconds;
+    s.video_fps = window_video_frames_ / seconds;
+    s.audio_fps = window_audio_frames_ / seconds;
+    window_start_us_ = receive_us;
+    window_video_bytes_ = window_audio_bytes_ = 0;
+    window_video_frames_ = window_audio_frames_ = 0;
+  }
+
+  publish();
+}
+
+void FlvStreamStats::publish() {
+  uint64_t words[kWords] = {};
+  memcpy(words, &current_, sizeof(current_));
+
+  uint32_t seq = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(seq + 1, std::memory_order_relaxed); // odd: writing
+  std::atomic_thread_fence(std::memory_order_release);
+  for (int i = 0; i < kWords; ++i) {
+    words_[i].store(words[i], std::memory_order_relaxed);
+  }
+  sequence_.store(seq + 2, std::memory_order_release);
+}
+
+FlvStreamStatsSnapshot FlvStreamStats::Snapshot() const {
+  uint64_t words[kWords];
+  while (true) {
+    uint32_t seq = sequence_.load(std::memory_order_acquire);
+    if (seq & 1) {
+      continue;
+    }
+    for (int i = 0; i < kWords; ++i) {
+      words[i] = words_[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) == seq) {
+      break;
+    }
+  }
+
+  FlvStreamStatsSnapshot s;
+  memcpy(&s, words, sizeof(s));
+  return s;
+}
+
+void FlvStreamStats::DumpPrometheus(
+    const std::vector<std::pair<std::string, FlvStreamStatsSnapshot>>
+        &streams,
+    std::ostream &out) {
+  struct Metric {
+    const char *name;
+    const char *type;
+    const char *help;
+    double (*value)(const FlvStreamStatsSnapshot &);
+  };
+  static const Metric kMetrics[] = {
+      {"flv_tags_total", "counter", "FLV tags received",
+       [](const FlvStreamStatsSnapshot &s) { return double(s.tags); }},
+      {"flv_video_frames_total", "counter", "Video frames received",
+       [](const FlvStreamStatsSnapshot &s) { return double(s.video_frames); }},
+      {"flv_audio_frames_total", "counter", "Audio frames received",
+       [](const FlvStreamStatsSnapshot &s) { return double(s.audio_frames); }},
+      {"flv_keyframes_total", "counter", "Video keyframes received",
+       [](const FlvStreamStatsSnapshot &s) { return double(s.keyframes); }},
+      {"flv_video_bytes_total", "counter", "Video tag data bytes received",
+       [](const FlvStreamStatsSnapshot &s) { return double(s.video_bytes); }},
+      {"flv_audio_bytes_total", "counter", "Audio tag data bytes received",
+       [](const FlvStreamStatsSnapshot &s) { return double(s.audio_bytes); }},
+      {"flv_timestamp_regressions_total", "counter",
+       "Timestamps going backwards per tag type",
+       [](const FlvStreamStatsSnapshot &s) {
+         return double(s.timestamp_regressions);
+       }},
+      {"flv_video_bitrate_bps", "gauge", "Video bitrate",
+       [](const FlvStreamStatsSnapshot &s) { return s.video_bitrate_bps; }},
+      {"flv_audio_bitrate_bps", "gauge", "Audio bitrate",
+       [](const FlvStreamStatsSnapshot &s) { return s.audio_bitrate_bps; }},
+      {"flv_video_fps", "gauge", "Video frames per second",
+       [](const FlvStreamStatsSnapshot &s) { return s.video_fps; }},
+      {"flv_audio_fps", "gauge", "Audio frames per second",
+       [](const FlvStreamStatsSnapshot &s) { return s.audio_fps; }},
+      {"flv_gop_frames", "gauge", "Video frames of the last complete GOP",
+       [](const FlvStreamStatsSnapshot &s) { return double(s.gop_frames); }},
+      {"flv_keyframe_interval_ms", "gauge",
+       "Timestamp distance of the last two keyframes",
+       [](const FlvStreamStatsSnapshot &s) {
+         return double(s.keyframe_interval_ms);
+       }},
+      {"flv_video_jitter_ms", "gauge", "Video interarrival jitter",
+       [](const FlvStreamStatsSnapshot &s) { return s.video_jitter_ms; }},
+      {"flv_av_drift_ms", "gauge",
+       "Latest video timestamp minus latest audio timestamp",
+       [](const FlvStreamStatsSnapshot &s) { return double(s.av_drift_ms); }},
+      {"flv_latency_ms", "gauge",
+       "Receive time minus timestamp relative to the first tag",
+       [](const FlvStreamStatsSnapshot &s) { return double(s.latency_ms); }},
+      {"flv_max_latency_ms", "gauge", "Maximum of flv_latency_ms",
+       [](const FlvStreamStatsSnapshot &s) {
+         return double(s.max_latency_ms);
+       }},
+  };
+
+  for (const Metric &m : kMetrics) {
+    out << "# HELP " << m.name << " " << m.help << "\n";
+    out << "# TYPE " << m.name << " " << m.type << "\n";
+    for (const auto &stream : streams) {
+      out << m.name << "{stream=\"" << EscapeLabel(stream.first) << "\"} "
+          << m.value(stream.second) << "\n";
+    }
+  }
+}
@@ -0,0 +1,102 @@
+#ifndef FLV_STREAM_STATS_H_
+#define FLV_STREAM_STATS_H_
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "FlvCommon.h"
+#include "FlvTagView.h"
+
+// Point-in-time statistics of one stream.
+// Rates are computed over the latest complete 1 second window of receive time,
+// so they go stale if the stream stalls, check `last_receive_us` for that.
+struct FlvStreamStatsSnapshot {
+  int64_t last_receive_us; // monotonic, 0 if nothing received yet
+
+  uint64_t tags;
+  uint64_t video_frames; // without sequence headers/end of sequence
+  uint64_t audio_frames;
+  uint64_t keyframes;
+  uint64_t video_bytes; // tag data
+  uint64_t audio_bytes;
+  uint64_t timestamp_regressions; // per tag type
+
+  double video_bitrate_bps;
+  double audio_bitrate_bps;
+  double video_fps;
+  double audio_fps;
+
+  uint32_t gop_frames;           // video frames of the last complete GOP
+  uint32_t keyframe_interval_ms; // timestamp distance of the last 2 keyframes
+
+  // RFC 3550 style interarrival jitter of video frames, i.e. smoothed
+  // |receive interval - timestamp interval|
+  double video_jitter_ms;
+  // latest video timestamp - latest audio timestamp
+  int32_t av_drift_ms;
+  // receive time - timestamp, relative to the first tag, positive if the feed
+  // delivers slower than real time
+  int64_t latency_ms;
+  int64_t max_latency_ms;
+
+  uint32_t last_video_timestamp;
+  uint32_t last_audio_timestamp;
+};
+
+// Real-time statistics of one stream fed by the FLV parser.
+// `OnTag` must be called from a single thread, i.e. the demuxer callback, and
+// never blocks. `Snapshot` can be called from any thread without locking: the
+// writer publishes through a seqlock and readers retry on a concurrent update.
+class FlvStreamStats {
+public:
+  FlvStreamStats();
+  FlvStreamStats(const FlvStreamStats &) = delete;
+
+public:
+  void OnTag(const FlvTagView &view) {
+    OnTag(view, FlvCommonUtils::GetMonotonicTimeMicroseconds());
+  }
+  void OnTag(const FlvTagView &view, int64_t receive_us);
+
+  FlvStreamStatsSnapshot Snapshot() const;
+
+  // Prometheus text exposition format, one `stream` labelled sample per
+  // snapshot for every metric.
+  static void DumpPrometheus(
+      const std::vector<std::pair<std::string, FlvStreamStatsSnapshot>>
+          &streams,
+      std::ostream &out);
+
+  const static int64_t kWindowUs{1000000};
+
+private:
+  void publish();
+
+private:
+  // writer only
+  FlvStreamStatsSnapshot current_;
+  int64_t window_start_us_{0};
+  uint64_t window_video_bytes_{0};
+  uint64_t window_audio_bytes_{0};
+  uint64_t window_video_frames_{0};
+  uint64_t window_audio_frames_{0};
+  bool has_video_{false};
+  bool has_audio_{false};
+  int64_t last_video_receive_us_{0};
+  bool has_keyframe_{false};
+  uint32_t last_keyframe_timestamp_{0};
+  uint32_t frames_since_keyframe_{0};
+  bool has_base_{false};
+  int64_t base_receive_us_{0};
+  uint32_t base_timestamp_{0};
+
+  // seqlock published copy of `current_`
+  const static int kWords{(sizeof(FlvStreamStatsSnapshot) + 7) / 8};
+  std::atomic<uint32_t> sequence_{0};
+  std::atomic<uint64_t> words_[kWords];
+};
+
+#endif
@@ -10,75 +10,40 @@
 #include "FlvCommon.h"
 
 FlvTag::FlvTag(char* buff, int len){
-    if (NULL == buff || len < kMinTagLength) {
-        throw FlvException(kFlvErrorBufferEmptyOrTooLessData, "Don't have enough data to construct FlvTag.");
+    FlvTagParseResult result = FlvTagView::TryParse(buff, len, &view_);
+    switch (result.status) {
+    case kFlvErrorOK:
+        break;
+    case kFlvErrorNotImplemented:
+        throw FlvException(result.status, "EncryptionHeader and FilterParam are not implemented.");
+    case kFlvErrorTagTypeInvalid:
+        throw FlvException(result.status, "Unknown TagType Value: " + std::to_string(buff[0] & 0x1F));
+    case kFlvErrorTagDataSizeInvalid:
+        throw FlvException(result.status, "DataSize " + std::to_string(result.required - kMinTagLength) + " is less than the tag header.");
+    default:
+        throw FlvException(result.status, "Don't have enough data to construct FlvTag, requires " + std::to_string(result.required) + " bytes.");
     }
 
-    filter_ = buff[0] & 0x20;
-
-    //TODO: 暂未支持Encryption和FilterParams
-    if (0 != filter_) {
-        throw FlvException(kFlvErrorNotImplemented, "EncryptionHeader and FilterParam are not implemented.");
-    }
-
-    tag_type_ = buff[0] & 0x1F;
-    if (kFlyTagTypeAudio != (FlvTagType)tag_type_
-        && kFlyTagTypeVideo != (FlvTagType)tag_type_
-        && kFlyTagTypeScriptData != (FlvTagType)tag_type_) {
-        throw FlvException(kFlvErrorTagTypeInvalid, "Unknown TagType Value: " + std::to_string(tag_type_));
-    }
-
-    data_size_ = ((buff[1] & 0xFF) << 16) | ((buff[2] & 0xFF) << 8) | (buff[3] & 0xFF);
-    
-    memcpy(&timestamp_, buff + 4, sizeof(timestamp_));
-    timestamp_ = ntohl(timestamp_);
-
-    stream_id_ = ((buff[8] & 0xFF) << 16) | ((buff[9] & 0xFF) << 8) | (buff[10] & 0xFF);   //always 0
-
-    cost_bytes_ += kMinTagLength;
-    data_pointer_ = buff + kMinTagLength;
-
-    if ((FlvTagType)tag_type_ == kFlyTagTypeAudio){
-        tag_header_ = new FlvAudioTagHeader(buff + cost_bytes_, len - cost_bytes_);
-        //cost_bytes_ += tag_header_->cost_bytes();
-        data_length_ = data_size_ - tag_header_->cost_bytes();
-        data_pointer_ += tag_header_->cost_bytes();
-    }else if ((FlvTagType)tag_type_ == kFlyTagTypeVideo){
-        tag_header_ = new FlvVideoTagHeader(buff + cost_bytes_, len - cost_bytes_);
-        //cost_bytes_ += tag_header_->cost_bytes();
-        data_length_ = data_size_ - tag_header_->cost_bytes();
-        data_pointer_ += tag_header_->cost_bytes();
-    }else{  //script data
-        data_length_ = data_size_;
-
-        //TODO: analyze script data
-    }
-
-    cost_bytes_ += data_size_;
+    //script data is decoded on demand by FlvAmfDecoder/FlvMetaDataCollector
+    cost_bytes_ = result.consumed;
 }
 
-FlvTag::~FlvTag(){
-
-    if (tag_header_){
-        delete tag_header_;
-        tag_header_ = nullptr;
-    }
-    if (tag_data_){
-        delete tag_data_;
-        tag_data_ = nullptr;
-    }
+FlvTag::FlvTag(const FlvTagView& view) : view_(view) {
+    cost_bytes_ = view_.tag_length();
 }
 
 void FlvTag::Dump()
 {
-    std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(filter_) << ": " << static_cast<int>(filter_) << std::endl;
-    std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(tag_type_) << ": " << static_cast<int>(tag_type_) << std::endl;
-    std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(data_size_) << ": " << data_size_ << std::endl;
-    std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(timestamp_) << ": " << timestamp_ << std::endl;
-    std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(stream_id_) << ": " << stream_id_ << std::endl;
+    std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(filter_) << ": " << static_cast<int>(view_.filter) << std::endl;
+    std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(tag_type_) << ": " << static_cast<int>(view_.tag_type) << std::endl;
+    std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(data_size_) << ": " << view_.data_size << std::endl;
+    std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(timestamp_) << ": " << view_.timestamp << std::endl;
+    std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(stream_id_) << ": " << view_.stream_id << std::endl;
     std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(cost_bytes_) << ": " << cost_bytes_ << std::endl;
-    if (tag_header_) {
-        tag_header_->Dump();
+    if (view_.GetTagType() == kFlyTagTypeAudio) {
+        FlvAudioTagHeader(view_.audio).Dump();
+    } else if (view_.GetTagType() == kFlyTagTypeVideo) {
+        FlvVideoTagHeader(view_.video).Dump();
     }
 }
 
@@ -94,12 +59,12 @@ uint32_t FlvTag::FetchPreviousTagSize(char * buff, int len){
 }
 
 FlvTagType FlvTag::GetTagType() {
-    return static_cast<FlvTagType>(tag_type_);
+    return view_.GetTagType();
 }
 
 char * FlvTag::GetDataPointer() {
-    return data_pointer_;
+    return const_cast<char *>(view_.data_pointer);
 }
 int FlvTag::GetTagDataLength() {
-    return data_length_;
+    return view_.data_length;
 }
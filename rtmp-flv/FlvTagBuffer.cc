@@ -0,0 +1,79 @@
+#include "FlvTagBuffer.h"
+
+#include <string.h>
+
+FlvTagBufferPtr FlvTagBuffer::Create(const FlvTagView &view,
+                                     const FlvTagBufferPoolPtr &pool) {
+  if (!pool) {
+    std::shared_ptr<FlvTagBuffer> buffer(new FlvTagBuffer);
+    buffer->assign(view);
+    return buffer;
+  }
+
+  // the deleter holds the pool, so it outlives all of its buffers
+  std::shared_ptr<FlvTagBuffer> buffer(
+      pool->get(), [pool](FlvTagBuffer *b) { pool->put(b); });
+  buffer->assign(view);
+  return buffer;
+}
+
+void FlvTagBuffer::assign(const FlvTagView &view) {
+  bytes_.resize(view.tag_length());
+
+  // header rebuilt from the fields, views from RTMP messages have none and
+  // aggregate message views carry rebased timestamps
+  char *h = bytes_.data();
+  view.WriteHeader(h);
+  memcpy(h + FlvTagView::kTagHeaderLength, view.body_pointer(),
+         view.data_size);
+
+  // re-point the view into our own copy
+  view_ = view;
+  ptrdiff_t data_offset = view.data_pointer - view.body_pointer();
+  view_.stream_id = 0;
+  view_.tag_pointer = bytes_.data();
+  view_.data_pointer =
+      bytes_.data() + FlvTagView::kTagHeaderLength + data_offset;
+}
+
+FlvTagBufferPoolPtr FlvTagBufferPool::Create(size_t max_free_buffers,
+                                             size_t max_buffer_bytes) {
+  return FlvTagBufferPoolPtr(
+      new FlvTagBufferPool(max_free_buffers, max_buffer_bytes));
+}
+
+FlvTagBufferPool::~FlvTagBufferPool() {
+  for (auto buffer : free_) {
+    delete buffer;
+  }
+}
+
+size_t FlvTagBufferPool::free_buffers() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return free_.size();
+}
+
+FlvTagBuffer *FlvTagBufferPool::get() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_.empty()) {
+      FlvTagBuffer *buffer = free_.back();
+      free_.pop_back();
+      ++reuses_;
+      return buffer;
+    }
+  }
+  ++allocations_;
+  return new FlvTagBuffer;
+}
+
+void FlvTagBufferPool::put(FlvTagBuffer *buffer) {
+  if (buffer->bytes_.capacity() <= max_buffer_bytes_) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.size() < max_free_buffers_) {
+      free_.push_back(buffer);
+      return;
+    }
+  }
+  delete buffer;
+}
@@ -0,0 +1,84 @@
+#ifndef FLV_TAG_BUFFER_H_
+#define FLV_TAG_BUFFER_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "FlvTagView.h"
+
+class FlvTagBuffer;
+class FlvTagBufferPool;
+using FlvTagBufferPtr = std::shared_ptr<const FlvTagBuffer>;
+using FlvTagBufferPoolPtr = std::shared_ptr<FlvTagBufferPool>;
+
+// Immutable, reference counted copy of one FLV tag.
+// The tag is copied once out of the receive buffer, from then on it's shared
+// by pointer between all consumers. The bytes are always FLV framed (tag
+// header + data, without PreviousTagSize), also for views decoded from RTMP
+// message payloads, so they can be written to a FLV file as is.
+class FlvTagBuffer {
+public:
+  // with a `pool`, the buffer comes from and goes back to the pool once the
+  // last reference is released
+  static FlvTagBufferPtr Create(const FlvTagView &view,
+                                const FlvTagBufferPoolPtr &pool = nullptr);
+
+public:
+  const FlvTagView &view() const { return view_; } // points into `data()`
+  const char *data() const { return bytes_.data(); }
+  int size() const { return static_cast<int>(bytes_.size()); }
+
+  // must be delivered to every consumer regardless of drop policies
+  bool IsCodecConfig() const {
+    return view_.IsVideoSequenceHeader() || view_.IsAACSequenceHeader() ||
+           view_.tag_type == kFlyTagTypeScriptData;
+  }
+
+private:
+  friend class FlvTagBufferPool;
+  FlvTagBuffer() = default;
+  void assign(const FlvTagView &view);
+
+private:
+  std::vector<char> bytes_;
+  FlvTagView view_;
+};
+
+// Free list of `FlvTagBuffer`s, so that their memory is reused from GOP to GOP
+// instead of being allocated per tag. Buffers keep their capacity while
+// pooled, those grown over `max_buffer_bytes` are freed instead of pooled.
+// Thread safe, buffers may be released from any thread.
+class FlvTagBufferPool {
+public:
+  static FlvTagBufferPoolPtr Create(size_t max_free_buffers = 1024,
+                                    size_t max_buffer_bytes = 1024 * 1024);
+  FlvTagBufferPool(const FlvTagBufferPool &) = delete;
+  ~FlvTagBufferPool();
+
+public:
+  uint64_t allocations() const { return allocations_; }
+  uint64_t reuses() const { return reuses_; }
+  size_t free_buffers() const;
+
+private:
+  friend class FlvTagBuffer;
+  FlvTagBufferPool(size_t max_free_buffers, size_t max_buffer_bytes)
+      : max_free_buffers_(max_free_buffers),
+        max_buffer_bytes_(max_buffer_bytes) {}
+  FlvTagBuffer *get();
+  void put(FlvTagBuffer *buffer);
+
+private:
+  const size_t max_free_buffers_;
+  const size_t max_buffer_bytes_;
+
+  mutable std::mutex mutex_;
+  std::vector<FlvTagBuffer *> free_;
+
+  std::atomic<uint64_t> allocations_{0};
+  std::atomic<uint64_t> reuses_{0};
+};
+
+#endif
@@ -4,26 +4,56 @@
 #include "FlvTagHeader.h"
 
 FlvAudioTagHeader::FlvAudioTagHeader(char* buff, int len)
+{
+    FlvAudioTagHeaderFields fields;
+    FlvErrorCode err = Parse(buff, len, &fields);
+    if (kFlvErrorOK != err) {
+        if (NULL == buff || len < kMinLength) {
+            throw FlvException(err, "Don't have enough data to construct FlvAudioTagHeader.");
+        }
+        throw FlvException(err, "Don't have enough data to construct AACPacketType in FlvAudioTagHeader.");
+    }
+    assign(fields);
+}
+
+FlvAudioTagHeader::FlvAudioTagHeader(const FlvAudioTagHeaderFields& fields)
+{
+    assign(fields);
+}
+
+void FlvAudioTagHeader::assign(const FlvAudioTagHeaderFields& fields)
+{
+    sound_format_ = fields.sound_format;
+    sound_rate_ = fields.sound_rate;
+    sound_size_ = fields.sound_size;
+    sound_type_ = fields.sound_type;
+    aac_packet_type_ = fields.aac_packet_type;
+    cost_bytes_ = fields.cost_bytes;
+}
+
+FlvErrorCode FlvAudioTagHeader::Parse(const char* buff, int len, FlvAudioTagHeaderFields* fields)
 {
     if (NULL == buff || len < kMinLength) {
-        throw FlvException(kFlvErrorBufferEmptyOrTooLessData, "Don't have enough data to construct FlvAudioTagHeader.");
+        return kFlvErrorBufferEmptyOrTooLessData;
     }
 
-    sound_format_ = (buff[0] & 0xF0) >> 4;
-    sound_rate_ = (buff[0] & 0xC) >> 2;
-    sound_size_ = (buff[0] & 0x2) >> 1;
-    sound_type_ = (buff[0] & 0x1);
-    cost_bytes_ += kMinLength;
+    fields->sound_format = (buff[0] & 0xF0) >> 4;
+    fields->sound_rate = (buff[0] & 0xC) >> 2;
+    fields->sound_size = (buff[0] & 0x2) >> 1;
+    fields->sound_type = (buff[0] & 0x1);
+    fields->aac_packet_type = 0;
+    fields->cost_bytes = kMinLength;
 
-    if (sound_format_ == static_cast<int>(kFlvSoundFormatAAC)) {
+    if (fields->sound_format == static_cast<int>(kFlvSoundFormatAAC)) {
         if (len < kMinLength + kAACPacketTypeLength) {
-            throw FlvException(kFlvErrorBufferEmptyOrTooLessData, "Don't have enough data to construct AACPacketType in FlvAudioTagHeader.");
+            return kFlvErrorBufferEmptyOrTooLessData;
         }
-        aac_packet_type_ = buff[1] & 0xFF;
-        cost_bytes_ += kAACPacketTypeLength;
+        fields->aac_packet_type = buff[1] & 0xFF;
+        fields->cost_bytes += kAACPacketTypeLength;
     }
 
     //TODO: verify whether values valid
+    return kFlvErrorOK;
 }
 
 FlvSoundFormat FlvAudioTagHeader::GetSoundFormat() {
@@ -53,24 +83,104 @@ void FlvAudioTagHeader::Dump() {
 }
 
 FlvVideoTagHeader::FlvVideoTagHeader(char* buff, int len) {
+    FlvVideoTagHeaderFields fields;
+    FlvErrorCode err = Parse(buff, len, &fields);
+    if (kFlvErrorOK != err) {
+        if (NULL == buff || len < kMinLength) {
+            throw FlvException(err, "Don't have enough data to construct FlvVideoTagHeader.");
+        }
+        throw FlvException(err, "Don't have enough data to construct AVCPacketType in FlvVideoTagHeader.");
+    }
+    assign(fields);
+}
+
+FlvVideoTagHeader::FlvVideoTagHeader(const FlvVideoTagHeaderFields& fields) {
+    assign(fields);
+}
+
+void FlvVideoTagHeader::assign(const FlvVideoTagHeaderFields& fields) {
+    frame_type_ = fields.frame_type;
+    codec_id_ = fields.codec_id;
+    avc_packet_type_ = fields.avc_packet_type;
+    composition_time_ = fields.composition_time;
+    is_ex_header_ = fields.is_ex_header;
+    packet_type_ = fields.packet_type;
+    video_command_ = fields.video_command;
+    fourcc_ = fields.fourcc;
+    cost_bytes_ = fields.cost_bytes;
+}
+
+FlvErrorCode FlvVideoTagHeader::Parse(const char* buff, int len, FlvVideoTagHeaderFields* fields) {
     if (NULL == buff || len < kMinLength) {
-        throw FlvException(kFlvErrorBufferEmptyOrTooLessData, "Don't have enough data to construct FlvVideoTagHeader.");
+        return kFlvErrorBufferEmptyOrTooLessData;
     }
 
-    frame_type_ = (buff[0] & 0xF0) >> 4;
-    codec_id_ = (buff[0] & 0xF);
-    cost_bytes_ += kMinLength;
+    fields->frame_type = (buff[0] & 0xF0) >> 4;
+    fields->codec_id = (buff[0] & 0xF);
+    fields->avc_packet_type = 0;
+    fields->composition_time = 0;
+    fields->is_ex_header = 0;
+    fields->packet_type = 0;
+    fields->video_command = 0;
+    fields->fourcc = 0;
+    fields->cost_bytes = kMinLength;
 
-    if (codec_id_ == static_cast<int>(kFlvCodecIDAVC)) {
+    if (buff[0] & 0x80) {
+        return parseExHeader(buff, len, fields);
+    }
+
+    if (fields->codec_id == static_cast<int>(kFlvCodecIDAVC)) {
         if (len < kMinLength + kAVCPacketTypeLength + kCompositionTimeLength) {
-            throw FlvException(kFlvErrorBufferEmptyOrTooLessData, "Don't have enough data to construct AACPacketType in FlvVideoTagHeader.");
+            return kFlvErrorBufferEmptyOrTooLessData;
         }
-        avc_packet_type_ = buff[1];
-        composition_time_ = ((buff[2] & 0xFF) << 16) | ((buff[3] & 0xFF) << 8) | (buff[4] & 0xFF);
-        cost_bytes_ += (kAVCPacketTypeLength + kCompositionTimeLength);
+        fields->avc_packet_type = buff[1];
+        fields->composition_time = FlvCommonUtils::ReadInt24BE(buff + 2);   //SI24
+        fields->cost_bytes += (kAVCPacketTypeLength + kCompositionTimeLength);
     }
 
     //TODO: verify whether values valid
+    return kFlvErrorOK;
+}
+
+FlvErrorCode FlvVideoTagHeader::parseExHeader(const char* buff, int len, FlvVideoTagHeaderFields* fields) {
+    fields->is_ex_header = 1;
+    fields->frame_type = (buff[0] & 0x70) >> 4;
+    fields->codec_id = 0;
+    fields->packet_type = buff[0] & 0xF;
+
+    // a command frame carries only the command, no FourCC nor body
+    if (fields->frame_type == static_cast<int>(kFlvFrameTypeVideoInfoOrCommandFrame) &&
+        fields->packet_type != static_cast<int>(kFlvVideoPacketTypeMetadata)) {
+        if (len < kMinLength + kVideoCommandLength) {
+            return kFlvErrorBufferEmptyOrTooLessData;
+        }
+        fields->video_command = static_cast<uint8_t>(buff[1]);
+        fields->cost_bytes += kVideoCommandLength;
+        return kFlvErrorOK;
+    }
+
+    // Multitrack and ModEx of the later revision aren't supported yet, only
+    // the first byte is consumed so that such tags are skipped, not fatal
+    if (fields->packet_type > static_cast<int>(kFlvVideoPacketTypeMPEG2TSSequenceStart)) {
+        return kFlvErrorOK;
+    }
+
+    if (len < kMinLength + kFourCCLength) {
+        return kFlvErrorBufferEmptyOrTooLessData;
+    }
+    fields->fourcc = FlvCommonUtils::ReadUInt32BE(buff + 1);
+    fields->cost_bytes += kFourCCLength;
+
+    // only HEVC has B-frames signalled by CodedFrames, CodedFramesX implies 0
+    if (fields->fourcc == static_cast<uint32_t>(kFlvVideoFourCCHEVC) &&
+        fields->packet_type == static_cast<int>(kFlvVideoPacketTypeCodedFrames)) {
+        if (len < fields->cost_bytes + kCompositionTimeLength) {
+            return kFlvErrorBufferEmptyOrTooLessData;
+        }
+        fields->composition_time = FlvCommonUtils::ReadInt24BE(buff + fields->cost_bytes);   //SI24
+        fields->cost_bytes += kCompositionTimeLength;
+    }
+    return kFlvErrorOK;
 }
 
 FlvFrameType FlvVideoTagHeader::GetFrameType() {
@@ -85,11 +195,26 @@ FlvAVCPacketType FlvVideoTagHeader::GetAVCPacketType() {
 int FlvVideoTagHeader::composition_time() {
     return composition_time_;
 }
+bool FlvVideoTagHeader::IsExHeader() {
+    return is_ex_header_ != 0;
+}
+FlvVideoPacketType FlvVideoTagHeader::GetPacketType() {
+    return static_cast<FlvVideoPacketType>(packet_type_);
+}
+FlvVideoFourCC FlvVideoTagHeader::GetFourCC() {
+    return static_cast<FlvVideoFourCC>(fourcc_);
+}
 
 void FlvVideoTagHeader::Dump() {
     std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(frame_type_) << ": " << static_cast<int>(frame_type_) << std::endl;
     std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(codec_id_) << ": " << static_cast<int>(codec_id_) << std::endl;
     std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(avc_packet_type_) << ": " << static_cast<int>(avc_packet_type_) << std::endl;
     std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(composition_time_) << ": " << static_cast<int>(composition_time_) << std::endl;
+    if (is_ex_header_) {
+        char fourcc[5]{static_cast<char>(fourcc_ >> 24), static_cast<char>(fourcc_ >> 16), static_cast<char>(fourcc_ >> 8), static_cast<char>(fourcc_), 0};
+        std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(packet_type_) << ": " << static_cast<int>(packet_type_) << std::endl;
+        std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(fourcc_) << ": " << (fourcc_ ? fourcc : "") << std::endl;
+        std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(video_command_) << ": " << static_cast<int>(video_command_) << std::endl;
+    }
     std::cout << "<" << typeid(*this).name() << "::" << __func__ << "> " << FLV_VNAME(cost_bytes_) << ": " << static_cast<int>(cost_bytes_) << std::endl;
 }
\ No newline at end of file
@@ -28,33 +28,80 @@ enum FlvCodecID { //4bits
     kFlvCodecIDAVC = 7,
 };
 
+// Enhanced RTMP, signalled by the IsExHeader bit (0x80) of the first byte:
+// UB[3] FrameType | UB[4] PacketType, followed by a FourCC instead of CodecID.
+enum FlvVideoPacketType { //4bits, if IsExHeader
+    kFlvVideoPacketTypeSequenceStart = 0,       // decoder configuration record
+    kFlvVideoPacketTypeCodedFrames = 1,         // SI24 CompositionTime for HEVC
+    kFlvVideoPacketTypeSequenceEnd = 2,
+    kFlvVideoPacketTypeCodedFramesX = 3,        // CompositionTime implied 0
+    kFlvVideoPacketTypeMetadata = 4,            // AMF encoded, e.g. colorInfo
+    kFlvVideoPacketTypeMPEG2TSSequenceStart = 5,
+};
+
+enum FlvVideoFourCC { //32bits, big endian
+    kFlvVideoFourCCAV1 = 0x61763031,    // 'av01'
+    kFlvVideoFourCCVP9 = 0x76703039,    // 'vp09'
+    kFlvVideoFourCCHEVC = 0x68766331,   // 'hvc1'
+};
+
 enum FlvAVCPacketType { //8bits
     kFlvAVCPacketTypeAVCSequenceHeader = 0,
     kFlvAVCPacketTypeAVCNALU = 1,
     kFlvAVCPakcetTypeAVCEndOfSequence = 2,
 };
 
+// Decoded VideoTagHeader, trivially copyable so that it can be embedded in
+// `FlvTagView` without any allocation.
+struct FlvVideoTagHeaderFields {
+    uint8_t frame_type;
+    uint8_t codec_id;           // 0 if `is_ex_header`
+    uint8_t avc_packet_type;
+    uint8_t cost_bytes;
+    int32_t composition_time;
+    uint8_t is_ex_header;
+    uint8_t packet_type;        // FlvVideoPacketType if `is_ex_header`
+    uint8_t video_command;      // if `is_ex_header` and a command frame
+    uint32_t fourcc;            // FlvVideoFourCC if `is_ex_header`
+};
+
 class FlvVideoTagHeader : public FlvTagHeader {
 public:
     explicit FlvVideoTagHeader(char* buff, int len);
+    explicit FlvVideoTagHeader(const FlvVideoTagHeaderFields& fields);
     virtual void Dump() override;
 
+    // non-throwing decoder shared by the constructor and `FlvTagView`
+    static FlvErrorCode Parse(const char* buff, int len, FlvVideoTagHeaderFields* fields);
+
 public:
     FlvFrameType GetFrameType();
     FlvCodecID GetCodecID();
     FlvAVCPacketType GetAVCPacketType();
     int composition_time();
 
+    bool IsExHeader();
+    FlvVideoPacketType GetPacketType();
+    FlvVideoFourCC GetFourCC();
+
 private:
     uint8_t frame_type_;
     uint8_t codec_id_;
     uint8_t avc_packet_type_;
     int composition_time_{ 0 };
+    uint8_t is_ex_header_{ 0 };
+    uint8_t packet_type_{ 0 };
+    uint8_t video_command_{ 0 };
+    uint32_t fourcc_{ 0 };
 
 private:
     const static int kMinLength{ 1 };   //1Byte
     const static int kAVCPacketTypeLength{ 1 };//1Byte
     const static int kCompositionTimeLength{ 3 };   //3Bytes
+    const static int kFourCCLength{ 4 };    //4Bytes
+    const static int kVideoCommandLength{ 1 };  //1Byte
+    void assign(const FlvVideoTagHeaderFields& fields);
+    static FlvErrorCode parseExHeader(const char* buff, int len, FlvVideoTagHeaderFields* fields);
 };
 
 
@@ -99,12 +146,27 @@ enum FlvAACPacketType { //8bits
     kFlvAACPacketTypeRaw = 1,
 };
 
+// Decoded AudioTagHeader, trivially copyable so that it can be embedded in
+// `FlvTagView` without any allocation.
+struct FlvAudioTagHeaderFields {
+    uint8_t sound_format;
+    uint8_t sound_rate;
+    uint8_t sound_size;
+    uint8_t sound_type;
+    uint8_t aac_packet_type;
+    uint8_t cost_bytes;
+};
+
 class FlvAudioTagHeader : public FlvTagHeader {
 public:
     explicit FlvAudioTagHeader(char* buff, int len);
+    explicit FlvAudioTagHeader(const FlvAudioTagHeaderFields& fields);
 
     virtual void Dump() override;
 
+    // non-throwing decoder shared by the constructor and `FlvTagView`
+    static FlvErrorCode Parse(const char* buff, int len, FlvAudioTagHeaderFields* fields);
+
 public:
     FlvSoundFormat GetSoundFormat();
     FlvSoundRate GetSoundRate();
@@ -122,6 +184,7 @@ private:
 private:
     const static int kMinLength = 1;    //1Byte
     const static int kAACPacketTypeLength = 1;  //1Byte
+    void assign(const FlvAudioTagHeaderFields& fields);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include "FlvTagPacer.h"
+
+#include <chrono>
+#include <thread>
+
+int64_t FlvTagPacer::DueTime(uint32_t timestamp) {
+  int64_t t = timestamp;
+  if (!anchored_ || t > last_timestamp_ + options_.max_jump_ms ||
+      t + options_.max_regression_ms < last_timestamp_) {
+    anchored_ = true;
+    anchor_us_ = FlvCommonUtils::GetMonotonicTimeMicroseconds();
+    anchor_timestamp_ = t;
+    ++anchors_;
+  }
+  last_timestamp_ = t;
+  return anchor_us_ +
+         static_cast<int64_t>((t - anchor_timestamp_) * 1000 / options_.speed);
+}
+
+int64_t FlvTagPacer::Wait(uint32_t timestamp) {
+  int64_t due = DueTime(timestamp);
+  int64_t now = FlvCommonUtils::GetMonotonicTimeMicroseconds();
+  if (due <= now) {
+    return now - due;
+  }
+  std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+  return 0;
+}
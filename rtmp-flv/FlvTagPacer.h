@@ -0,0 +1,44 @@
+#ifndef FLV_TAG_PACER_H_
+#define FLV_TAG_PACER_H_
+
+#include "FlvCommon.h"
+
+struct FlvTagPacerOptions {
+  double speed{1.0}; // 2.0 sends twice as fast as real time
+  // timestamps moving further than these from the previous tag re-anchor
+  // the timeline instead of stalling or bursting
+  uint32_t max_jump_ms{10000};
+  uint32_t max_regression_ms{1000};
+};
+
+// Paces tags by their timestamps against the monotonic clock, e.g. to send a
+// recording as if it was live. The first tag anchors the timeline, a tag with
+// timestamp t is due at anchor time + (t - anchor timestamp) / speed.
+// Small regressions between audio and video are due right away.
+class FlvTagPacer {
+public:
+  explicit FlvTagPacer(const FlvTagPacerOptions &options = FlvTagPacerOptions())
+      : options_(options) {}
+
+public:
+  // monotonic time in microseconds the tag is due at
+  int64_t DueTime(uint32_t timestamp);
+  // Sleeps until the tag is due, returns how late it was in microseconds.
+  int64_t Wait(uint32_t timestamp);
+
+  // The next tag anchors the timeline again, e.g. after a reconnect.
+  void Reset() { anchored_ = false; }
+
+  uint64_t anchors() const { return anchors_; }
+
+private:
+  const FlvTagPacerOptions options_;
+
+  bool anchored_{false};
+  int64_t anchor_us_{0};
+  int64_t anchor_timestamp_{0};
+  int64_t last_timestamp_{0};
+  uint64_t anchors_{0};
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "FlvTagView.h"
+
+FlvTagParseResult FlvTagView::TryParse(const char *buff, int len,
+                                       FlvTagView *view) {
+  if (NULL == buff || len < kTagHeaderLength) {
+    return FlvTagParseResult{kFlvErrorBufferEmptyOrTooLessData, 0,
+                             kTagHeaderLength};
+  }
+
+  uint8_t flags = static_cast<uint8_t>(buff[0]);
+  uint32_t data_size = FlvCommonUtils::ReadUInt24BE(buff + 1);
+  int required = kTagHeaderLength + static_cast<int>(data_size);
+
+  // TODO: 暂未支持Encryption和FilterParams
+  if (0 != (flags & 0x20)) {
+    return FlvTagParseResult{kFlvErrorNotImplemented, 0, required};
+  }
+
+  uint8_t tag_type = flags & 0x1F;
+  if (kFlyTagTypeAudio != tag_type && kFlyTagTypeVideo != tag_type &&
+      kFlyTagTypeScriptData != tag_type) {
+    return FlvTagParseResult{kFlvErrorTagTypeInvalid, 0, required};
+  }
+
+  if (len < required) {
+    return FlvTagParseResult{kFlvErrorBufferEmptyOrTooLessData, 0, required};
+  }
+
+  view->filter = 0;
+  view->tag_type = tag_type;
+  view->data_size = data_size;
+  view->timestamp = FlvCommonUtils::ReadUInt24BE(buff + 4) |
+                    (static_cast<uint32_t>(static_cast<uint8_t>(buff[7])) << 24);
+  view->stream_id = FlvCommonUtils::ReadUInt24BE(buff + 8); // always 0
+  view->tag_pointer = buff;
+  view->data_pointer = buff + kTagHeaderLength;
+  view->data_length = static_cast<int>(data_size);
+
+  if (kFlvErrorOK != parseMediaHeader(view)) {
+    // `data_size` is smaller than the audio/video tag header it announces
+    return FlvTagParseResult{kFlvErrorTagDataSizeInvalid, 0, required};
+  }
+  return FlvTagParseResult{kFlvErrorOK, required, required};
+}
+
+FlvErrorCode FlvTagView::FromPayload(uint8_t tag_type, uint32_t timestamp,
+                                     const char *payload, int len,
+                                     FlvTagView *view) {
+  if (kFlyTagTypeAudio != tag_type && kFlyTagTypeVideo != tag_type &&
+      kFlyTagTypeScriptData != tag_type) {
+    return kFlvErrorTagTypeInvalid;
+  }
+  if (len < 0 || len > 0xFFFFFF) {
+    return kFlvErrorTagDataSizeInvalid;
+  }
+
+  view->filter = 0;
+  view->tag_type = tag_type;
+  view->data_size = static_cast<uint32_t>(len);
+  view->timestamp = timestamp;
+  view->stream_id = 0;
+  view->tag_pointer = nullptr;
+  view->data_pointer = payload;
+  view->data_length = len;
+  return parseMediaHeader(view);
+}
+
+void FlvTagView::WriteHeader(char *buff) const {
+  buff[0] = static_cast<char>((filter << 5) | tag_type);
+  buff[1] = static_cast<char>((data_size >> 16) & 0xFF);
+  buff[2] = static_cast<char>((data_size >> 8) & 0xFF);
+  buff[3] = static_cast<char>(data_size & 0xFF);
+  buff[4] = static_cast<char>((timestamp >> 16) & 0xFF);
+  buff[5] = static_cast<char>((timestamp >> 8) & 0xFF);
+  buff[6] = static_cast<char>(timestamp & 0xFF);
+  buff[7] = static_cast<char>((timestamp >> 24) & 0xFF);
+  buff[8] = buff[9] = buff[10] = 0; // StreamID
+}
+
+FlvErrorCode FlvTagView::parseMediaHeader(FlvTagView *view) {
+  int cost = 0;
+  FlvErrorCode err = kFlvErrorOK;
+  if (kFlyTagTypeAudio == view->tag_type) {
+    err = FlvAudioTagHeader::Parse(view->data_pointer, view->data_length,
+                                   &view->audio);
+    cost = view->audio.cost_bytes;
+  } else if (kFlyTagTypeVideo == view->tag_type) {
+    err = FlvVideoTagHeader::Parse(view->data_pointer, view->data_length,
+                                   &view->video);
+    cost = view->video.cost_bytes;
+  }
+  if (kFlvErrorOK != err) {
+    return kFlvErrorTagDataSizeInvalid;
+  }
+  view->data_pointer += cost;
+  view->data_length -= cost;
+  return kFlvErrorOK;
+}
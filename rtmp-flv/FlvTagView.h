@@ -0,0 +1,116 @@
+#ifndef FLV_TAG_VIEW_H_
+#define FLV_TAG_VIEW_H_
+
+#include <type_traits>
+
+#include "FlvCommon.h"
+#include "FlvTagHeader.h"
+
+enum FlvTagType {
+  kFlyTagTypeAudio = 8,
+  kFlyTagTypeVideo = 9,
+  kFlyTagTypeScriptData = 18,
+};
+
+struct FlvTagParseResult {
+  FlvErrorCode status;
+
+  // bytes of the whole tag (without the following PreviousTagSize) if
+  // `status == kFlvErrorOK`, otherwise 0.
+  int consumed;
+
+  // bytes required to parse the whole tag, i.e. `kFlvErrorBufferEmptyOrTooLessData`
+  // means the caller should provide at least `required` bytes next time.
+  // It's `kTagHeaderLength` until the fixed tag header is available.
+  int required;
+};
+
+// Non-allocating, non-throwing parse result of one FLV tag.
+// All pointers point into the buffer passed to `TryParse`, so the view is only
+// valid as long as that buffer is.
+struct FlvTagView {
+  uint8_t filter;
+  uint8_t tag_type;
+  uint32_t data_size;
+  uint32_t timestamp; // UI24 Timestamp | TimestampExtended << 24
+  uint32_t stream_id;
+
+  const char *tag_pointer;  // first byte of the tag, nullptr if `FromPayload`
+  const char *data_pointer; // payload after audio/video tag header
+  int data_length;
+
+  union { // decoded according to `tag_type`, untouched for script data
+    FlvAudioTagHeaderFields audio;
+    FlvVideoTagHeaderFields video;
+  };
+
+public:
+  static FlvTagParseResult TryParse(const char *buff, int len,
+                                    FlvTagView *view);
+
+  // View of a tag body whose header fields come from elsewhere, e.g. the
+  // payload of a RTMP audio/video/data message.
+  static FlvErrorCode FromPayload(uint8_t tag_type, uint32_t timestamp,
+                                  const char *payload, int len,
+                                  FlvTagView *view);
+
+  const static int kTagHeaderLength{11}; // until StreamID
+
+public:
+  FlvTagType GetTagType() const { return static_cast<FlvTagType>(tag_type); }
+  int tag_length() const { return kTagHeaderLength + data_size; }
+  // tag data including the audio/video tag header, `data_size` bytes
+  const char *body_pointer() const {
+    return data_pointer - (static_cast<int>(data_size) - data_length);
+  }
+  // Serialises the `kTagHeaderLength` bytes tag header from the fields, e.g.
+  // for views of RTMP messages or with a rebased `timestamp`. StreamID is 0.
+  void WriteHeader(char *buff) const;
+
+  bool IsVideoKeyFrame() const {
+    return tag_type == kFlyTagTypeVideo &&
+           video.frame_type == kFlvFrameTypeKeyFrame;
+  }
+  bool IsAVCSequenceHeader() const {
+    return tag_type == kFlyTagTypeVideo && video.codec_id == kFlvCodecIDAVC &&
+           video.avc_packet_type == kFlvAVCPacketTypeAVCSequenceHeader;
+  }
+  bool IsVideoExHeader() const {
+    return tag_type == kFlyTagTypeVideo && video.is_ex_header;
+  }
+  // AVC sequence header or Enhanced RTMP SequenceStart, `data_pointer` is the
+  // decoder configuration record, e.g. HEVCDecoderConfigurationRecord
+  bool IsVideoSequenceHeader() const {
+    return IsAVCSequenceHeader() ||
+           (IsVideoExHeader() &&
+            video.packet_type == kFlvVideoPacketTypeSequenceStart);
+  }
+  // a picture, `data_pointer` is its NAL units/OBUs, i.e. no sequence
+  // start/end, metadata or command frame
+  bool IsVideoFrame() const {
+    if (tag_type != kFlyTagTypeVideo ||
+        video.frame_type == kFlvFrameTypeVideoInfoOrCommandFrame) {
+      return false;
+    }
+    if (video.is_ex_header) {
+      return video.packet_type == kFlvVideoPacketTypeCodedFrames ||
+             video.packet_type == kFlvVideoPacketTypeCodedFramesX;
+    }
+    return video.codec_id != kFlvCodecIDAVC ||
+           video.avc_packet_type == kFlvAVCPacketTypeAVCNALU;
+  }
+  bool IsAACSequenceHeader() const {
+    return tag_type == kFlyTagTypeAudio &&
+           audio.sound_format == kFlvSoundFormatAAC &&
+           audio.aac_packet_type == kFlvAACPacketTypeSequenceHeader;
+  }
+
+private:
+  // decode the audio/video tag header at `data_pointer`
+  static FlvErrorCode parseMediaHeader(FlvTagView *view);
+};
+
+static_assert(std::is_trivially_copyable<FlvTagView>::value,
+              "FlvTagView must be trivially copyable");
+
+#endif
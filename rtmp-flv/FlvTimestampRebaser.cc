@@ -0,0 +1,52 @@
+#include "FlvTimestampRebaser.h"
+
+#include <algorithm>
+
+#include "FlvTagView.h"
+
+uint32_t FlvTimestampRebaser::Rebase(uint8_t tag_type, uint32_t timestamp) {
+  int64_t input = timestamp;
+  int64_t output = 0;
+  int i = tag_type == kFlyTagTypeAudio ? 0
+                                       : (tag_type == kFlyTagTypeVideo ? 1 : 2);
+  if (i == 2) {
+    // script data is usually stamped 0 regardless of the media timeline, it
+    // neither starts nor breaks a segment
+    output = segment_started_ ? input + offset_ : -1;
+    if (output < 0) {
+      output = max_output_;
+    }
+  } else {
+    if (segment_started_ &&
+        (input + options_.max_regression_ms < last_input_ ||
+         input > last_input_ + options_.max_jump_ms)) {
+      segment_started_ = false;
+    }
+    if (!segment_started_) {
+      if (started_) {
+        ++discontinuities_;
+        offset_ = max_output_ + options_.discontinuity_gap_ms - input;
+      } else {
+        offset_ = -input;
+      }
+      started_ = segment_started_ = true;
+    }
+    last_input_ = input;
+    output = input + offset_;
+  }
+
+  if (output < last_output_[i]) {
+    output = last_output_[i];
+    ++clamped_;
+  }
+  last_output_[i] = output;
+  max_output_ = std::max(max_output_, output);
+  return static_cast<uint32_t>(output);
+}
+
+void FlvTimestampRebaser::Clear() {
+  started_ = segment_started_ = false;
+  offset_ = last_input_ = max_output_ = 0;
+  last_output_[0] = last_output_[1] = last_output_[2] = 0;
+  discontinuities_ = clamped_ = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef FLV_TIMESTAMP_REBASER_H_
+#define FLV_TIMESTAMP_REBASER_H_
+
+#include "FlvCommon.h"
+
+struct FlvTimestampRebaserOptions {
+  // timestamps jumping further than these from the previous tag of any type
+  // start a new segment
+  uint32_t max_jump_ms{10000};
+  uint32_t max_regression_ms{1000};
+  // distance between the last tag of a segment and the first of the next one
+  uint32_t discontinuity_gap_ms{40};
+};
+
+// Maps input tag timestamps onto a continuous output timeline starting at 0.
+// Audio and video share one offset so that A/V sync survives, the offset is
+// only recomputed when the input jumps beyond the thresholds or after `Reset`,
+// e.g. an encoder restart or a reconnect. Script data follows the current
+// offset without affecting it. Per tag type the output never goes backwards,
+// regressions within the thresholds are clamped.
+class FlvTimestampRebaser {
+public:
+  explicit FlvTimestampRebaser(
+      const FlvTimestampRebaserOptions &options = FlvTimestampRebaserOptions())
+      : options_(options) {}
+
+public:
+  uint32_t Rebase(uint8_t tag_type, uint32_t timestamp);
+
+  // The next tag starts a new segment.
+  void Reset() { segment_started_ = false; }
+  // Forget everything, the next tag is mapped to 0 again.
+  void Clear();
+
+  // largest output timestamp so far
+  uint32_t last_timestamp() const {
+    return static_cast<uint32_t>(max_output_);
+  }
+  uint64_t discontinuities() const { return discontinuities_; }
+  uint64_t clamped() const { return clamped_; }
+
+private:
+  const FlvTimestampRebaserOptions options_;
+
+  bool started_{false};         // any audio/video tag seen
+  bool segment_started_{false}; // `offset_` valid
+  int64_t offset_{0};
+  int64_t last_input_{0};
+  int64_t max_output_{0};
+  int64_t last_output_[3]{0, 0, 0}; // audio, video, script data
+
+  uint64_t discontinuities_{0};
+  uint64_t clamped_{0};
+};
+
+#endif
@@ -0,0 +1,264 @@
+#include "FlvTrace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// encoded bytes collected before a `write`
+const size_t kFlushBytes = 256 * 1024;
+// records consumed before publishing `tail_` while draining a backlog
+const uint64_t kDrainBatch = 1024;
+// longest NDJSON line
+const int kMaxJsonLength = 256;
+
+} // namespace
+
+FlvTraceRecord FlvTraceRecord::FromView(const FlvTagView &view,
+                                        uint32_t stream,
+                                        int64_t receive_time_us) {
+  FlvTraceRecord r{};
+  r.receive_time_us = receive_time_us;
+  r.stream = stream;
+  r.timestamp = view.timestamp;
+  r.data_size = view.data_size;
+  r.tag_type = view.tag_type;
+  r.flags = view.filter ? kFlvTraceFlagFilter : 0;
+  if (view.GetTagType() == kFlyTagTypeAudio) {
+    r.codec = view.audio.sound_format;
+    r.format = static_cast<uint8_t>(view.audio.sound_rate << 2 |
+                                    view.audio.sound_size << 1 |
+                                    view.audio.sound_type);
+    r.packet_type = view.audio.aac_packet_type;
+  } else if (view.GetTagType() == kFlyTagTypeVideo) {
+    r.format = view.video.frame_type;
+    r.composition_time = view.video.composition_time;
+    if (view.video.is_ex_header) {
+      r.codec = view.video.fourcc;
+      r.packet_type = view.video.packet_type;
+      r.flags |= kFlvTraceFlagExHeader;
+    } else {
+      r.codec = view.video.codec_id;
+      r.packet_type = view.video.avc_packet_type;
+    }
+  }
+  return r;
+}
+
+int FlvTraceRecord::FormatJson(const FlvTraceRecord &r, char *buff, int len) {
+  int n = snprintf(buff, len,
+                   "{\"us\":%" PRId64 ",\"stream\":%" PRIu32
+                   ",\"ts\":%" PRIu32 ",\"size\":%" PRIu32,
+                   r.receive_time_us, r.stream, r.timestamp, r.data_size);
+  if (n < 0 || n >= len) {
+    return n;
+  }
+  if (r.flags & kFlvTraceFlagFilter) {
+    n += snprintf(buff + n, len - n, ",\"filter\":true");
+  }
+  if (n >= len) {
+    return n;
+  }
+
+  switch (r.tag_type) {
+  case kFlyTagTypeAudio:
+    n += snprintf(buff + n, len - n,
+                  ",\"type\":\"audio\",\"sound_format\":%" PRIu32
+                  ",\"sound_rate\":%d,\"sound_size\":%d,\"sound_type\":%d"
+                  ",\"packet_type\":%d}\n",
+                  r.codec, (r.format >> 2) & 0x03, (r.format >> 1) & 0x01,
+                  r.format & 0x01, r.packet_type);
+    break;
+  case kFlyTagTypeVideo:
+    if (r.flags & kFlvTraceFlagExHeader) {
+      char fourcc[5]{static_cast<char>(r.codec >> 24),
+                     static_cast<char>(r.codec >> 16),
+                     static_cast<char>(r.codec >> 8),
+                     static_cast<char>(r.codec), 0};
+      for (int i = 0; i < 4; ++i) { // keep the JSON valid
+        if (fourcc[i] < 0x20 || fourcc[i] == '"' || fourcc[i] == '\\') {
+          fourcc[i] = '?';
+        }
+      }
+      n += snprintf(buff + n, len - n, ",\"type\":\"video\",\"fourcc\":\"%s\"",
+                    fourcc);
+    } else {
+      n += snprintf(buff + n, len - n,
+                    ",\"type\":\"video\",\"codec_id\":%" PRIu32, r.codec);
+    }
+    if (n >= len) {
+      return n;
+    }
+    n += snprintf(buff + n, len - n,
+                  ",\"frame_type\":%d,\"packet_type\":%d,\"cts\":%" PRId32
+                  "}\n",
+                  r.format, r.packet_type, r.composition_time);
+    break;
+  default:
+    n += snprintf(buff + n, len - n, ",\"type\":\"script\"}\n");
+    break;
+  }
+  return n;
+}
+
+FlvTraceFileHeader FlvTraceFileHeader::Create() {
+  return FlvTraceFileHeader{{'F', 'L', 'V', 'T'},
+                            kVersion,
+                            sizeof(FlvTraceRecord),
+                            kByteOrderMark};
+}
+
+bool FlvTraceFileHeader::Verify() const {
+  return memcmp(magic, "FLVT", 4) == 0 && version == kVersion &&
+         record_size == sizeof(FlvTraceRecord) &&
+         byte_order_mark == kByteOrderMark;
+}
+
+bool FlvTraceWriter::Open(const std::string &path, const Options &options) {
+  Close();
+  fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    return false;
+  }
+
+  uint64_t capacity = 1;
+  while (capacity < static_cast<uint64_t>(std::max(options.capacity, 2))) {
+    capacity <<= 1;
+  }
+  ring_.resize(capacity);
+  mask_ = capacity - 1;
+  head_ = tail_ = 0;
+  cached_tail_ = 0;
+  dropped_ = 0;
+  format_ = options.format;
+  flush_interval_ms_ = std::max(options.flush_interval_ms, 1);
+
+  out_.clear();
+  out_.reserve(kFlushBytes + kMaxJsonLength);
+  if (format_ == kFlvTraceFormatBinary) {
+    FlvTraceFileHeader header = FlvTraceFileHeader::Create();
+    const char *p = reinterpret_cast<const char *>(&header);
+    out_.insert(out_.end(), p, p + sizeof(header));
+  }
+
+  stop_ = false;
+  failed_ = false;
+  records_ = 0;
+  writer_ = std::thread(&FlvTraceWriter::run, this);
+  return true;
+}
+
+void FlvTraceWriter::Write(const FlvTraceRecord &record) {
+  if (ring_.empty()) {
+    return; // not opened
+  }
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  uint64_t capacity = mask_ + 1;
+  if (head - cached_tail_ >= capacity) {
+    cached_tail_ = tail_.load(std::memory_order_acquire);
+    if (head - cached_tail_ >= capacity) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+  ring_[head & mask_] = record;
+  head_.store(head + 1, std::memory_order_release);
+
+  // wake the writer early under load, once per half ring. A wakeup missed
+  // while it is about to park only delays the records by one interval.
+  if (((head + 1) & (capacity / 2 - 1)) == 0 &&
+      waiting_.load(std::memory_order_relaxed)) {
+    cv_.notify_one();
+  }
+}
+
+bool FlvTraceWriter::Close() {
+  if (writer_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    writer_.join();
+  }
+
+  bool ok = !failed_;
+  if (fd_ >= 0) {
+    ok = close(fd_) == 0 && ok;
+    fd_ = -1;
+  }
+  ring_.clear();
+  ring_.shrink_to_fit();
+  return ok;
+}
+
+void FlvTraceWriter::run() {
+  bool stop = false;
+  while (!stop) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!stop_) {
+        waiting_.store(true, std::memory_order_relaxed);
+        cv_.wait_for(lock, std::chrono::milliseconds(flush_interval_ms_));
+        waiting_.store(false, std::memory_order_relaxed);
+      }
+      stop = stop_;
+    }
+    drain();
+  }
+}
+
+void FlvTraceWriter::drain() {
+  uint64_t tail = tail_.load(std::memory_order_relaxed);
+  uint64_t head = head_.load(std::memory_order_acquire);
+  while (tail != head) {
+    uint64_t begin = tail;
+    uint64_t end = std::min(head, tail + kDrainBatch);
+    for (; tail != end; ++tail) {
+      const FlvTraceRecord &r = ring_[tail & mask_];
+      if (format_ == kFlvTraceFormatBinary) {
+        const char *p = reinterpret_cast<const char *>(&r);
+        out_.insert(out_.end(), p, p + sizeof(r));
+      } else {
+        size_t size = out_.size();
+        out_.resize(size + kMaxJsonLength);
+        int n = FlvTraceRecord::FormatJson(r, out_.data() + size,
+                                           kMaxJsonLength);
+        out_.resize(size + std::min(std::max(n, 0), kMaxJsonLength - 1));
+      }
+    }
+    tail_.store(tail, std::memory_order_release);
+    records_.fetch_add(end - begin, std::memory_order_relaxed);
+    if (out_.size() >= kFlushBytes) {
+      flush();
+    }
+    head = head_.load(std::memory_order_acquire);
+  }
+  flush();
+}
+
+bool FlvTraceWriter::flush() {
+  const char *p = out_.data();
+  size_t left = out_.size();
+  while (left > 0 && !failed_) {
+    ssize_t n = write(fd_, p, left);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      failed_ = true;
+      break;
+    }
+    p += n;
+    left -= n;
+  }
+  out_.clear();
+  return !failed_;
+}
@@ -0,0 +1,137 @@
+#ifndef FLV_TRACE_H_
+#define FLV_TRACE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FlvCommon.h"
+#include "FlvTagView.h"
+
+enum FlvTraceRecordFlag {
+  kFlvTraceFlagFilter = 0x01,   // Filter bit of the tag header
+  kFlvTraceFlagExHeader = 0x02, // Enhanced RTMP video, `codec` is a FourCC
+};
+
+// One traced tag, persisted as is by the binary format.
+struct FlvTraceRecord {
+  int64_t receive_time_us; // monotonic clock
+  uint32_t stream;         // caller defined, e.g. index of the stream
+  uint32_t timestamp;
+  uint32_t data_size;
+  int32_t composition_time; // video only
+  uint32_t codec;           // SoundFormat, CodecID or FourCC
+  uint8_t tag_type;
+  // audio: SoundRate << 2 | SoundSize << 1 | SoundType, video: FrameType
+  uint8_t format;
+  // AACPacketType, AVCPacketType or Enhanced RTMP PacketType
+  uint8_t packet_type;
+  uint8_t flags; // FlvTraceRecordFlag
+
+  static FlvTraceRecord FromView(const FlvTagView &view, uint32_t stream,
+                                 int64_t receive_time_us);
+
+  // One NDJSON line incl. '\n' with the fields of the tag type, returns the
+  // length like `snprintf`.
+  static int FormatJson(const FlvTraceRecord &record, char *buff, int len);
+};
+static_assert(sizeof(FlvTraceRecord) == 32,
+              "FlvTraceRecord is persisted as is");
+
+// Binary trace file layout (host endian):
+//   "FLVT" | version u32 | record size u32 | byte order mark u32 |
+//   FlvTraceRecord[]
+struct FlvTraceFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t byte_order_mark;
+
+  const static uint32_t kVersion{1};
+  const static uint32_t kByteOrderMark{0x01020304};
+
+  static FlvTraceFileHeader Create();
+  bool Verify() const;
+};
+
+enum FlvTraceFormat {
+  kFlvTraceFormatBinary = 0,
+  kFlvTraceFormatNdjson,
+};
+
+// Receives one record per tag, replaces the per-field `Dump` of tags on hot
+// paths.
+class FlvTraceSink {
+public:
+  virtual ~FlvTraceSink() = default;
+  virtual void Write(const FlvTraceRecord &record) = 0;
+};
+
+// Writes trace records to a file from a background thread.
+// `Write` only copies the record into a lock-free single producer/single
+// consumer ring and never blocks, records are dropped and counted if the ring
+// is full. The writer thread wakes up periodically, or once the ring is half
+// full, encodes the pending records in the configured format and writes them
+// in large chunks. The early wakeup is the only syscall `Write` may make, at
+// most once per half ring and only while the writer thread is parked.
+// `Write` must be called from one thread at a time.
+class FlvTraceWriter : public FlvTraceSink {
+public:
+  struct Options {
+    FlvTraceFormat format{kFlvTraceFormatBinary};
+    int capacity{64 * 1024}; // records, rounded up to a power of 2
+    int flush_interval_ms{100};
+  };
+
+public:
+  FlvTraceWriter() = default;
+  FlvTraceWriter(const FlvTraceWriter &) = delete;
+  FlvTraceWriter &operator=(const FlvTraceWriter &) = delete;
+  ~FlvTraceWriter() { Close(); }
+
+public:
+  bool Open(const std::string &path, const Options &options);
+  bool Open(const std::string &path) { return Open(path, Options()); }
+
+  void Write(const FlvTraceRecord &record) override;
+
+  // Writes pending records and closes the file, false if anything failed.
+  bool Close();
+
+  uint64_t records() const { return records_; } // written to the file
+  uint64_t dropped() const { return dropped_; }
+
+private:
+  void run();
+  void drain();
+  bool flush();
+
+private:
+  int fd_{-1};
+  FlvTraceFormat format_{kFlvTraceFormatBinary};
+  int flush_interval_ms_{100};
+
+  std::vector<FlvTraceRecord> ring_;
+  uint64_t mask_{0};
+  // producer and writer thread state on separate cache lines
+  alignas(64) std::atomic<uint64_t> head_{0}; // next to write
+  uint64_t cached_tail_{0};                   // producer's view of `tail_`
+  alignas(64) std::atomic<uint64_t> tail_{0}; // next to read
+  alignas(64) std::atomic<uint64_t> dropped_{0};
+
+  std::vector<char> out_; // encoded, writer thread only
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::atomic<bool> waiting_{false}; // writer thread parked on `cv_`
+  bool stop_{false};
+  std::thread writer_;
+
+  std::atomic<bool> failed_{false};
+  std::atomic<uint64_t> records_{0};
+};
+
+#endif
@@ -0,0 +1,257 @@
+#include "FlvTsMuxer.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+const int kPayloadSize = FlvTsMuxer::kPacketSize - 4;
+const int64_t kTimestampMask = (1LL << 33) - 1;
+
+const uint8_t kStreamTypeH264 = 0x1B;
+const uint8_t kStreamTypeAacAdts = 0x0F;
+
+// CRC-32/MPEG-2 of PSI sections
+uint32_t Crc32(const uint8_t *p, int len) {
+  static uint32_t table[256];
+  static bool initialized = [] {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i << 24;
+      for (int j = 0; j < 8; ++j) {
+        c = (c & 0x80000000) ? (c << 1) ^ 0x04C11DB7 : (c << 1);
+      }
+      table[i] = c;
+    }
+    return true;
+  }();
+  (void)initialized;
+
+  uint32_t crc = 0xFFFFFFFF;
+  for (int i = 0; i < len; ++i) {
+    crc = (crc << 8) ^ table[((crc >> 24) ^ p[i]) & 0xFF];
+  }
+  return crc;
+}
+
+// '0010'/'0011'/'0001' marker nibble + 33 bits timestamp with marker bits
+void WriteTimestamp(uint8_t marker, int64_t ts, uint8_t *p) {
+  ts &= kTimestampMask;
+  p[0] = static_cast<uint8_t>((marker << 4) | ((ts >> 29) & 0x0E) | 1);
+  p[1] = static_cast<uint8_t>(ts >> 22);
+  p[2] = static_cast<uint8_t>(((ts >> 14) & 0xFE) | 1);
+  p[3] = static_cast<uint8_t>(ts >> 7);
+  p[4] = static_cast<uint8_t>(((ts << 1) & 0xFE) | 1);
+}
+
+void WritePcr(int64_t base, uint8_t *p) {
+  base &= kTimestampMask;
+  p[0] = static_cast<uint8_t>(base >> 25);
+  p[1] = static_cast<uint8_t>(base >> 17);
+  p[2] = static_cast<uint8_t>(base >> 9);
+  p[3] = static_cast<uint8_t>(base >> 1);
+  p[4] = static_cast<uint8_t>(((base & 1) << 7) | 0x7E); // extension 0
+  p[5] = 0;
+}
+
+// sequential reader over a PES header followed by the ES iovecs
+class Gather {
+public:
+  Gather(const uint8_t *header, int header_len,
+         const std::vector<struct iovec> &es)
+      : header_(header), header_len_(header_len), es_(es) {}
+
+  void Read(uint8_t *dst, int n) {
+    while (n > 0) {
+      const uint8_t *src;
+      size_t len;
+      if (index_ < 0) {
+        src = header_;
+        len = header_len_;
+      } else {
+        src = static_cast<const uint8_t *>(es_[index_].iov_base);
+        len = es_[index_].iov_len;
+      }
+      size_t copy = std::min<size_t>(len - offset_, n);
+      memcpy(dst, src + offset_, copy);
+      dst += copy;
+      n -= static_cast<int>(copy);
+      offset_ += copy;
+      if (offset_ == len) {
+        ++index_;
+        offset_ = 0;
+      }
+    }
+  }
+
+private:
+  const uint8_t *header_;
+  int header_len_;
+  const std::vector<struct iovec> &es_;
+  int index_{-1}; // -1: PES header
+  size_t offset_{0};
+};
+
+} // namespace
+
+void FlvTsMuxer::WriteTables(bool has_video, bool has_audio,
+                             std::vector<char> *out) {
+  pcr_pid_ = has_video ? video_.pid : audio_.pid;
+
+  // PAT, one program
+  uint8_t pat[] = {
+      0x00,                                       // table_id
+      0xB0, 13,                                   // section_length
+      0x00, 0x01,                                 // transport_stream_id
+      0xC1, 0x00, 0x00,                           // version 0, current
+      0x00, 0x01,                                 // program_number
+      static_cast<uint8_t>(0xE0 | (pmt_.pid >> 8)), // program_map_PID
+      static_cast<uint8_t>(pmt_.pid & 0xFF),
+      0, 0, 0, 0, // CRC
+  };
+  writeSection(&pat_, pat, sizeof(pat), out);
+
+  uint8_t pmt[32];
+  int n = 0;
+  pmt[n++] = 0x02; // table_id
+  n += 2;          // section_length
+  pmt[n++] = 0x00; // program_number
+  pmt[n++] = 0x01;
+  pmt[n++] = 0xC1;
+  pmt[n++] = 0x00;
+  pmt[n++] = 0x00;
+  pmt[n++] = static_cast<uint8_t>(0xE0 | (pcr_pid_ >> 8));
+  pmt[n++] = static_cast<uint8_t>(pcr_pid_ & 0xFF);
+  pmt[n++] = 0xF0; // program_info_length 0
+  pmt[n++] = 0x00;
+  auto add_stream = [&](uint8_t stream_type, int pid) {
+    pmt[n++] = stream_type;
+    pmt[n++] = static_cast<uint8_t>(0xE0 | (pid >> 8));
+    pmt[n++] = static_cast<uint8_t>(pid & 0xFF);
+    pmt[n++] = 0xF0; // ES_info_length 0
+    pmt[n++] = 0x00;
+  };
+  if (has_video) {
+    add_stream(kStreamTypeH264, video_.pid);
+  }
+  if (has_audio) {
+    add_stream(kStreamTypeAacAdts, audio_.pid);
+  }
+  n += 4; // CRC
+  int section_length = n - 3;
+  pmt[1] = static_cast<uint8_t>(0xB0 | (section_length >> 8));
+  pmt[2] = static_cast<uint8_t>(section_length & 0xFF);
+  writeSection(&pmt_, pmt, n, out);
+}
+
+void FlvTsMuxer::writeSection(Stream *stream, const uint8_t *section, int len,
+                              std::vector<char> *out) {
+  size_t pos = out->size();
+  out->resize(pos + kPacketSize, static_cast<char>(0xFF));
+  uint8_t *p = reinterpret_cast<uint8_t *>(&(*out)[pos]);
+  p[0] = 0x47;
+  p[1] = static_cast<uint8_t>(0x40 | (stream->pid >> 8)); // unit start
+  p[2] = static_cast<uint8_t>(stream->pid & 0xFF);
+  p[3] = static_cast<uint8_t>(0x10 | stream->continuity_counter);
+  stream->continuity_counter = (stream->continuity_counter + 1) & 0x0F;
+  p[4] = 0; // pointer_field
+
+  memcpy(p + 5, section, len - 4);
+  uint32_t crc = Crc32(p + 5, len - 4);
+  p[5 + len - 4] = static_cast<uint8_t>(crc >> 24);
+  p[5 + len - 3] = static_cast<uint8_t>(crc >> 16);
+  p[5 + len - 2] = static_cast<uint8_t>(crc >> 8);
+  p[5 + len - 1] = static_cast<uint8_t>(crc);
+}
+
+void FlvTsMuxer::WriteVideo(int64_t dts_ms, int64_t pts_ms, bool keyframe,
+                            const std::vector<struct iovec> &es,
+                            std::vector<char> *out) {
+  writePes(&video_, pts_ms * 90 + kTimestampOffset,
+           dts_ms * 90 + kTimestampOffset, keyframe, es, out);
+}
+
+void FlvTsMuxer::WriteAudio(int64_t pts_ms,
+                            const std::vector<struct iovec> &es,
+                            std::vector<char> *out) {
+  int64_t pts = pts_ms * 90 + kTimestampOffset;
+  writePes(&audio_, pts, pts, true, es, out);
+}
+
+void FlvTsMuxer::writePes(Stream *stream, int64_t pts, int64_t dts,
+                          bool random_access,
+                          const std::vector<struct iovec> &es,
+                          std::vector<char> *out) {
+  size_t es_len = 0;
+  for (auto &v : es) {
+    es_len += v.iov_len;
+  }
+
+  // PES header
+  uint8_t header[19];
+  bool has_dts = dts != pts;
+  int header_data_length = has_dts ? 10 : 5;
+  size_t pes_length = 3 + header_data_length + es_len;
+  if (stream == &video_ || pes_length > 0xFFFF) {
+    pes_length = 0; // unbounded, allowed for video only
+  }
+  header[0] = 0x00;
+  header[1] = 0x00;
+  header[2] = 0x01;
+  header[3] = stream->stream_id;
+  header[4] = static_cast<uint8_t>(pes_length >> 8);
+  header[5] = static_cast<uint8_t>(pes_length & 0xFF);
+  header[6] = 0x80; // marker bits
+  header[7] = has_dts ? 0xC0 : 0x80;
+  header[8] = static_cast<uint8_t>(header_data_length);
+  WriteTimestamp(has_dts ? 0x03 : 0x02, pts, header + 9);
+  if (has_dts) {
+    WriteTimestamp(0x01, dts, header + 14);
+  }
+  int header_len = 9 + header_data_length;
+
+  Gather gather(header, header_len, es);
+  int64_t remaining = header_len + static_cast<int64_t>(es_len);
+  bool first = true;
+  while (remaining > 0) {
+    bool pcr = first && stream->pid == pcr_pid_;
+    bool rai = first && random_access;
+
+    // adaptation field length after its length byte, -1 for none
+    int af_len = (pcr || rai) ? 1 + (pcr ? 6 : 0) : -1;
+    int space = kPayloadSize - (af_len >= 0 ? af_len + 1 : 0);
+    if (remaining < space) { // stuffing in the adaptation field
+      int stuffing = space - static_cast<int>(remaining);
+      af_len = af_len >= 0 ? af_len + stuffing : stuffing - 1;
+      space = static_cast<int>(remaining);
+    }
+
+    size_t pos = out->size();
+    out->resize(pos + kPacketSize);
+    uint8_t *p = reinterpret_cast<uint8_t *>(&(*out)[pos]);
+    p[0] = 0x47;
+    p[1] = static_cast<uint8_t>((first ? 0x40 : 0x00) | (stream->pid >> 8));
+    p[2] = static_cast<uint8_t>(stream->pid & 0xFF);
+    p[3] = static_cast<uint8_t>((af_len >= 0 ? 0x30 : 0x10) |
+                                stream->continuity_counter);
+    stream->continuity_counter = (stream->continuity_counter + 1) & 0x0F;
+    uint8_t *payload = p + 4;
+    if (af_len >= 0) {
+      p[4] = static_cast<uint8_t>(af_len);
+      uint8_t *af = p + 5;
+      if (af_len > 0) {
+        *af++ = static_cast<uint8_t>((rai ? 0x40 : 0) | (pcr ? 0x10 : 0));
+        if (pcr) {
+          WritePcr(dts - kTimestampOffset, af);
+          af += 6;
+        }
+        memset(af, 0xFF, p + 5 + af_len - af);
+      }
+      payload = p + 5 + af_len;
+    }
+
+    gather.Read(payload, space);
+    remaining -= space;
+    first = false;
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef FLV_TS_MUXER_H_
+#define FLV_TS_MUXER_H_
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include <vector>
+
+// Minimal MPEG-2 transport stream muxer for one H.264 and/or one AAC stream,
+// as used by HLS segments. Elementary stream data is passed as the iovecs
+// produced by `FlvAvcAnnexBConverter`/`FlvAacAdtsConverter` and packetized
+// straight into 188 bytes packets appended to `out`.
+// Timestamps are in milliseconds as in FLV, converted to 90kHz and shifted by
+// `kTimestampOffset` so that PCR < DTS <= PTS even with negative composition
+// times.
+class FlvTsMuxer {
+public:
+  // PAT and PMT, written at the beginning of every segment. The first present
+  // stream carries the PCR.
+  void WriteTables(bool has_video, bool has_audio, std::vector<char> *out);
+
+  // One access unit per PES packet, `es` is Annex-B H.264 incl. AUD.
+  void WriteVideo(int64_t dts_ms, int64_t pts_ms, bool keyframe,
+                  const std::vector<struct iovec> &es, std::vector<char> *out);
+  // One ADTS frame per PES packet.
+  void WriteAudio(int64_t pts_ms, const std::vector<struct iovec> &es,
+                  std::vector<char> *out);
+
+  const static int kPacketSize{188};
+  const static int64_t kTimestampOffset{126000}; // 1.4s in 90kHz, as ffmpeg
+
+private:
+  struct Stream {
+    int pid;
+    uint8_t stream_id;
+    uint8_t continuity_counter;
+  };
+  void writePes(Stream *stream, int64_t pts, int64_t dts, bool random_access,
+                const std::vector<struct iovec> &es, std::vector<char> *out);
+  void writeSection(Stream *stream, const uint8_t *section, int len,
+                    std::vector<char> *out);
+
+private:
+  Stream pat_{0x0000, 0, 0};
+  Stream pmt_{0x1000, 0, 0};
+  Stream video_{0x0100, 0xE0, 0};
+  Stream audio_{0x0101, 0xC0, 0};
+  int pcr_pid_{0x0100};
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include "FlvVerifier.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "FlvHeader.h"
+#include "FlvMappedFile.h"
+#include "FlvTag.h"
+#include "FlvTagView.h"
+
+namespace {
+
+// index of per tag type timestamps in `RangeResult`
+int TimestampIndex(uint8_t tag_type) {
+  return tag_type == kFlyTagTypeAudio ? 0
+                                      : (tag_type == kFlyTagTypeVideo ? 1 : 2);
+}
+
+const uint64_t kMinRangeBytes = 1024 * 1024;
+
+} // namespace
+
+int FlvVerifier::parseTag(uint64_t p, uint8_t *tag_type, uint32_t *timestamp,
+                          bool *need_more) const {
+  *need_more = false;
+  if ((static_cast<uint8_t>(data_[p]) & 0xC0) != 0) { // reserved bits
+    return 0;
+  }
+
+  // tags never exceed 11 + 0xFFFFFF bytes, so clamping is safe
+  int remain = static_cast<int>(
+      std::min<uint64_t>(len_ - p, FlvTagView::kTagHeaderLength + 0xFFFFFF));
+  FlvTagView view;
+  FlvTagParseResult result = FlvTagView::TryParse(data_ + p, remain, &view);
+  if (result.status != kFlvErrorOK) {
+    *need_more = result.status == kFlvErrorBufferEmptyOrTooLessData;
+    return 0;
+  }
+  if (view.stream_id != 0) {
+    return 0;
+  }
+  *tag_type = view.tag_type;
+  *timestamp = view.timestamp;
+  return result.consumed;
+}
+
+bool FlvVerifier::isSyncPoint(uint64_t p) const {
+  uint8_t tag_type;
+  uint32_t timestamp;
+  bool need_more;
+
+  // forward: the tag is followed by its own size
+  int size = parseTag(p, &tag_type, &timestamp, &need_more);
+  if (size == 0 || p + size + FlvTag::kPreviousTagSizeTypeLength > len_ ||
+      FlvCommonUtils::ReadUInt32BE(data_ + p + size) !=
+          static_cast<uint32_t>(size)) {
+    return false;
+  }
+  if (p == first_tag_offset_) {
+    return true;
+  }
+
+  // backward: the PreviousTagSize before points to a tag of exactly that size
+  uint32_t prev = FlvCommonUtils::ReadUInt32BE(
+      data_ + p - FlvTag::kPreviousTagSizeTypeLength);
+  if (prev >= static_cast<uint32_t>(FlvTagView::kTagHeaderLength) &&
+      prev <= p - FlvTag::kPreviousTagSizeTypeLength - first_tag_offset_) {
+    FlvTagView view;
+    FlvTagParseResult result = FlvTagView::TryParse(
+        data_ + p - FlvTag::kPreviousTagSizeTypeLength - prev, prev, &view);
+    if (result.status == kFlvErrorOK &&
+        result.consumed == static_cast<int>(prev)) {
+      return true;
+    }
+  }
+
+  // the tag before may be corrupted, require the next tag chains forward too
+  uint64_t next = p + size + FlvTag::kPreviousTagSizeTypeLength;
+  if (next == len_) {
+    return true;
+  }
+  int next_size = parseTag(next, &tag_type, &timestamp, &need_more);
+  return next_size > 0 &&
+         next + next_size + FlvTag::kPreviousTagSizeTypeLength <= len_ &&
+         FlvCommonUtils::ReadUInt32BE(data_ + next + next_size) ==
+             static_cast<uint32_t>(next_size);
+}
+
+uint64_t FlvVerifier::findSync(uint64_t from) const {
+  if (len_ < FlvTagView::kTagHeaderLength) {
+    return len_;
+  }
+  for (uint64_t p = from; p + FlvTagView::kTagHeaderLength <= len_; ++p) {
+    uint8_t flags = static_cast<uint8_t>(data_[p]);
+    if ((flags != kFlyTagTypeAudio && flags != kFlyTagTypeVideo &&
+         flags != kFlyTagTypeScriptData) ||
+        data_[p + 8] != 0 || data_[p + 9] != 0 || data_[p + 10] != 0) {
+      continue; // cheap reject before following the chain
+    }
+    if (isSyncPoint(p)) {
+      return p;
+    }
+  }
+  return len_;
+}
+
+void FlvVerifier::walk(uint64_t begin, uint64_t range_end,
+                       RangeResult *result) const {
+  *result = RangeResult();
+  result->begin = begin;
+
+  uint64_t p = begin;
+  while (p < range_end && p < len_) {
+    uint8_t tag_type;
+    uint32_t timestamp;
+    bool need_more;
+    int size = parseTag(p, &tag_type, &timestamp, &need_more);
+    if (size == 0) {
+      if (need_more) {
+        result->issues.push_back(
+            FlvVerifyIssue{kFlvVerifyIssueTruncated, p, len_ - p, 0});
+        p = len_;
+        break;
+      }
+      uint64_t q = findSync(p + 1);
+      result->issues.push_back(
+          FlvVerifyIssue{kFlvVerifyIssueCorruption, p, q - p, 0});
+      p = q;
+      continue;
+    }
+    uint64_t after = p + size;
+    if (after + FlvTag::kPreviousTagSizeTypeLength > len_) {
+      result->issues.push_back(
+          FlvVerifyIssue{kFlvVerifyIssueTruncated, after, len_ - after, 0});
+      p = len_;
+      break;
+    }
+    uint64_t next = after + FlvTag::kPreviousTagSizeTypeLength;
+    uint32_t prev = FlvCommonUtils::ReadUInt32BE(data_ + after);
+    if (prev != static_cast<uint32_t>(size)) {
+      if (next < len_ && !isSyncPoint(next)) {
+        // DataSize itself is broken, don't trust this tag
+        uint64_t q = findSync(p + 1);
+        result->issues.push_back(
+            FlvVerifyIssue{kFlvVerifyIssueCorruption, p, q - p, 0});
+        p = q;
+        continue;
+      }
+      result->issues.push_back(FlvVerifyIssue{kFlvVerifyIssueSizeMismatch,
+                                              after, prev,
+                                              static_cast<uint64_t>(size)});
+    }
+    ++result->tags;
+
+    int i = TimestampIndex(tag_type);
+    if (!result->has_timestamp[i]) {
+      result->has_timestamp[i] = true;
+      result->first_timestamp[i] = timestamp;
+      result->first_timestamp_offset[i] = p;
+    } else if (timestamp < result->last_timestamp[i]) {
+      result->issues.push_back(FlvVerifyIssue{
+          kFlvVerifyIssueTimestampRegression, p, timestamp,
+          result->last_timestamp[i]});
+    }
+    result->last_timestamp[i] = timestamp;
+
+    p = next;
+  }
+  result->end = std::min(p, len_);
+}
+
+FlvErrorCode FlvVerifier::Verify(const std::string &flv_file,
+                                 FlvVerifyReport *report) {
+  *report = FlvVerifyReport();
+
+  FlvMappedFile file;
+  if (!file.Open(flv_file)) {
+    return kFlvErrorIOFailed;
+  }
+  data_ = file.data();
+  len_ = file.size();
+  report->bytes = len_;
+
+  if (len_ <
+      FlvHeader::kFlvHeaderLength + FlvTag::kPreviousTagSizeTypeLength) {
+    return kFlvErrorBufferEmptyOrTooLessData;
+  }
+  FlvHeader fh(const_cast<char *>(data_), FlvHeader::kFlvHeaderLength);
+  if (!fh.Verify()) {
+    return kFlvErrorHeaderInvalid;
+  }
+  uint32_t prev0 = FlvTag::FetchPreviousTagSize(
+      const_cast<char *>(data_) + fh.cost_bytes(),
+      FlvTag::kPreviousTagSizeTypeLength);
+  if (prev0 != 0) {
+    report->issues.push_back(FlvVerifyIssue{
+        kFlvVerifyIssueSizeMismatch, fh.cost_bytes(), prev0, 0});
+  }
+  first_tag_offset_ = fh.cost_bytes() + FlvTag::kPreviousTagSizeTypeLength;
+
+  // split into ranges, at least `kMinRangeBytes` each
+  uint64_t body = len_ - first_tag_offset_;
+  int n = static_cast<int>(std::max<uint64_t>(
+      1, std::min<uint64_t>(threads_, body / kMinRangeBytes)));
+  std::vector<uint64_t> bounds(n + 1);
+  for (int i = 0; i <= n; ++i) {
+    bounds[i] = first_tag_offset_ + body * i / n;
+  }
+
+  std::vector<RangeResult> results(n);
+  auto worker = [this, &bounds, &results](int i) {
+    uint64_t begin = i == 0 ? first_tag_offset_ : findSync(bounds[i]);
+    walk(begin, bounds[i + 1], &results[i]);
+  };
+  std::vector<std::thread> workers;
+  for (int i = 1; i < n; ++i) {
+    workers.emplace_back(worker, i);
+  }
+  worker(0);
+  for (auto &t : workers) {
+    t.join();
+  }
+
+  // stitch ranges: each range must start exactly where the previous stopped
+  for (int i = 1; i < n; ++i) {
+    uint64_t prev_end = results[i - 1].end;
+    if (results[i].begin != prev_end) {
+      walk(prev_end, bounds[i + 1], &results[i]);
+    }
+  }
+
+  bool has_timestamp[3]{false, false, false};
+  uint32_t last_timestamp[3]{0, 0, 0};
+  for (auto &r : results) {
+    for (int i = 0; i < 3; ++i) {
+      if (!r.has_timestamp[i]) {
+        continue;
+      }
+      if (has_timestamp[i] && r.first_timestamp[i] < last_timestamp[i]) {
+        r.issues.push_back(FlvVerifyIssue{
+            kFlvVerifyIssueTimestampRegression, r.first_timestamp_offset[i],
+            r.first_timestamp[i], last_timestamp[i]});
+      }
+      has_timestamp[i] = true;
+      last_timestamp[i] = r.last_timestamp[i];
+    }
+
+    report->tags += r.tags;
+    report->issues.insert(report->issues.end(), r.issues.begin(),
+                          r.issues.end());
+  }
+  std::stable_sort(report->issues.begin(), report->issues.end(),
+                   [](const FlvVerifyIssue &a, const FlvVerifyIssue &b) {
+                     return a.offset < b.offset;
+                   });
+
+  data_ = nullptr;
+  len_ = 0;
+  return kFlvErrorOK;
+}
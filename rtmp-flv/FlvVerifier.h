@@ -0,0 +1,83 @@
+#ifndef FLV_VERIFIER_H_
+#define FLV_VERIFIER_H_
+
+#include <string>
+#include <vector>
+
+#include "FlvCommon.h"
+
+enum FlvVerifyIssueType {
+  kFlvVerifyIssueCorruption = 0, // unparsable bytes skipped until resync
+  kFlvVerifyIssueSizeMismatch,   // PreviousTagSize != size of the tag before
+  kFlvVerifyIssueTimestampRegression,
+  kFlvVerifyIssueTruncated, // file ends inside a tag or its PreviousTagSize
+};
+
+struct FlvVerifyIssue {
+  FlvVerifyIssueType type;
+  uint64_t offset; // byte offset where the issue is detected
+
+  // corruption: skipped bytes; size mismatch: PreviousTagSize found;
+  // timestamp regression: timestamp found
+  uint64_t value;
+  // size mismatch: expected tag size; timestamp regression: previous timestamp
+  // of the same tag type
+  uint64_t expected;
+};
+
+struct FlvVerifyReport {
+  uint64_t tags{0};
+  uint64_t bytes{0};
+  std::vector<FlvVerifyIssue> issues; // sorted by offset
+
+  bool ok() const { return issues.empty(); }
+};
+
+// Verifies a FLV file in parallel.
+// The file is split into byte ranges, each worker resynchronises at the first
+// tag of its range by checking the tag header against the PreviousTagSize
+// back-chain on both sides, then walks tags up to the end of its range.
+// Range boundaries are stitched afterwards: a worker whose sync point doesn't
+// match where the previous worker stopped is walked again from there.
+class FlvVerifier {
+public:
+  explicit FlvVerifier(int threads) : threads_(threads > 0 ? threads : 1) {}
+
+public:
+  FlvErrorCode Verify(const std::string &flv_file, FlvVerifyReport *report);
+
+private:
+  struct RangeResult {
+    uint64_t begin{0}; // first tag walked, i.e. sync point
+    uint64_t end{0};   // first tag offset not walked
+    uint64_t tags{0};
+    std::vector<FlvVerifyIssue> issues;
+
+    // first/last timestamps of audio, video and script tags
+    bool has_timestamp[3]{false, false, false};
+    uint32_t first_timestamp[3]{0, 0, 0};
+    uint64_t first_timestamp_offset[3]{0, 0, 0};
+    uint32_t last_timestamp[3]{0, 0, 0};
+  };
+
+  // Walk tags starting at `begin` which must be a tag start, until a tag
+  // starts at or after `range_end`.
+  void walk(uint64_t begin, uint64_t range_end, RangeResult *result) const;
+
+  // First offset in [from, len) looks like a tag start, `len_` if none.
+  uint64_t findSync(uint64_t from) const;
+  bool isSyncPoint(uint64_t p) const;
+
+  // parse tag at `p`, returns tag size (without PreviousTagSize) or 0
+  int parseTag(uint64_t p, uint8_t *tag_type, uint32_t *timestamp,
+               bool *need_more) const;
+
+private:
+  const int threads_;
+
+  const char *data_{nullptr};
+  uint64_t len_{0};
+  uint64_t first_tag_offset_{0};
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "FlvWriter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "FlvHeader.h"
+#include "FlvTag.h"
+
+namespace {
+
+const int kPreviousTagSizeLength = FlvTag::kPreviousTagSizeTypeLength;
+const uint32_t kMetaDataKeys = 12;
+
+void WriteTagHeader(uint8_t tag_type, uint32_t data_size, uint32_t timestamp,
+                    char *h) {
+  h[0] = static_cast<char>(tag_type);
+  h[1] = static_cast<char>((data_size >> 16) & 0xFF);
+  h[2] = static_cast<char>((data_size >> 8) & 0xFF);
+  h[3] = static_cast<char>(data_size & 0xFF);
+  h[4] = static_cast<char>((timestamp >> 16) & 0xFF);
+  h[5] = static_cast<char>((timestamp >> 8) & 0xFF);
+  h[6] = static_cast<char>(timestamp & 0xFF);
+  h[7] = static_cast<char>((timestamp >> 24) & 0xFF);
+  h[8] = h[9] = h[10] = 0; // StreamID
+}
+
+} // namespace
+
+FlvWriter::FlvWriter(const FlvWriterOptions &options)
+    : options_(options), rebaser_(options.rebaser) {
+  int batch = std::max(options_.batch_tags, 1);
+  queued_.reserve(batch);
+  iov_.reserve(batch * 3);
+}
+
+bool FlvWriter::Open(const std::string &flv_file, bool has_audio,
+                     bool has_video) {
+  Close();
+  fd_ = open(flv_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    return false;
+  }
+  failed_ = false;
+  bytes_ = tags_ = 0;
+  unindexed_keyframes_ = 0;
+  last_timestamp_ = 0;
+  rebaser_.Clear();
+  meta_data_.Clear();
+  keyframe_positions_.clear();
+  keyframe_timestamps_.clear();
+
+  // header, PreviousTagSize0 and the reserved onMetaData
+  char header[FlvHeader::kFlvHeaderLength + kPreviousTagSizeLength]{
+      'F', 'L', 'V', 1, 0, 0, 0, 0, FlvHeader::kFlvHeaderLength, 0, 0, 0, 0};
+  header[4] = static_cast<char>((has_audio ? 0x04 : 0) |
+                                (has_video ? 0x01 : 0)); // TypeFlags
+  struct iovec iov[2]{{header, sizeof(header)}, {nullptr, 0}};
+  int count = 1;
+  meta_data_offset_ = sizeof(header);
+  meta_data_size_ = 0;
+  if (options_.keyframe_index_capacity > 0) {
+    encodeMetaData();
+    meta_data_size_ = meta_data_tag_.size();
+    iov[1] = {meta_data_tag_.data(), meta_data_size_};
+    ++count;
+  }
+  if (!writeAll(iov, count)) {
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  bytes_ = meta_data_offset_ + meta_data_size_;
+  return true;
+}
+
+FlvErrorCode FlvWriter::Write(const FlvTagView &view) {
+  if (fd_ < 0) {
+    return kFlvErrorIOFailed;
+  }
+  if (options_.keyframe_index_capacity > 0 &&
+      view.GetTagType() == kFlyTagTypeScriptData &&
+      collector_.Collect(view.data_pointer, view.data_length) == kFlvErrorOK) {
+    // stream properties only, the index of the source is stale anyway
+    meta_data_ = collector_.meta_data();
+    meta_data_.keyframe_file_positions.clear();
+    meta_data_.keyframe_times.clear();
+    return kFlvErrorOK;
+  }
+
+  uint32_t timestamp = options_.rebase_timestamps
+                           ? rebaser_.Rebase(view.tag_type, view.timestamp)
+                           : view.timestamp;
+  last_timestamp_ = std::max(last_timestamp_, timestamp);
+  if (view.IsVideoKeyFrame() && view.IsVideoFrame()) {
+    if (keyframe_positions_.size() < options_.keyframe_index_capacity) {
+      keyframe_positions_.push_back(bytes_);
+      keyframe_timestamps_.push_back(timestamp);
+    } else if (options_.keyframe_index_capacity > 0) {
+      ++unindexed_keyframes_;
+    }
+  }
+
+  queued_.emplace_back();
+  QueuedTag &tag = queued_.back();
+  WriteTagHeader(view.tag_type, view.data_size, timestamp, tag.header);
+  FlvCommonUtils::WriteUInt32BE(static_cast<uint32_t>(view.tag_length()),
+                                tag.previous_tag_size);
+  iov_.push_back({tag.header, sizeof(tag.header)});
+  if (view.data_size > 0) {
+    iov_.push_back({const_cast<char *>(view.body_pointer()), view.data_size});
+  }
+  iov_.push_back({tag.previous_tag_size, sizeof(tag.previous_tag_size)});
+  bytes_ += view.tag_length() + kPreviousTagSizeLength;
+  ++tags_;
+
+  if (static_cast<int>(queued_.size()) >= options_.batch_tags && !Flush()) {
+    return kFlvErrorIOFailed;
+  }
+  return kFlvErrorOK;
+}
+
+bool FlvWriter::Flush() {
+  if (!iov_.empty() &&
+      !writeAll(iov_.data(), static_cast<int>(iov_.size()))) {
+    failed_ = true;
+  }
+  iov_.clear();
+  queued_.clear();
+  return !failed_;
+}
+
+bool FlvWriter::Close() {
+  if (fd_ < 0) {
+    return !failed_;
+  }
+  Flush();
+  if (options_.keyframe_index_capacity > 0 && !failed_) {
+    encodeMetaData();
+    if (meta_data_tag_.size() != meta_data_size_ ||
+        pwrite(fd_, meta_data_tag_.data(), meta_data_size_,
+               meta_data_offset_) != static_cast<ssize_t>(meta_data_size_)) {
+      failed_ = true;
+    }
+  }
+  if (close(fd_) != 0) {
+    failed_ = true;
+  }
+  fd_ = -1;
+  return !failed_;
+}
+
+void FlvWriter::encodeMetaData() {
+  encoder_.Clear();
+  auto number = [this](const char *key, double v) {
+    encoder_.WriteKey(key);
+    encoder_.WriteNumber(v);
+  };
+  encoder_.WriteString("onMetaData");
+  encoder_.BeginEcmaArray(kMetaDataKeys);
+  number("duration", last_timestamp_ / 1000.0);
+  number("width", meta_data_.width);
+  number("height", meta_data_.height);
+  number("videodatarate", meta_data_.video_data_rate);
+  number("framerate", meta_data_.frame_rate);
+  number("videocodecid", meta_data_.video_codec_id);
+  number("audiodatarate", meta_data_.audio_data_rate);
+  number("audiosamplerate", meta_data_.audio_sample_rate);
+  number("audiocodecid", meta_data_.audio_codec_id);
+  number("filesize", static_cast<double>(bytes_));
+  encoder_.WriteKey("hasKeyframes");
+  encoder_.WriteBoolean(!keyframe_positions_.empty());
+
+  // unused entries repeat the last keyframe, or the first tag if none
+  uint32_t capacity = options_.keyframe_index_capacity;
+  size_t n = keyframe_positions_.size();
+  uint64_t first_tag = meta_data_offset_ + meta_data_size_;
+  encoder_.WriteKey("keyframes");
+  encoder_.BeginObject();
+  encoder_.WriteKey("filepositions");
+  encoder_.BeginStrictArray(capacity);
+  for (uint32_t i = 0; i < capacity; ++i) {
+    encoder_.WriteNumber(static_cast<double>(
+        n > 0 ? keyframe_positions_[std::min<size_t>(i, n - 1)] : first_tag));
+  }
+  encoder_.WriteKey("times");
+  encoder_.BeginStrictArray(capacity);
+  for (uint32_t i = 0; i < capacity; ++i) {
+    encoder_.WriteNumber(
+        n > 0 ? keyframe_timestamps_[std::min<size_t>(i, n - 1)] / 1000.0 : 0);
+  }
+  encoder_.EndObject();
+  encoder_.EndEcmaArray();
+
+  const std::vector<char> &body = encoder_.data();
+  uint32_t data_size = static_cast<uint32_t>(body.size());
+  meta_data_tag_.resize(FlvTagView::kTagHeaderLength + data_size +
+                        kPreviousTagSizeLength);
+  char *p = meta_data_tag_.data();
+  WriteTagHeader(kFlyTagTypeScriptData, data_size, 0, p);
+  std::copy(body.begin(), body.end(), p + FlvTagView::kTagHeaderLength);
+  FlvCommonUtils::WriteUInt32BE(FlvTagView::kTagHeaderLength + data_size,
+                                p + FlvTagView::kTagHeaderLength + data_size);
+}
+
+bool FlvWriter::writeAll(struct iovec *iov, int count) {
+  while (count > 0) {
+    ssize_t n = writev(fd_, iov, std::min(count, IOV_MAX));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+
+    // skip what's written, partial writes resume inside an iovec
+    while (count > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+      n -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + n;
+      iov->iov_len -= n;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,95 @@
+#ifndef FLV_WRITER_H_
+#define FLV_WRITER_H_
+
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+
+#include "FlvAmf.h"
+#include "FlvCommon.h"
+#include "FlvTagView.h"
+#include "FlvTimestampRebaser.h"
+
+struct FlvWriterOptions {
+  bool rebase_timestamps{true};
+  FlvTimestampRebaserOptions rebaser;
+
+  // Reserve an onMetaData with a keyframe index for up to this many keyframes
+  // right after the FLV header, filled in on `Close`. Incoming onMetaData tags
+  // are merged into it instead of being copied. 0 copies all script tags.
+  uint32_t keyframe_index_capacity{0};
+
+  // Tags queued before one `writev`. Above 1 the queued tag bodies must stay
+  // valid until they are flushed, e.g. a memory mapped input.
+  int batch_tags{1};
+};
+
+// Serialises FLV header and tags from `FlvTagView`s into a file.
+// Tag headers are rebuilt from the view fields, so views of RTMP messages and
+// of damaged files alike come out with consistent DataSize, rebased timestamps
+// and a correct PreviousTagSize, the bodies are written with `writev` straight
+// from wherever the views point to.
+// With a keyframe index, the onMetaData written by `Open` has a fixed size
+// regardless of its content: every field is an AMF0 number or boolean and the
+// keyframe arrays always have `keyframe_index_capacity` entries, unused ones
+// repeat the last keyframe. `Close` re-encodes it with the final duration,
+// file size and keyframe positions and overwrites it in place, so a recording
+// is re-indexed in a single streaming pass.
+class FlvWriter {
+public:
+  explicit FlvWriter(const FlvWriterOptions &options = FlvWriterOptions());
+  FlvWriter(const FlvWriter &) = delete;
+  ~FlvWriter() { Close(); }
+
+public:
+  bool Open(const std::string &flv_file, bool has_audio, bool has_video);
+  FlvErrorCode Write(const FlvTagView &view);
+  bool Flush();
+  // Flush and finalise the onMetaData, returns false if any write failed.
+  bool Close();
+
+public:
+  uint64_t bytes() const { return bytes_; } // incl. queued tags
+  uint64_t tags() const { return tags_; }
+  size_t keyframes() const { return keyframe_positions_.size(); }
+  // keyframes beyond `keyframe_index_capacity`, missing from the index
+  uint64_t unindexed_keyframes() const { return unindexed_keyframes_; }
+  const FlvTimestampRebaser &rebaser() const { return rebaser_; }
+
+private:
+  struct QueuedTag {
+    char header[FlvTagView::kTagHeaderLength];
+    char previous_tag_size[4];
+  };
+
+  // encodes the whole onMetaData tag into `meta_data_tag_`
+  void encodeMetaData();
+  bool writeAll(struct iovec *iov, int count);
+
+private:
+  const FlvWriterOptions options_;
+  FlvTimestampRebaser rebaser_;
+
+  int fd_{-1};
+  bool failed_{false};
+  uint64_t bytes_{0};
+  uint64_t tags_{0};
+
+  std::vector<QueuedTag> queued_; // capacity `batch_tags`, never reallocated
+  std::vector<struct iovec> iov_;
+
+  // keyframe index
+  FlvMetaDataCollector collector_;
+  FlvMetaData meta_data_;
+  FlvAmfEncoder encoder_;
+  std::vector<char> meta_data_tag_;
+  uint64_t meta_data_offset_{0};
+  size_t meta_data_size_{0}; // whole tag incl. PreviousTagSize
+  std::vector<uint64_t> keyframe_positions_;
+  std::vector<uint32_t> keyframe_timestamps_;
+  uint64_t unindexed_keyframes_{0};
+  uint32_t last_timestamp_{0};
+};
+
+#endif
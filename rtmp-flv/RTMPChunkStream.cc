@@ -0,0 +1,822 @@
+#include "RTMPChunkStream.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS, SO_NOSIGPIPE is set instead
+#endif
+
+namespace {
+
+const int kHandshakeLength = 1536;
+const int kMaxChunkHeaderLength = 3 + 11 + 4; // basic + type 0 + extended
+const int kReceiveBufferSize = 256 * 1024;
+// Set Chunk Size allows up to 0x7FFFFFFF, but the receive buffer holds two
+// chunks, servers use 4KB to 64KB. Larger ones drop the connection.
+const uint32_t kMaxChunkSize = 1024 * 1024;
+// a peer can announce 16MB messages on any of 65599 chunk streams, the
+// connection is dropped beyond these
+const size_t kMaxChunkStreams = 64;
+const size_t kMaxReassemblyBytes = 32 * 1024 * 1024;
+const int kMessageHeaderLength[4]{11, 7, 3, 0};
+
+const int kCsidProtocolControl = 2;
+const int kCsidCommand = 3;
+const int kCsidAudio = 4;
+const int kCsidVideo = 6;
+const int kCsidStream = 8;
+
+const int kReceiveWouldBlock = -2;
+const uint32_t kPublishChunkSize = 4096;
+// AMF0 strings, servers expect metadata published as
+// @setDataFrame("onMetaData", ...)
+const char kSetDataFrame[] = "\x02\x00\x0d@setDataFrame";
+const char kOnMetaData[] = "\x02\x00\x0aonMetaData";
+
+const uint32_t kWindowAckSize = 2500000;
+const uint32_t kBufferLengthMs = 3600 * 1000;
+
+enum RTMPUserControlEvent {
+  kRTMPUserControlStreamBegin = 0,
+  kRTMPUserControlStreamEOF = 1,
+  kRTMPUserControlSetBufferLength = 3,
+  kRTMPUserControlPingRequest = 6,
+  kRTMPUserControlPingResponse = 7,
+};
+
+// command name, transaction id, the first non-object argument and onStatus
+// level/code of a command message
+class CommandVisitor : public FlvAmfVisitor {
+public:
+  void OnNumber(double v) override {
+    if (depth_ == 0) {
+      if (values_ == 1) {
+        transaction_id = v;
+      } else if (values_ == 3) {
+        result = v;
+      }
+      ++values_;
+    }
+  }
+  void OnString(const char *s, int len) override {
+    if (depth_ == 0) {
+      if (values_ == 0) {
+        name.assign(s, len);
+      }
+      ++values_;
+    } else if (depth_ == 1 && key_ == "level") {
+      level.assign(s, len);
+    } else if (depth_ == 1 && key_ == "code") {
+      code.assign(s, len);
+    }
+  }
+  void OnBoolean(bool v) override { value(); }
+  void OnNull() override { value(); }
+  void OnUndefined() override { value(); }
+  void OnKey(const char *key, int len) override {
+    if (depth_ == 1) {
+      key_.assign(key, len);
+    }
+  }
+  void OnObjectBegin() override { begin(); }
+  void OnObjectEnd() override { --depth_; }
+  void OnEcmaArrayBegin(uint32_t count) override { begin(); }
+  void OnStrictArrayBegin(uint32_t count) override { begin(); }
+  void OnArrayEnd() override { --depth_; }
+
+  std::string name;
+  double transaction_id{-1};
+  double result{-1};
+  std::string level;
+  std::string code;
+
+private:
+  void value() {
+    if (depth_ == 0) {
+      ++values_;
+    }
+  }
+  void begin() {
+    value();
+    ++depth_;
+  }
+
+  int values_{0};
+  int depth_{0};
+  std::string key_;
+};
+
+uint32_t ReadUInt32LE(const char *p) {
+  return static_cast<uint8_t>(p[0]) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(p[1])) << 8) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(p[2])) << 16) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(p[3])) << 24);
+}
+
+void AppendUInt(uint32_t v, int bytes, std::vector<char> *buff) {
+  for (int i = bytes - 1; i >= 0; --i) {
+    buff->push_back(static_cast<char>((v >> (i * 8)) & 0xFF));
+  }
+}
+
+} // namespace
+
+bool RTMPChunkStream::SetupURL(const std::string &url) {
+  const std::string scheme = "rtmp://";
+  if (url.compare(0, scheme.size(), scheme) != 0) {
+    return false;
+  }
+  size_t host_begin = scheme.size();
+  size_t path_begin = url.find('/', host_begin);
+  size_t stream_begin = url.rfind('/');
+  if (path_begin == std::string::npos || stream_begin == path_begin ||
+      stream_begin + 1 >= url.size()) {
+    return false; // need both app and stream
+  }
+
+  std::string host_port = url.substr(host_begin, path_begin - host_begin);
+  size_t colon = host_port.rfind(':');
+  if (colon != std::string::npos && host_port.find(']') == std::string::npos) {
+    port_ = atoi(host_port.c_str() + colon + 1);
+    host_ = host_port.substr(0, colon);
+  } else {
+    host_ = host_port;
+  }
+  if (host_.size() > 2 && host_.front() == '[' && host_.back() == ']') {
+    host_ = host_.substr(1, host_.size() - 2); // IPv6 literal
+  }
+  app_ = url.substr(path_begin + 1, stream_begin - path_begin - 1);
+  stream_ = url.substr(stream_begin + 1);
+  tc_url_ = url.substr(0, stream_begin);
+  return !host_.empty() && port_ > 0;
+}
+
+bool RTMPChunkStream::Connect(int timeout_s, bool publish) {
+  Close();
+
+  struct addrinfo hints {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *addrs = nullptr;
+  if (getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints,
+                  &addrs) != 0) {
+    return false;
+  }
+  for (struct addrinfo *ai = addrs; ai; ai = ai->ai_next) {
+    fd_ = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd_ < 0) {
+      continue;
+    }
+    if (connect(fd_, ai->ai_addr, ai->ai_addrlen) == 0) {
+      break;
+    }
+    close(fd_);
+    fd_ = -1;
+  }
+  freeaddrinfo(addrs);
+  if (fd_ < 0) {
+    return false;
+  }
+
+  struct timeval tv {};
+  tv.tv_sec = timeout_s;
+  setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  int one = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+  setsockopt(fd_, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+  eof_ = false;
+  error_ = false;
+  begin_ = end_ = 0;
+  chunk_streams_.clear();
+  reassembly_bytes_ = 0;
+  chunk_size_ = 128;
+  window_ack_size_ = 0;
+  bytes_received_ = bytes_acked_ = 0;
+  connected_ = false;
+  message_stream_id_ = -1;
+  publish_ = publish;
+  publishing_ = false;
+  publish_buff_.clear();
+  out_chunk_size_ = 128;
+  bytes_sent_ = 0;
+
+  if (!handshake()) {
+    Close();
+    return false;
+  }
+  if (!sendConnect() || !waitFor([this] { return connected_; }) ||
+      !sendUInt32(kRTMPMessageTypeWindowAckSize, kWindowAckSize) ||
+      !sendCreateStream() ||
+      !waitFor([this] { return message_stream_id_ >= 0; })) {
+    Close();
+    return false;
+  }
+  bool ok = false;
+  if (publish) {
+    ok = sendUInt32(kRTMPMessageTypeSetChunkSize, kPublishChunkSize);
+    out_chunk_size_ = kPublishChunkSize;
+    ok = ok && sendPublish() && waitFor([this] { return publishing_; });
+  } else {
+    ok = sendPlay() &&
+         sendUserControl(kRTMPUserControlSetBufferLength,
+                         static_cast<uint32_t>(message_stream_id_),
+                         kBufferLengthMs, true);
+  }
+  if (!ok) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void RTMPChunkStream::Close() {
+  if (fd_ >= 0 && publishing_) {
+    // unpublish right away rather than when the server notices the close
+    publishing_ = false;
+    Flush();
+    sendDeleteStream();
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool RTMPChunkStream::WriteTag(const FlvTagView &view) {
+  if (!publishing_ || error_) {
+    return false;
+  }
+  int csid = kCsidStream;
+  const char *prefix = nullptr;
+  int prefix_len = 0;
+  switch (view.GetTagType()) {
+  case kFlyTagTypeAudio:
+    csid = kCsidAudio;
+    break;
+  case kFlyTagTypeVideo:
+    csid = kCsidVideo;
+    break;
+  default:
+    if (view.data_size >= sizeof(kOnMetaData) - 1 &&
+        memcmp(view.body_pointer(), kOnMetaData, sizeof(kOnMetaData) - 1) ==
+            0) {
+      prefix = kSetDataFrame;
+      prefix_len = sizeof(kSetDataFrame) - 1;
+    }
+    break;
+  }
+  appendMessage(csid, view.tag_type, view.timestamp,
+                static_cast<uint32_t>(message_stream_id_), prefix, prefix_len,
+                view.body_pointer(), static_cast<int>(view.data_size),
+                &publish_buff_);
+  return publish_buff_.size() < kPublishBatchBytes || Flush();
+}
+
+bool RTMPChunkStream::Flush() {
+  if (fd_ < 0 || error_) {
+    return false;
+  }
+  if (!publish_buff_.empty()) {
+    bool ok = writeAll(publish_buff_.data(),
+                       static_cast<int>(publish_buff_.size()));
+    publish_buff_.clear();
+    if (!ok) {
+      return false;
+    }
+  }
+
+  // nothing but control and status messages comes back while publishing
+  while (true) {
+    int n = receive(MSG_DONTWAIT);
+    if (n == kReceiveWouldBlock) {
+      return true;
+    }
+    if (n <= 0 || !parseChunks()) {
+      return false;
+    }
+  }
+}
+
+int RTMPChunkStream::Read(const std::function<FlvTagCallback> &callback) {
+  if (eof_) {
+    return 0;
+  }
+  int n = receive();
+  if (n <= 0) {
+    return n;
+  }
+
+  callback_ = &callback;
+  bool ok = parseChunks();
+  callback_ = nullptr;
+  return ok ? n : -1;
+}
+
+bool RTMPChunkStream::handshake() {
+  // plain handshake: C1 with zero version is accepted without digest
+  std::vector<char> c0c1(1 + kHandshakeLength, 0);
+  c0c1[0] = 0x03;
+  for (int i = 1 + 8; i < 1 + kHandshakeLength; ++i) {
+    c0c1[i] = static_cast<char>(rand());
+  }
+  std::vector<char> s0s1(1 + kHandshakeLength);
+  std::vector<char> s2(kHandshakeLength);
+  return writeAll(c0c1.data(), static_cast<int>(c0c1.size())) &&
+         readAll(s0s1.data(), static_cast<int>(s0s1.size())) &&
+         s0s1[0] == 0x03 &&
+         writeAll(s0s1.data() + 1, kHandshakeLength) && // C2 echoes S1
+         readAll(s2.data(), kHandshakeLength);
+}
+
+bool RTMPChunkStream::sendConnect() {
+  encoder_.Clear();
+  encoder_.WriteString("connect");
+  encoder_.WriteNumber(transaction_id_ = 1);
+  encoder_.BeginObject();
+  encoder_.WriteKey("app");
+  encoder_.WriteString(app_);
+  encoder_.WriteKey("flashVer");
+  encoder_.WriteString("LNX 9,0,124,2");
+  encoder_.WriteKey("tcUrl");
+  encoder_.WriteString(tc_url_);
+  encoder_.WriteKey("fpad");
+  encoder_.WriteBoolean(false);
+  encoder_.WriteKey("capabilities");
+  encoder_.WriteNumber(15);
+  encoder_.WriteKey("audioCodecs");
+  encoder_.WriteNumber(3191);
+  encoder_.WriteKey("videoCodecs");
+  encoder_.WriteNumber(252);
+  encoder_.WriteKey("videoFunction");
+  encoder_.WriteNumber(1);
+  encoder_.EndObject();
+  return sendCommand(kCsidCommand, 0);
+}
+
+bool RTMPChunkStream::sendCreateStream() {
+  encoder_.Clear();
+  encoder_.WriteString("createStream");
+  encoder_.WriteNumber(transaction_id_ = 2);
+  encoder_.WriteNull();
+  return sendCommand(kCsidCommand, 0);
+}
+
+bool RTMPChunkStream::sendPlay() {
+  encoder_.Clear();
+  encoder_.WriteString("play");
+  encoder_.WriteNumber(transaction_id_ = 3);
+  encoder_.WriteNull();
+  encoder_.WriteString(stream_);
+  encoder_.WriteNumber(-2); // live, or recorded if no live stream
+  return sendCommand(kCsidStream, static_cast<uint32_t>(message_stream_id_));
+}
+
+bool RTMPChunkStream::sendPublish() {
+  encoder_.Clear();
+  encoder_.WriteString("publish");
+  encoder_.WriteNumber(transaction_id_ = 3);
+  encoder_.WriteNull();
+  encoder_.WriteString(stream_);
+  encoder_.WriteString("live");
+  return sendCommand(kCsidStream, static_cast<uint32_t>(message_stream_id_));
+}
+
+bool RTMPChunkStream::sendDeleteStream() {
+  encoder_.Clear();
+  encoder_.WriteString("deleteStream");
+  encoder_.WriteNumber(transaction_id_ = 4);
+  encoder_.WriteNull();
+  encoder_.WriteNumber(message_stream_id_);
+  return sendCommand(kCsidCommand, 0);
+}
+
+bool RTMPChunkStream::waitFor(const std::function<bool()> &done) {
+  while (!done()) {
+    if (error_ || eof_ || receive() <= 0 || !parseChunks()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int RTMPChunkStream::receive(int flags) {
+  // the unparsed tail is less than a chunk, move it to the front
+  if (begin_ > 0) {
+    memmove(buff_.data(), buff_.data() + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+  }
+  size_t size = std::max<size_t>(kReceiveBufferSize,
+                                 2 * (chunk_size_ + kMaxChunkHeaderLength));
+  if (buff_.size() < size) {
+    buff_.resize(size);
+  }
+
+  while (true) {
+    ssize_t n = recv(fd_, buff_.data() + end_, buff_.size() - end_, flags);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (flags & MSG_DONTWAIT) &&
+        (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return kReceiveWouldBlock;
+    }
+    if (n <= 0) {
+      return n == 0 ? 0 : -1;
+    }
+    end_ += n;
+    bytes_received_ += n;
+
+    if (window_ack_size_ > 0 &&
+        bytes_received_ - bytes_acked_ >= window_ack_size_ / 2) {
+      bytes_acked_ = bytes_received_;
+      if (!sendUInt32(kRTMPMessageTypeAcknowledgement,
+                      static_cast<uint32_t>(bytes_received_))) {
+        return -1;
+      }
+    }
+    return static_cast<int>(n);
+  }
+}
+
+bool RTMPChunkStream::parseChunks() {
+  while (begin_ < end_) {
+    const char *p = buff_.data() + begin_;
+    int avail = end_ - begin_;
+
+    // basic header
+    uint8_t fmt = static_cast<uint8_t>(p[0]) >> 6;
+    uint32_t csid = p[0] & 0x3F;
+    int pos = 1;
+    if (csid == 0) {
+      if (avail < 2) {
+        break;
+      }
+      csid = 64 + static_cast<uint8_t>(p[1]);
+      pos = 2;
+    } else if (csid == 1) {
+      if (avail < 3) {
+        break;
+      }
+      csid = 64 + static_cast<uint8_t>(p[1]) +
+             static_cast<uint32_t>(static_cast<uint8_t>(p[2])) * 256;
+      pos = 3;
+    }
+    if (avail < pos + kMessageHeaderLength[fmt]) {
+      break;
+    }
+    ChunkState *state = findChunkStream(csid);
+    // the first chunk of a chunk stream carries the whole message header,
+    // there is nothing to inherit the rest from
+    if ((!state || !state->initialized) && fmt != 0) {
+      error_ = true;
+      return false;
+    }
+    if (!state) {
+      if (chunk_streams_.size() >= kMaxChunkStreams) {
+        error_ = true;
+        return false;
+      }
+      chunk_streams_.emplace_back();
+      state = &chunk_streams_.back();
+      state->csid = csid;
+    }
+    ChunkState &cs = *state;
+
+    // message header, applied only once the whole chunk is available
+    const char *h = p + pos;
+    bool extended = cs.extended_timestamp;
+    uint32_t timestamp_field = cs.timestamp_field;
+    uint32_t length = cs.length;
+    uint8_t type = cs.type;
+    uint32_t stream_id = cs.stream_id;
+    if (fmt <= 2) {
+      timestamp_field = FlvCommonUtils::ReadUInt24BE(h);
+      extended = timestamp_field == 0xFFFFFF;
+    }
+    if (fmt <= 1) {
+      length = FlvCommonUtils::ReadUInt24BE(h + 3);
+      type = static_cast<uint8_t>(h[6]);
+    }
+    if (fmt == 0) {
+      stream_id = ReadUInt32LE(h + 7);
+    }
+    pos += kMessageHeaderLength[fmt];
+    if (extended) {
+      if (avail < pos + 4) {
+        break;
+      }
+      if (fmt <= 2) {
+        timestamp_field = FlvCommonUtils::ReadUInt32BE(p + pos);
+      }
+      pos += 4;
+    }
+
+    // a new header while a message is incomplete abandons it
+    uint32_t received = fmt == 3 ? cs.received : 0;
+    uint32_t body = std::min(chunk_size_, length - received);
+    if (avail < pos + static_cast<int>(body)) {
+      break;
+    }
+
+    cs.initialized = true;
+    cs.extended_timestamp = extended;
+    cs.timestamp_field = timestamp_field;
+    cs.length = length;
+    cs.type = type;
+    cs.stream_id = stream_id;
+    if (received == 0) {
+      cs.timestamp =
+          fmt == 0 ? timestamp_field : cs.timestamp + timestamp_field;
+    }
+    begin_ += pos + static_cast<int>(body);
+
+    if (received == 0 && body == length) {
+      // whole message in one chunk, decode in place
+      cs.received = 0;
+      if (!handleMessage(type, stream_id, cs.timestamp, p + pos, length)) {
+        return false;
+      }
+      continue;
+    }
+    if (received == 0) {
+      // buffers are kept for reuse, so their capacity is what stays buffered
+      size_t capacity = cs.payload.capacity();
+      if (length > capacity &&
+          reassembly_bytes_ + (length - capacity) > kMaxReassemblyBytes) {
+        error_ = true;
+        return false;
+      }
+      cs.payload.reserve(length); // exactly, unlike growing by `resize`
+      reassembly_bytes_ += cs.payload.capacity() - capacity;
+      cs.payload.resize(length);
+    }
+    memcpy(cs.payload.data() + received, p + pos, body);
+    cs.received = received + body;
+    if (cs.received == length) {
+      cs.received = 0;
+      if (!handleMessage(type, stream_id, cs.timestamp, cs.payload.data(),
+                         length)) {
+        return false;
+      }
+    }
+  }
+  return !error_;
+}
+
+RTMPChunkStream::ChunkState *RTMPChunkStream::findChunkStream(uint32_t csid) {
+  for (auto &cs : chunk_streams_) {
+    if (cs.csid == csid) {
+      return &cs;
+    }
+  }
+  return nullptr;
+}
+
+bool RTMPChunkStream::handleMessage(uint8_t type, uint32_t stream_id,
+                                    uint32_t timestamp, const char *payload,
+                                    uint32_t len) {
+  ++messages_;
+  switch (type) {
+  case kRTMPMessageTypeSetChunkSize: {
+    if (len < 4) {
+      return false;
+    }
+    uint32_t chunk_size = FlvCommonUtils::ReadUInt32BE(payload) & 0x7FFFFFFF;
+    if (chunk_size > kMaxChunkSize) {
+      error_ = true; // clamping would misparse the following chunks
+      return false;
+    }
+    chunk_size_ = std::max(chunk_size, 1u);
+    return true;
+  }
+  case kRTMPMessageTypeAbort:
+    if (len >= 4) {
+      uint32_t csid = FlvCommonUtils::ReadUInt32BE(payload);
+      ChunkState *state = findChunkStream(csid);
+      if (state) {
+        state->received = 0;
+      }
+    }
+    return true;
+  case kRTMPMessageTypeWindowAckSize:
+    if (len >= 4) {
+      window_ack_size_ = FlvCommonUtils::ReadUInt32BE(payload);
+    }
+    return true;
+  case kRTMPMessageTypeUserControl: {
+    if (len < 6) {
+      return true;
+    }
+    uint32_t event = FlvCommonUtils::ReadUInt16BE(payload);
+    uint32_t value = FlvCommonUtils::ReadUInt32BE(payload + 2);
+    if (event == kRTMPUserControlPingRequest) {
+      return sendUserControl(kRTMPUserControlPingResponse, value, 0, false);
+    }
+    if (event == kRTMPUserControlStreamEOF && connected_ &&
+        value == static_cast<uint32_t>(message_stream_id_)) {
+      eof_ = true;
+    }
+    return true;
+  }
+  case kRTMPMessageTypeAudio:
+  case kRTMPMessageTypeVideo:
+  case kRTMPMessageTypeDataAMF0:
+    deliver(type, timestamp, payload, len);
+    return true;
+  case kRTMPMessageTypeDataAMF3:
+    if (len > 0) { // AMF0 encoded after a format byte
+      deliver(kFlyTagTypeScriptData, timestamp, payload + 1, len - 1);
+    }
+    return true;
+  case kRTMPMessageTypeCommandAMF0:
+    return handleCommand(payload, len);
+  case kRTMPMessageTypeCommandAMF3:
+    return len == 0 || handleCommand(payload + 1, len - 1);
+  case kRTMPMessageTypeAggregate:
+    return handleAggregate(timestamp, payload, len);
+  default: // acknowledgement, peer bandwidth, shared object...
+    return true;
+  }
+}
+
+bool RTMPChunkStream::handleCommand(const char *payload, uint32_t len) {
+  CommandVisitor command;
+  if (decoder_.Decode(payload, len, &command) != kFlvErrorOK) {
+    return true; // unknown extensions are not fatal
+  }
+
+  if (command.name == "_result" || command.name == "_error") {
+    bool ok = command.name == "_result";
+    if (command.transaction_id == 1) { // connect
+      connected_ = ok;
+    } else if (command.transaction_id == 2 && ok) { // createStream
+      message_stream_id_ = command.result;
+    }
+    error_ = error_ || !ok;
+  } else if (command.name == "onStatus") {
+    if (command.level == "error") {
+      error_ = true;
+    } else if (command.code == "NetStream.Play.Stop" ||
+               command.code == "NetStream.Play.Complete" ||
+               command.code == "NetStream.Play.UnpublishNotify") {
+      eof_ = true;
+    } else if (command.code == "NetStream.Publish.Start") {
+      publishing_ = publish_;
+    }
+  }
+  return !error_;
+}
+
+bool RTMPChunkStream::handleAggregate(uint32_t timestamp, const char *payload,
+                                      uint32_t len) {
+  // FLV tags with back pointers, timestamps relative to the message's
+  const char *p = payload;
+  const char *end = payload + len;
+  bool first = true;
+  uint32_t first_timestamp = 0;
+  while (end - p >= FlvTagView::kTagHeaderLength) {
+    FlvTagView view;
+    FlvTagParseResult result =
+        FlvTagView::TryParse(p, static_cast<int>(end - p), &view);
+    if (result.status != kFlvErrorOK) {
+      return result.status == kFlvErrorBufferEmptyOrTooLessData ||
+             result.status == kFlvErrorNotImplemented; // skip the rest
+    }
+    if (first) {
+      first_timestamp = view.timestamp;
+      first = false;
+    }
+    view.timestamp = timestamp + (view.timestamp - first_timestamp);
+    if (callback_ && *callback_) {
+      (*callback_)(view);
+    }
+    p += result.consumed + 4;
+  }
+  return true;
+}
+
+void RTMPChunkStream::deliver(uint8_t tag_type, uint32_t timestamp,
+                              const char *payload, uint32_t len) {
+  if (!callback_ || !*callback_ || len == 0) {
+    return;
+  }
+  FlvTagView view;
+  if (FlvTagView::FromPayload(tag_type, timestamp, payload,
+                              static_cast<int>(len),
+                              &view) == kFlvErrorOK) {
+    (*callback_)(view);
+  }
+}
+
+bool RTMPChunkStream::sendMessage(int csid, uint8_t type, uint32_t stream_id,
+                                  const char *payload, int len) {
+  send_buff_.clear();
+  appendMessage(csid, type, 0, stream_id, nullptr, 0, payload, len,
+                &send_buff_);
+  return writeAll(send_buff_.data(), static_cast<int>(send_buff_.size()));
+}
+
+void RTMPChunkStream::appendMessage(int csid, uint8_t type, uint32_t timestamp,
+                                    uint32_t stream_id, const char *prefix,
+                                    int prefix_len, const char *payload,
+                                    int len, std::vector<char> *buff) {
+  // always fmt 0, the 8 bytes a fmt 1 would save hardly matter at 4KB chunks
+  bool extended = timestamp >= 0xFFFFFF;
+  int total = prefix_len + len;
+  buff->push_back(static_cast<char>(csid));
+  AppendUInt(extended ? 0xFFFFFF : timestamp, 3, buff);
+  AppendUInt(total, 3, buff);
+  buff->push_back(static_cast<char>(type));
+  for (int i = 0; i < 4; ++i) { // little-endian
+    buff->push_back(static_cast<char>((stream_id >> (i * 8)) & 0xFF));
+  }
+  if (extended) {
+    AppendUInt(timestamp, 4, buff);
+  }
+
+  int chunk_size = static_cast<int>(out_chunk_size_);
+  for (int offset = 0; offset < total;) {
+    if (offset > 0) {
+      buff->push_back(static_cast<char>(0xC0 | csid)); // fmt 3
+      if (extended) {
+        AppendUInt(timestamp, 4, buff);
+      }
+    }
+    int end = std::min(offset + chunk_size, total);
+    if (offset < prefix_len) {
+      int n = std::min(end, prefix_len) - offset;
+      buff->insert(buff->end(), prefix + offset, prefix + offset + n);
+      offset += n;
+    }
+    if (offset < end) {
+      const char *p = payload + (offset - prefix_len);
+      buff->insert(buff->end(), p, p + (end - offset));
+      offset = end;
+    }
+  }
+}
+
+bool RTMPChunkStream::sendUserControl(uint16_t event, uint32_t value,
+                                      uint32_t value2, bool has_value2) {
+  std::vector<char> payload;
+  AppendUInt(event, 2, &payload);
+  AppendUInt(value, 4, &payload);
+  if (has_value2) {
+    AppendUInt(value2, 4, &payload);
+  }
+  return sendMessage(kCsidProtocolControl, kRTMPMessageTypeUserControl, 0,
+                     payload.data(), static_cast<int>(payload.size()));
+}
+
+bool RTMPChunkStream::sendUInt32(uint8_t type, uint32_t value) {
+  std::vector<char> payload;
+  AppendUInt(value, 4, &payload);
+  return sendMessage(kCsidProtocolControl, type, 0, payload.data(),
+                     static_cast<int>(payload.size()));
+}
+
+bool RTMPChunkStream::writeAll(const char *buff, int len) {
+  while (len > 0) {
+    ssize_t n = send(fd_, buff, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    buff += n;
+    len -= n;
+    bytes_sent_ += n;
+  }
+  return true;
+}
+
+bool RTMPChunkStream::readAll(char *buff, int len) {
+  while (len > 0) {
+    ssize_t n = recv(fd_, buff, len, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    buff += n;
+    len -= n;
+  }
+  return true;
+}
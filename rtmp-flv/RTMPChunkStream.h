@@ -0,0 +1,171 @@
+#ifndef _RTMP_CHUNK_STREAM_H_
+#define _RTMP_CHUNK_STREAM_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "FlvAmf.h"
+#include "FlvStreamDemuxer.h"
+#include "FlvTagView.h"
+
+enum RTMPMessageType {
+  kRTMPMessageTypeSetChunkSize = 1,
+  kRTMPMessageTypeAbort = 2,
+  kRTMPMessageTypeAcknowledgement = 3,
+  kRTMPMessageTypeUserControl = 4,
+  kRTMPMessageTypeWindowAckSize = 5,
+  kRTMPMessageTypeSetPeerBandwidth = 6,
+  kRTMPMessageTypeAudio = 8,
+  kRTMPMessageTypeVideo = 9,
+  kRTMPMessageTypeDataAMF3 = 15,
+  kRTMPMessageTypeCommandAMF3 = 17,
+  kRTMPMessageTypeDataAMF0 = 18,
+  kRTMPMessageTypeCommandAMF0 = 20,
+  kRTMPMessageTypeAggregate = 22,
+};
+
+// In-tree RTMP client for playing or publishing a stream.
+// Does the plain handshake, connect/createStream/play, and parses the chunk
+// stream itself. Audio/video/data message payloads are handed to the FLV tag
+// header decoders as `FlvTagView`s without building an FLV byte stream:
+// messages contained in a single chunk are decoded in place from the receive
+// buffer, others are reassembled once into a per chunk stream buffer. The
+// number of chunk streams and the bytes of these buffers are capped, a peer
+// exceeding them is disconnected.
+// Publishing goes through connect/createStream/publish instead, and chunks the
+// tag bodies straight from the views into one send buffer: with a 4KB chunk
+// size most tags take a single chunk, and a whole batch of tags goes out with
+// one `send`.
+class RTMPChunkStream {
+public:
+  RTMPChunkStream() = default;
+  RTMPChunkStream(const RTMPChunkStream &) = delete;
+  ~RTMPChunkStream() { Close(); }
+
+public:
+  // rtmp://host[:port]/app/stream, false if it can't be parsed
+  bool SetupURL(const std::string &url);
+
+  // Blocking until playing, or publishing if `publish`, or failed,
+  // `timeout_s` applies to every socket operation afterwards as well.
+  bool Connect(int timeout_s, bool publish = false);
+  void Close();
+
+  // Publish mode. Appends the tag as an RTMP message to the send buffer,
+  // which is sent once it grows over `kPublishBatchBytes`. The view only has
+  // to be valid during the call. False on errors.
+  bool WriteTag(const FlvTagView &view);
+  // Sends the buffered messages, and handles whatever the server sent in the
+  // meantime without blocking, e.g. pings or an error status.
+  bool Flush();
+  size_t buffered_bytes() const { return publish_buff_.size(); }
+
+  const static size_t kPublishBatchBytes{64 * 1024};
+
+  // Receives once and delivers all complete audio/video/data messages.
+  // Returns received bytes, 0 when the stream ends, -1 on errors.
+  int Read(const std::function<FlvTagCallback> &callback);
+
+  int Socket() const { return fd_; }
+
+  uint64_t messages() const { return messages_; }
+  uint64_t bytes_received() const { return bytes_received_; }
+  uint64_t bytes_sent() const { return bytes_sent_; }
+
+private:
+  struct ChunkState {
+    uint32_t csid{0};
+    bool initialized{false}; // once the first chunk has been parsed
+    bool extended_timestamp{false};
+    uint32_t timestamp_field{0}; // of the latest header, after extension
+    uint32_t timestamp{0};       // of the current message
+    uint32_t length{0};
+    uint8_t type{0};
+    uint32_t stream_id{0};
+    uint32_t received{0};
+    std::vector<char> payload; // reassembled message, reused
+  };
+
+  bool handshake();
+  bool sendConnect();
+  bool sendCreateStream();
+  bool sendPlay();
+  bool sendPublish();
+  bool sendDeleteStream();
+  // receive and handle messages until `done` returns true
+  bool waitFor(const std::function<bool()> &done);
+
+  // returns `kReceiveWouldBlock` if `flags` has MSG_DONTWAIT and nothing is
+  // there
+  int receive(int flags = 0);
+  bool parseChunks();
+  // nullptr if the peer hasn't used `csid` yet
+  ChunkState *findChunkStream(uint32_t csid);
+  bool handleMessage(uint8_t type, uint32_t stream_id, uint32_t timestamp,
+                     const char *payload, uint32_t len);
+  bool handleCommand(const char *payload, uint32_t len);
+  bool handleAggregate(uint32_t timestamp, const char *payload, uint32_t len);
+  void deliver(uint8_t tag_type, uint32_t timestamp, const char *payload,
+               uint32_t len);
+
+  bool sendMessage(int csid, uint8_t type, uint32_t stream_id,
+                   const char *payload, int len);
+  // chunks `prefix` followed by `payload` as one message into `buff`
+  void appendMessage(int csid, uint8_t type, uint32_t timestamp,
+                     uint32_t stream_id, const char *prefix, int prefix_len,
+                     const char *payload, int len, std::vector<char> *buff);
+  bool sendCommand(int csid, uint32_t stream_id) {
+    return sendMessage(csid, kRTMPMessageTypeCommandAMF0, stream_id,
+                       encoder_.data().data(),
+                       static_cast<int>(encoder_.data().size()));
+  }
+  bool sendUserControl(uint16_t event, uint32_t value, uint32_t value2,
+                       bool has_value2);
+  bool sendUInt32(uint8_t type, uint32_t value);
+  bool writeAll(const char *buff, int len);
+  bool readAll(char *buff, int len);
+
+private:
+  std::string host_;
+  int port_{1935};
+  std::string app_;
+  std::string stream_;
+  std::string tc_url_;
+
+  int fd_{-1};
+  bool eof_{false};
+  bool error_{false};
+
+  // receive buffer, [begin_, end_) is not parsed yet
+  std::vector<char> buff_;
+  int begin_{0};
+  int end_{0};
+
+  // in order of first use, a handful per connection, so a linear search is
+  // cheaper than indexing by the up to 65599 chunk stream ids
+  std::vector<ChunkState> chunk_streams_;
+  size_t reassembly_bytes_{0}; // capacity of all `payload`s
+  uint32_t chunk_size_{128};
+  uint32_t window_ack_size_{0};
+  uint64_t bytes_received_{0};
+  uint64_t bytes_acked_{0};
+
+  // command state
+  FlvAmfEncoder encoder_;
+  FlvAmfDecoder decoder_;
+  double transaction_id_{0};
+  bool connected_{false};
+  double message_stream_id_{-1};
+  bool publish_{false};
+  bool publishing_{false};
+
+  std::vector<char> send_buff_;
+  std::vector<char> publish_buff_; // batched tags, publish mode
+  uint32_t out_chunk_size_{128};
+  uint64_t bytes_sent_{0};
+  const std::function<FlvTagCallback> *callback_{nullptr};
+  uint64_t messages_{0};
+};
+
+#endif
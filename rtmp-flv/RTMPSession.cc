@@ -3,9 +3,37 @@
 
 #include <librtmp/log.h>
 
-RTMPSession::RTMPSession(std::string url) : url_(url) {
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+RTMPSession::RTMPSession(std::string url, RTMPSessionMode mode,
+                         RTMPSessionRole role)
+    : url_(url), mode_(mode), role_(role) {
+  setup();
+}
+
+RTMPSession::~RTMPSession() {
+  if (rtmp_) {
+    RTMP_Free(rtmp_);
+    rtmp_ = nullptr;
+  }
+}
+
+void RTMPSession::setup() {
+  if (mode_ == kRTMPSessionModeNative) {
+    chunk_stream_.reset(new RTMPChunkStream);
+    if (!chunk_stream_->SetupURL(url_)) {
+      throw kRTMPSessionErrnoSetupURLFailed;
+    }
+    return;
+  }
+
   RTMP_debuglevel = RTMP_LOGINFO;
 
+  if (rtmp_) { // librtmp keeps parts of the previous connection otherwise
+    RTMP_Free(rtmp_);
+  }
   rtmp_ = RTMP_Alloc();
   if (NULL == rtmp_) {
     throw kRTMPSessionErrnoAllocFailed;
@@ -18,20 +46,24 @@ RTMPSession::RTMPSession(std::string url) : url_(url) {
   if (!RTMP_SetupURL(rtmp_, (char *)(url_.c_str()))) {
     throw kRTMPSessionErrnoSetupURLFailed;
   }
-}
-
-RTMPSession::~RTMPSession() {
-  if (rtmp_) {
-    RTMP_Free(rtmp_);
-    rtmp_ = nullptr;
+  if (role_ == kRTMPSessionRolePublish) {
+    RTMP_EnableWrite(rtmp_); // before connecting
   }
 }
 
 void RTMPSession::Connect() {
+  if (chunk_stream_) {
+    if (!chunk_stream_->Connect(10, role_ == kRTMPSessionRolePublish)) {
+      throw kRTMPSessionErrnoConnectFailed;
+    }
+    return;
+  }
 
   rtmp_->Link.timeout = 10;
-  rtmp_->Link.lFlags |= RTMP_LF_LIVE;
-  RTMP_SetBufferMS(rtmp_, 3600 * 1000); // 1hour
+  if (role_ == kRTMPSessionRolePlay) {
+    rtmp_->Link.lFlags |= RTMP_LF_LIVE;
+    RTMP_SetBufferMS(rtmp_, 3600 * 1000); // 1hour
+  }
 
   if (!RTMP_Connect(rtmp_, NULL)) {
     throw kRTMPSessionErrnoConnectFailed;
@@ -43,8 +75,110 @@ void RTMPSession::Connect() {
   }
 }
 
-void RTMPSession::Close() { return RTMP_Close(rtmp_); }
+void RTMPSession::Close() {
+  if (chunk_stream_) {
+    return chunk_stream_->Close();
+  }
+  if (rtmp_) { // null if `setup` failed, e.g. while reconnecting
+    RTMP_Close(rtmp_);
+  }
+}
+
+bool RTMPSession::Reconnect(const RTMPReconnectOptions &options) {
+  int64_t start_us = FlvCommonUtils::GetMonotonicTimeMicroseconds();
+  Close();
+  if (demuxer_) {
+    demuxer_->Reset();
+  }
+
+  double backoff_ms = std::max(options.initial_backoff_ms, 1);
+  std::uniform_real_distribution<double> jitter(
+      1.0 - std::min(std::max(options.jitter, 0.0), 1.0), 1.0);
+  for (int attempt = 0;
+       options.max_attempts <= 0 || attempt < options.max_attempts;
+       ++attempt) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(
+        static_cast<int64_t>(backoff_ms * jitter(random_))));
+    backoff_ms = std::min<double>(backoff_ms * options.multiplier,
+                                  options.max_backoff_ms);
+
+    ++reconnect_stats_.attempts;
+    try {
+      setup();
+      Connect();
+    } catch (RTMPSessionErrorCode e) {
+      continue;
+    }
+
+    int64_t gap_ms =
+        (FlvCommonUtils::GetMonotonicTimeMicroseconds() - start_us) / 1000;
+    ++reconnect_stats_.reconnects;
+    reconnect_stats_.last_gap_ms = gap_ms;
+    reconnect_stats_.max_gap_ms = std::max(reconnect_stats_.max_gap_ms, gap_ms);
+    reconnect_stats_.total_gap_ms += gap_ms;
+    return true;
+  }
+  return false;
+}
 
 int RTMPSession::Read(char *buff, int buff_len) {
+  if (!rtmp_) {
+    return -1;
+  }
   return RTMP_Read(rtmp_, buff, buff_len);
 }
+
+int RTMPSession::ReadTags(const std::function<FlvTagCallback> &callback) {
+  if (chunk_stream_) {
+    return chunk_stream_->Read(callback);
+  }
+
+  if (!demuxer_) {
+    demuxer_.reset(new FlvStreamDemuxer([this](const FlvTagView &view) {
+      if (tag_callback_ && *tag_callback_) {
+        (*tag_callback_)(view);
+      }
+    }));
+    buff_.resize(256 * 1024);
+  }
+  int n = Read(buff_.data(), static_cast<int>(buff_.size()));
+  if (n <= 0) {
+    return n;
+  }
+  tag_callback_ = &callback;
+  FlvErrorCode err = demuxer_->Feed(buff_.data(), n);
+  tag_callback_ = nullptr;
+  return err == kFlvErrorOK ? n : -1;
+}
+
+bool RTMPSession::WriteTag(const FlvTagView &view) {
+  if (chunk_stream_) {
+    return chunk_stream_->WriteTag(view);
+  }
+  if (!rtmp_) {
+    return false;
+  }
+
+  // `RTMP_Write` takes whole FLV tags incl. PreviousTagSize, and prepends
+  // @setDataFrame to script data itself
+  int tag_length = view.tag_length();
+  write_buff_.resize(tag_length + 4);
+  view.WriteHeader(write_buff_.data());
+  std::copy(view.body_pointer(), view.body_pointer() + view.data_size,
+            write_buff_.data() + FlvTagView::kTagHeaderLength);
+  FlvCommonUtils::WriteUInt32BE(static_cast<uint32_t>(tag_length),
+                                write_buff_.data() + tag_length);
+  return RTMP_Write(rtmp_, write_buff_.data(),
+                    static_cast<int>(write_buff_.size())) > 0;
+}
+
+bool RTMPSession::Flush() {
+  if (chunk_stream_) {
+    return chunk_stream_->Flush();
+  }
+  return rtmp_ && RTMP_IsConnected(rtmp_); // sent by `RTMP_Write` already
+}
+
+int RTMPSession::Socket() const {
+  return chunk_stream_ ? chunk_stream_->Socket() : RTMP_Socket(rtmp_);
+}
@@ -1,9 +1,15 @@
-
 #ifndef _RTMP_SESSION_H_
 #define _RTMP_SESSION_H_
 
 #include <librtmp/rtmp.h>
+#include <functional>
+#include <memory>
+#include <random>
 #include <string>
+#include <vector>
+
+#include "FlvStreamDemuxer.h"
+#include "RTMPChunkStream.h"
 
 enum RTMPSessionErrorCode {
   kRTMPSessionErrnoOK = 0,
@@ -14,19 +20,103 @@ enum RTMPSessionErrorCode {
   kRTMPSessionErrnoConnectStreamFailed,
 };
 
+enum RTMPSessionMode {
+  kRTMPSessionModeLibrtmp = 0, // `RTMP_Read` synthesized FLV byte stream
+  kRTMPSessionModeNative,      // in-tree `RTMPChunkStream`, no FLV framing
+};
+
+enum RTMPSessionRole {
+  kRTMPSessionRolePlay = 0,
+  kRTMPSessionRolePublish,
+};
+
+// Backoff between reconnect attempts: starts at `initial_backoff_ms`, grows
+// by `multiplier` per failed attempt up to `max_backoff_ms`, and each delay is
+// randomised down to (1 - `jitter`) of it so that many clients losing the
+// same server don't come back in lockstep. The cap bounds how long after the
+// server recovers the stream resumes.
+struct RTMPReconnectOptions {
+  int max_attempts{10}; // per disconnect, <= 0 retries forever
+  int initial_backoff_ms{500};
+  int max_backoff_ms{8000};
+  double multiplier{2.0};
+  double jitter{0.5};
+};
+
+struct RTMPReconnectStats {
+  uint64_t reconnects{0}; // succeeded
+  uint64_t attempts{0};
+  // from the disconnect being detected until playing again
+  int64_t last_gap_ms{0};
+  int64_t max_gap_ms{0};
+  int64_t total_gap_ms{0};
+};
+
 class RTMPSession {
 public:
-  explicit RTMPSession(std::string url);
+  explicit RTMPSession(std::string url,
+                       RTMPSessionMode mode = kRTMPSessionModeLibrtmp,
+                       RTMPSessionRole role = kRTMPSessionRolePlay);
   ~RTMPSession();
 
   void Connect();
   void Close();
 
+  // Re-establishes the session from scratch after `Read`/`ReadTags` failed or
+  // the stream ended, retrying with backoff, false if all attempts failed.
+  // librtmp mode delivers a new FlvHeader afterwards, `ReadTags` expects it
+  // already, callers of `Read` have to `Reset` their demuxer. Timestamps
+  // restart wherever the server or publisher restarts them.
+  bool Reconnect(const RTMPReconnectOptions &options = RTMPReconnectOptions());
+  const RTMPReconnectStats &reconnect_stats() const {
+    return reconnect_stats_;
+  }
+
+  // FLV byte stream, librtmp mode only.
   int Read(char *buff, int buff_len);
 
+  // Receives once and delivers all complete tags in either mode.
+  // Returns received bytes, 0 at the end of stream, <0 on errors.
+  int ReadTags(const std::function<FlvTagCallback> &callback);
+
+  // Publish role. Sends the tag with the view's timestamp, `RTMP_Write` per
+  // tag in librtmp mode, batched until `Flush` or a full send buffer in
+  // native mode. Pacing is up to the caller, see `FlvTagPacer`.
+  bool WriteTag(const FlvTagView &view);
+  bool Flush();
+
+  // for readiness polling
+  int Socket() const;
+  // librtmp has received bytes or a partial FLV tag buffered internally,
+  // `Read` will consume them without the socket becoming readable again.
+  bool HasBufferedData() const {
+    return rtmp_ && (rtmp_->m_sb.sb_size > 0 || rtmp_->m_read.buflen > 0);
+  }
+  const std::string &url() const { return url_; }
+  RTMPSessionMode mode() const { return mode_; }
+  RTMPSessionRole role() const { return role_; }
+
+private:
+  // (re)creates the librtmp or native client for `url_`, throws on failure
+  void setup();
+
 private:
   RTMP *rtmp_{nullptr};
   std::string url_;
+  RTMPSessionMode mode_;
+  RTMPSessionRole role_;
+
+  std::unique_ptr<RTMPChunkStream> chunk_stream_; // native mode
+
+  // `ReadTags` in librtmp mode
+  std::unique_ptr<FlvStreamDemuxer> demuxer_;
+  std::vector<char> buff_;
+  const std::function<FlvTagCallback> *tag_callback_{nullptr};
+
+  std::vector<char> write_buff_; // one FLV tag for `RTMP_Write`
+
+  RTMPReconnectStats reconnect_stats_;
+  std::mt19937 random_{std::random_device()()};
 };
 
 #endif
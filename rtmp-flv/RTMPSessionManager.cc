@@ -0,0 +1,202 @@
+#include "RTMPSessionManager.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace {
+
+const int kMaxEvents = 64;
+const int kReadBufferSize = 256 * 1024;
+
+} // namespace
+
+RTMPSessionManager::RTMPSessionManager(
+    int loops, std::function<RTMPStreamTagCallback> callback, bool pin_loops)
+    : callback_(callback), pin_loops_(pin_loops) {
+  loops = std::max(loops, 1);
+  for (int i = 0; i < loops; ++i) {
+    std::unique_ptr<Loop> loop(new Loop);
+    loop->index = i;
+    loops_.push_back(std::move(loop));
+  }
+}
+
+RTMPSessionManager::~RTMPSessionManager() {
+  Stop();
+  Wait();
+  for (auto &loop : loops_) {
+    if (loop->epoll_fd >= 0) {
+      close(loop->epoll_fd);
+    }
+    if (loop->wakeup_fd >= 0) {
+      close(loop->wakeup_fd);
+    }
+  }
+  for (auto &stream : streams_) {
+    if (!stream->closed) {
+      stream->session->Close();
+    }
+  }
+}
+
+int RTMPSessionManager::AddStream(const std::string &url,
+                                  RTMPSessionMode mode) {
+  if (started_) {
+    return -1;
+  }
+  std::unique_ptr<Stream> stream(new Stream);
+  stream->index = static_cast<int>(streams_.size());
+  stream->session.reset(new RTMPSession(url, mode));
+  stream->session->Connect();
+
+  Stream *s = stream.get();
+  stream->on_tag = [this, s](const FlvTagView &view) {
+    ++s->tags;
+    if (callback_) {
+      callback_(s->index, view);
+    }
+  };
+  if (mode == kRTMPSessionModeLibrtmp) {
+    stream->demuxer.reset(new FlvStreamDemuxer(stream->on_tag));
+  }
+  streams_.push_back(std::move(stream));
+  return s->index;
+}
+
+bool RTMPSessionManager::Start() {
+  if (started_) {
+    return false;
+  }
+  for (auto &loop : loops_) {
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (loop->epoll_fd < 0 || loop->wakeup_fd < 0) {
+      return false;
+    }
+    struct epoll_event ev {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr; // wakeup
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wakeup_fd, &ev) != 0) {
+      return false;
+    }
+    loop->buff.resize(kReadBufferSize);
+  }
+
+  for (auto &stream : streams_) {
+    Loop *loop = loops_[stream->index % loops_.size()].get();
+    struct epoll_event ev {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = stream.get();
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, stream->session->Socket(),
+                  &ev) != 0) {
+      return false;
+    }
+    ++loop->streams;
+    ++active_streams_;
+  }
+
+  started_ = true;
+  for (auto &loop : loops_) {
+    Loop *l = loop.get();
+    l->thread = std::thread(&RTMPSessionManager::run, this, l);
+    if (pin_loops_) {
+      unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(l->index % cores, &cpus);
+      pthread_setaffinity_np(l->thread.native_handle(), sizeof(cpus), &cpus);
+    }
+  }
+  return true;
+}
+
+void RTMPSessionManager::Stop() {
+  for (auto &loop : loops_) {
+    if (loop->wakeup_fd >= 0) {
+      uint64_t one = 1;
+      ssize_t n = write(loop->wakeup_fd, &one, sizeof(one));
+      (void)n;
+    }
+  }
+}
+
+void RTMPSessionManager::Wait() {
+  for (auto &loop : loops_) {
+    if (loop->thread.joinable()) {
+      loop->thread.join();
+    }
+  }
+}
+
+RTMPStreamStats RTMPSessionManager::stream_stats(int stream) const {
+  const Stream &s = *streams_[stream];
+  return RTMPStreamStats{s.session->url(), s.bytes, s.tags, s.closed,
+                         static_cast<FlvErrorCode>(s.error.load())};
+}
+
+void RTMPSessionManager::run(Loop *loop) {
+  struct epoll_event events[kMaxEvents];
+  while (loop->streams > 0) {
+    int n = epoll_wait(loop->epoll_fd, events, kMaxEvents, -1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    for (int i = 0; i < n; ++i) {
+      Stream *stream = static_cast<Stream *>(events[i].data.ptr);
+      if (!stream) {
+        return; // `Stop`
+      }
+      if (!stream->closed) {
+        readStream(loop, stream);
+      }
+    }
+  }
+}
+
+bool RTMPSessionManager::readStream(Loop *loop, Stream *stream) {
+  if (!stream->demuxer) { // native mode delivers tags itself
+    int n = stream->session->ReadTags(stream->on_tag);
+    if (n <= 0) {
+      closeStream(loop, stream);
+      return false;
+    }
+    stream->bytes += n;
+    return true;
+  }
+
+  do {
+    int n = stream->session->Read(loop->buff.data(),
+                                  static_cast<int>(loop->buff.size()));
+    if (n <= 0) { // EOF or error
+      closeStream(loop, stream);
+      return false;
+    }
+    stream->bytes += n;
+
+    FlvErrorCode err = stream->demuxer->Feed(loop->buff.data(), n);
+    if (err != kFlvErrorOK) {
+      stream->error = err;
+      closeStream(loop, stream);
+      return false;
+    }
+  } while (stream->session->HasBufferedData());
+  return true;
+}
+
+void RTMPSessionManager::closeStream(Loop *loop, Stream *stream) {
+  epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, stream->session->Socket(), nullptr);
+  stream->session->Close();
+  stream->closed = true;
+  --loop->streams;
+  --active_streams_;
+}
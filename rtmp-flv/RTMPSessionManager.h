@@ -0,0 +1,93 @@
+#ifndef _RTMP_SESSION_MANAGER_H_
+#define _RTMP_SESSION_MANAGER_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FlvStreamDemuxer.h"
+#include "RTMPSession.h"
+
+// `stream` is the index returned by `RTMPSessionManager::AddStream`.
+using RTMPStreamTagCallback = void(int stream, const FlvTagView &view);
+
+struct RTMPStreamStats {
+  std::string url;
+  uint64_t bytes;
+  uint64_t tags;
+  bool closed;
+  FlvErrorCode error; // demux error if closed because of bad data
+};
+
+// Pulls many RTMP streams from one process.
+// Streams are distributed over a few event loops, each loop is a thread
+// (optionally pinned to a core) waiting on an epoll set of its sessions'
+// sockets, and feeds received bytes into a per-stream `FlvStreamDemuxer`.
+// Tag callbacks of one stream are always invoked from the same loop thread.
+//
+// librtmp can't resume a partially received RTMP packet after EAGAIN, so the
+// sockets stay blocking: epoll tells which session has data, and a `Read` may
+// only wait for the rest of a packet that already started to arrive.
+class RTMPSessionManager {
+public:
+  RTMPSessionManager(int loops, std::function<RTMPStreamTagCallback> callback,
+                     bool pin_loops = true);
+  RTMPSessionManager(const RTMPSessionManager &) = delete;
+  ~RTMPSessionManager();
+
+public:
+  // Connects `url` synchronously, throws `RTMPSessionErrorCode` on failure.
+  // Streams can only be added before `Start`, -1 afterwards.
+  int AddStream(const std::string &url,
+                RTMPSessionMode mode = kRTMPSessionModeLibrtmp);
+
+  // Starts all loops, returns false if failed to start.
+  bool Start();
+  // Loops stop when all their streams are closed or `Stop` is called.
+  void Stop();
+  void Wait();
+
+  int stream_count() const { return static_cast<int>(streams_.size()); }
+  int active_streams() const { return active_streams_; }
+  RTMPStreamStats stream_stats(int stream) const;
+
+private:
+  struct Stream {
+    int index;
+    std::unique_ptr<RTMPSession> session;
+    std::function<FlvTagCallback> on_tag;
+    std::unique_ptr<FlvStreamDemuxer> demuxer; // librtmp mode
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> tags{0};
+    std::atomic<bool> closed{false};
+    std::atomic<int> error{kFlvErrorOK};
+  };
+
+  struct Loop {
+    int index;
+    int epoll_fd{-1};
+    int wakeup_fd{-1}; // eventfd to interrupt `epoll_wait` on `Stop`
+    int streams{0};    // still open
+    std::vector<char> buff;
+    std::thread thread;
+  };
+
+  void run(Loop *loop);
+  // read until librtmp has nothing buffered, false if the stream is closed
+  bool readStream(Loop *loop, Stream *stream);
+  void closeStream(Loop *loop, Stream *stream);
+
+private:
+  std::function<RTMPStreamTagCallback> callback_;
+  const bool pin_loops_;
+
+  std::vector<std::unique_ptr<Stream>> streams_;
+  std::vector<std::unique_ptr<Loop>> loops_;
+  std::atomic<int> active_streams_{0};
+  bool started_{false};
+};
+
+#endif
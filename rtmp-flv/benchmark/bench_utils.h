@@ -0,0 +1,48 @@
+#ifndef FLV_BENCH_UTILS_H_
+#define FLV_BENCH_UTILS_H_
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+inline bool LoadFile(const std::string &path, std::vector<char> *data) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    std::cout << "Open file " << path << " failed" << std::endl;
+    return false;
+  }
+  data->assign(std::istreambuf_iterator<char>(in),
+               std::istreambuf_iterator<char>());
+  return true;
+}
+
+class Stopwatch {
+public:
+  Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+
+  double ElapsedSeconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start_)
+        .count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+inline void Report(const std::string &name, double seconds, uint64_t items,
+                   uint64_t bytes) {
+  std::cout << name << ": " << seconds * 1000 << " ms, "
+            << items / seconds / 1000000 << " M tags/s, "
+            << bytes / seconds / (1024 * 1024) << " MB/s, "
+            << bytes * 8 / seconds / 1000000000 << " Gbps" << std::endl;
+}
+
+} // namespace bench
+
+#endif
@@ -0,0 +1,124 @@
+// Decodes a synthetic onMetaData script tag with a large keyframe index and
+// reports throughput and heap allocations per decode.
+//
+// Usage: flv_amf_bench [keyframes] [iterations]
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <new>
+
+#include "FlvAmf.h"
+#include "bench_utils.h"
+
+using namespace std;
+
+static atomic<uint64_t> g_allocations{0};
+
+void *operator new(size_t size) {
+  ++g_allocations;
+  void *p = malloc(size ? size : 1);
+  if (!p) {
+    throw bad_alloc();
+  }
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static void PutU16(string *out, uint16_t v) {
+  out->push_back(static_cast<char>(v >> 8));
+  out->push_back(static_cast<char>(v));
+}
+static void PutU32(string *out, uint32_t v) {
+  PutU16(out, static_cast<uint16_t>(v >> 16));
+  PutU16(out, static_cast<uint16_t>(v));
+}
+static void PutKey(string *out, const char *key) {
+  PutU16(out, static_cast<uint16_t>(strlen(key)));
+  out->append(key);
+}
+static void PutNumber(string *out, double v) {
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  out->push_back(0x00);
+  PutU32(out, static_cast<uint32_t>(bits >> 32));
+  PutU32(out, static_cast<uint32_t>(bits));
+}
+static void PutObjectEnd(string *out) {
+  PutU16(out, 0);
+  out->push_back(0x09);
+}
+
+// onMetaData as written by yamdi/flvtool2
+static string BuildMetaData(int keyframes) {
+  string out;
+  out.push_back(0x02);
+  PutKey(&out, "onMetaData");
+  out.push_back(0x08);
+  PutU32(&out, 6);
+  PutKey(&out, "duration");
+  PutNumber(&out, keyframes * 2.0);
+  PutKey(&out, "width");
+  PutNumber(&out, 1920);
+  PutKey(&out, "height");
+  PutNumber(&out, 1080);
+  PutKey(&out, "framerate");
+  PutNumber(&out, 60);
+  PutKey(&out, "encoder");
+  out.push_back(0x02);
+  PutKey(&out, "Lavf58.76.100");
+  PutKey(&out, "keyframes");
+  out.push_back(0x03);
+  const char *names[] = {"filepositions", "times"};
+  for (int n = 0; n < 2; ++n) {
+    PutKey(&out, names[n]);
+    out.push_back(0x0A);
+    PutU32(&out, keyframes);
+    for (int i = 0; i < keyframes; ++i) {
+      PutNumber(&out, n == 0 ? 13.0 + i * 1048576.0 : i * 2.0);
+    }
+  }
+  PutObjectEnd(&out);
+  PutObjectEnd(&out);
+  return out;
+}
+
+int main(int argc, char *argv[]) {
+  int keyframes = argc > 1 ? atoi(argv[1]) : 50000;
+  int iterations = argc > 2 ? atoi(argv[2]) : 100;
+
+  string meta = BuildMetaData(keyframes);
+  FlvMetaDataCollector collector;
+
+  // first decode reserves the keyframe vectors
+  if (collector.Collect(meta.data(), static_cast<int>(meta.size())) !=
+          kFlvErrorOK ||
+      collector.meta_data().keyframe_file_positions.size() !=
+          static_cast<size_t>(keyframes) ||
+      collector.meta_data().keyframe_times.size() !=
+          static_cast<size_t>(keyframes) ||
+      collector.meta_data().width != 1920) {
+    cout << "Decode onMetaData failed" << endl;
+    return -1;
+  }
+
+  uint64_t allocations = g_allocations;
+  bench::Stopwatch sw;
+  for (int i = 0; i < iterations; ++i) {
+    collector.Collect(meta.data(), static_cast<int>(meta.size()));
+  }
+  double seconds = sw.ElapsedSeconds();
+  allocations = g_allocations - allocations;
+
+  uint64_t values = static_cast<uint64_t>(keyframes) * 2 * iterations;
+  cout << "onMetaData " << meta.size() << " bytes, " << keyframes
+       << " keyframes, " << iterations << " iterations" << endl;
+  cout << "FlvMetaDataCollector: " << seconds * 1000 / iterations
+       << " ms/decode, " << values / seconds / 1000000 << " M numbers/s, "
+       << meta.size() * iterations / seconds / (1024 * 1024) << " MB/s, "
+       << static_cast<double>(allocations) / iterations
+       << " allocations/decode" << endl;
+  return 0;
+}
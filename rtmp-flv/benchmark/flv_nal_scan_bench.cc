@@ -0,0 +1,161 @@
+// Scans the H.264 NAL units of all video tags of a FLV file, as AVCC straight
+// from the tags and as Annex-B after conversion, with every start code search
+// implementation the CPU supports. Verifies they agree with the scalar one,
+// then measures the throughput of each.
+//
+// Usage: flv_nal_scan_bench <flv_file> [iterations]
+//
+// High bitrate input, e.g.
+// ffmpeg -i ../learn-ffmpeg-libav-the-hard-way/small_bunny_1080p_60fps.mp4
+//        -c copy -f flv bunny_1080p60.flv
+
+#include <stdlib.h>
+
+#include <map>
+
+#include "FlvEsExtractor.h"
+#include "FlvNalScanner.h"
+#include "FlvStreamDemuxer.h"
+#include "bench_utils.h"
+
+using namespace std;
+
+struct Frame {
+  const char *avcc; // into the loaded file
+  int avcc_length;
+  size_t annexb_offset; // in `annexb`
+  int annexb_length;
+};
+
+static uint64_t ScanAll(const vector<Frame> &frames, const vector<char> &annexb,
+                        vector<FlvNalUnit> *units, vector<int> *counts) {
+  uint64_t total = 0;
+  for (auto &f : frames) {
+    int n = FlvNalScanner::ScanAnnexB(annexb.data() + f.annexb_offset,
+                                      f.annexb_length, units->data(),
+                                      static_cast<int>(units->size()));
+    if (counts) {
+      counts->push_back(n);
+      for (int i = 0; i < n && i < static_cast<int>(units->size()); ++i) {
+        counts->push_back((*units)[i].offset);
+        counts->push_back((*units)[i].size);
+      }
+    }
+    total += n;
+  }
+  return total;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cout << "Usage:" << endl;
+    cout << "flv_nal_scan_bench <flv_file> [iterations]" << endl;
+    return 0;
+  }
+  int iterations = argc > 2 ? atoi(argv[2]) : 20;
+
+  vector<char> data;
+  if (!bench::LoadFile(argv[1], &data)) {
+    return -1;
+  }
+
+  // AVCC frames as is, Annex-B frames converted into one contiguous buffer
+  FlvAvcAnnexBConverter converter;
+  vector<Frame> frames;
+  vector<char> annexb;
+  vector<struct iovec> iov;
+  FlvStreamDemuxer demuxer([&](const FlvTagView &view) {
+    if (view.GetTagType() != kFlyTagTypeVideo ||
+        view.video.codec_id != kFlvCodecIDAVC) {
+      return;
+    }
+    iov.clear();
+    if (converter.Convert(view, &iov) != kFlvErrorOK ||
+        view.video.avc_packet_type != kFlvAVCPacketTypeAVCNALU) {
+      return;
+    }
+    Frame f{view.data_pointer, view.data_length, annexb.size(), 0};
+    for (auto &v : iov) {
+      const char *p = static_cast<const char *>(v.iov_base);
+      annexb.insert(annexb.end(), p, p + v.iov_len);
+    }
+    f.annexb_length = static_cast<int>(annexb.size() - f.annexb_offset);
+    frames.push_back(f);
+  });
+  if (demuxer.Feed(data.data(), static_cast<int>(data.size())) !=
+          kFlvErrorOK ||
+      frames.empty()) {
+    cout << "No AVC frames" << endl;
+    return -1;
+  }
+
+  // NAL unit types, e.g. for analytics
+  vector<FlvNalUnit> units(256);
+  map<int, uint64_t> types;
+  uint64_t avcc_bytes = 0;
+  for (auto &f : frames) {
+    int n = FlvNalScanner::ScanAvcc(f.avcc, f.avcc_length,
+                                    converter.nalu_length_size(), units.data(),
+                                    static_cast<int>(units.size()));
+    if (n < 0) {
+      cout << "Invalid AVCC frame" << endl;
+      return -1;
+    }
+    for (int i = 0; i < n && i < static_cast<int>(units.size()); ++i) {
+      ++types[units[i].type];
+    }
+    avcc_bytes += f.avcc_length;
+  }
+  cout << frames.size() << " frames, " << annexb.size() << " bytes Annex-B,"
+       << " NAL unit types:";
+  for (auto &t : types) {
+    cout << " " << t.first << "x" << t.second;
+  }
+  cout << endl;
+
+  // correctness: every implementation against the scalar one
+  vector<int> expected;
+  FlvNalScanner::Use(kFlvNalScannerScalar);
+  ScanAll(frames, annexb, &units, &expected);
+  vector<FlvNalScannerImpl> impls;
+  for (auto impl : {kFlvNalScannerScalar, kFlvNalScannerSSE2,
+                    kFlvNalScannerAVX2, kFlvNalScannerNEON}) {
+    if (!FlvNalScanner::Use(impl)) {
+      continue;
+    }
+    vector<int> actual;
+    ScanAll(frames, annexb, &units, &actual);
+    if (actual != expected) {
+      cout << FlvNalScanner::implementation_name(impl)
+           << " mismatches the scalar scanner" << endl;
+      return -1;
+    }
+    impls.push_back(impl);
+  }
+
+  // throughput
+  uint64_t nals = 0;
+  bench::Stopwatch sw;
+  for (int i = 0; i < iterations; ++i) {
+    for (auto &f : frames) {
+      nals += FlvNalScanner::ScanAvcc(f.avcc, f.avcc_length,
+                                      converter.nalu_length_size(),
+                                      units.data(),
+                                      static_cast<int>(units.size()));
+    }
+  }
+  bench::Report("AVCC", sw.ElapsedSeconds(), nals, avcc_bytes * iterations);
+
+  for (auto impl : impls) {
+    FlvNalScanner::Use(impl);
+    nals = 0;
+    bench::Stopwatch sw;
+    for (int i = 0; i < iterations; ++i) {
+      nals += ScanAll(frames, annexb, &units, nullptr);
+    }
+    bench::Report(string("Annex-B ") + FlvNalScanner::implementation_name(impl),
+                  sw.ElapsedSeconds(), nals,
+                  static_cast<uint64_t>(annexb.size()) * iterations);
+  }
+  return 0;
+}
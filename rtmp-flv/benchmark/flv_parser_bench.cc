@@ -0,0 +1,144 @@
+// Parser throughput at three depths over a FLV file in memory, reported in
+// tags/s and MB/s as the median of several repetitions, each running for at
+// least `min_seconds`:
+//   HeaderOnly  walks the 11 bytes tag headers only
+//   FullParse   `FlvTagView::TryParse` incl. audio/video tag headers, plus
+//               AMF decoding of onMetaData
+//   ParseDump   FullParse + `Dump` of every tag into a discarding ostream,
+//               i.e. the cost of the per-field iostream output
+//
+// Usage: flv_parser_bench <flv_file> [min_seconds] [repetitions]
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <streambuf>
+
+#include "FlvAmf.h"
+#include "FlvHeader.h"
+#include "FlvTag.h"
+#include "FlvTagView.h"
+#include "bench_utils.h"
+
+using namespace std;
+
+static const int kFirstTagOffset =
+    FlvHeader::kFlvHeaderLength + FlvTag::kPreviousTagSizeTypeLength;
+
+class NullBuffer : public streambuf {
+protected:
+  int overflow(int c) override { return c; }
+};
+
+static uint64_t HeaderOnly(const char *buff, int len) {
+  uint64_t tags = 0;
+  int offset = kFirstTagOffset;
+  while (len - offset >= FlvTagView::kTagHeaderLength) {
+    uint8_t tag_type = buff[offset] & 0x1F;
+    if (tag_type != kFlyTagTypeAudio && tag_type != kFlyTagTypeVideo &&
+        tag_type != kFlyTagTypeScriptData) {
+      break;
+    }
+    offset += FlvTagView::kTagHeaderLength +
+              FlvCommonUtils::ReadUInt24BE(buff + offset + 1) +
+              FlvTag::kPreviousTagSizeTypeLength;
+    ++tags;
+  }
+  return tags;
+}
+
+static uint64_t FullParse(const char *buff, int len, bool dump) {
+  uint64_t tags = 0;
+  int offset = kFirstTagOffset;
+  FlvTagView view;
+  FlvMetaDataCollector collector;
+  while (offset < len) {
+    FlvTagParseResult result =
+        FlvTagView::TryParse(buff + offset, len - offset, &view);
+    if (result.status != kFlvErrorOK) {
+      break;
+    }
+    bool meta_data = view.GetTagType() == kFlyTagTypeScriptData &&
+                     collector.Collect(view.data_pointer, view.data_length) ==
+                         kFlvErrorOK;
+    if (dump) {
+      FlvTag(view).Dump();
+      if (meta_data) {
+        collector.meta_data().Dump();
+      }
+    }
+    offset += result.consumed + FlvTag::kPreviousTagSizeTypeLength;
+    ++tags;
+  }
+  return tags;
+}
+
+// repeats `run` for at least `min_seconds`, `repetitions` times
+static void Run(const string &name, const function<uint64_t()> &run,
+                uint64_t bytes_per_run, double min_seconds, int repetitions,
+                ostream &out) {
+  vector<double> seconds_per_run;
+  uint64_t tags_per_run = 0;
+  for (int r = 0; r < repetitions; ++r) {
+    uint64_t runs = 0;
+    bench::Stopwatch sw;
+    do {
+      tags_per_run = run();
+      ++runs;
+    } while (sw.ElapsedSeconds() < min_seconds);
+    seconds_per_run.push_back(sw.ElapsedSeconds() / runs);
+  }
+  sort(seconds_per_run.begin(), seconds_per_run.end());
+  double median = seconds_per_run[seconds_per_run.size() / 2];
+
+  out << left << setw(12) << name << right << setw(12) << fixed
+      << setprecision(3) << median * 1000 << " ms" << setw(12)
+      << setprecision(2) << tags_per_run / median / 1000000 << " M tags/s"
+      << setw(12) << bytes_per_run / median / (1024 * 1024) << " MB/s"
+      << "  (min " << setprecision(3) << seconds_per_run.front() * 1000
+      << " ms, max " << seconds_per_run.back() * 1000 << " ms)" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cout << "Usage:" << endl;
+    cout << "flv_parser_bench <flv_file> [min_seconds] [repetitions]" << endl;
+    return 0;
+  }
+  double min_seconds = argc > 2 ? atof(argv[2]) : 0.5;
+  int repetitions = argc > 3 ? atoi(argv[3]) : 5;
+
+  vector<char> data;
+  if (!bench::LoadFile(argv[1], &data)) {
+    return -1;
+  }
+  const char *buff = data.data();
+  int len = static_cast<int>(data.size());
+  if (len < kFirstTagOffset || !FlvHeader(data.data(), len).Verify()) {
+    cout << "Invalid FLV header" << endl;
+    return -1;
+  }
+
+  uint64_t tags = HeaderOnly(buff, len);
+  if (tags == 0 || FullParse(buff, len, false) != tags) {
+    cout << "Header walk and full parse disagree" << endl;
+    return -1;
+  }
+  cout << argv[1] << ": " << tags << " tags, " << len << " bytes, median of "
+       << repetitions << " repetitions" << endl;
+
+  Run("HeaderOnly", [&] { return HeaderOnly(buff, len); }, len, min_seconds,
+      repetitions, cout);
+  Run("FullParse", [&] { return FullParse(buff, len, false); }, len,
+      min_seconds, repetitions, cout);
+
+  // `Dump` writes to std::cout, discard it and report to the real stdout
+  NullBuffer null_buffer;
+  ostream report(cout.rdbuf(&null_buffer));
+  Run("ParseDump", [&] { return FullParse(buff, len, true); }, len,
+      min_seconds, repetitions, report);
+  cout.rdbuf(report.rdbuf());
+  return 0;
+}
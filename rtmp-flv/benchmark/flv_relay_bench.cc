@@ -0,0 +1,98 @@
+// Publishes a FLV file through `FlvRelayHub` to N subscribers, each drained by
+// its own thread, and measures the publish side throughput. One subscriber can
+// be made slow to show that it only drops its own tags. Halfway through, a
+// late subscriber joins and is primed from the GOP cache.
+//
+// Usage: flv_relay_bench <flv_file> [subscribers] [slow_consumer_us]
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "FlvRelayHub.h"
+#include "FlvStreamDemuxer.h"
+#include "bench_utils.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cout << "Usage:" << endl;
+    cout << "flv_relay_bench <flv_file> [subscribers] [slow_consumer_us]"
+         << endl;
+    return 0;
+  }
+  int count = argc > 2 ? atoi(argv[2]) : 16;
+  int slow_us = argc > 3 ? atoi(argv[3]) : 0;
+
+  vector<char> data;
+  if (!bench::LoadFile(argv[1], &data)) {
+    return -1;
+  }
+
+  FlvRelayHub hub{FlvGopCacheOptions()};
+  vector<FlvRelaySubscriberPtr> subscribers;
+  vector<uint64_t> received(count, 0);
+  vector<thread> threads;
+  for (int i = 0; i < count; ++i) {
+    subscribers.push_back(hub.Subscribe());
+    threads.emplace_back([&, i] {
+      while (FlvTagBufferPtr tag = subscribers[i]->Pop()) {
+        ++received[i];
+        if (i == 0 && slow_us > 0) {
+          usleep(slow_us);
+        }
+      }
+    });
+  }
+
+  uint64_t tags = 0;
+  FlvRelaySubscriberPtr late;
+  size_t primed = 0;
+  FlvStreamDemuxer demuxer([&](const FlvTagView &view) {
+    hub.Publish(view);
+    ++tags;
+    if (!late && view.tag_pointer >= data.data() + data.size() / 2) {
+      late = hub.Subscribe();
+      primed = late->queued_tags();
+    }
+  });
+  bench::Stopwatch sw;
+  if (demuxer.Feed(data.data(), static_cast<int>(data.size())) !=
+      kFlvErrorOK) {
+    cout << "Demux failed" << endl;
+  }
+  double seconds = sw.ElapsedSeconds();
+
+  // late subscriber: configs and the GOP are queued, first frame is a keyframe
+  bool keyframe_first = false;
+  while (late) {
+    FlvTagBufferPtr tag = late->TryPop();
+    if (!tag || (tag->view().tag_type == kFlyTagTypeVideo &&
+                 !tag->view().IsVideoSequenceHeader())) {
+      keyframe_first = tag && tag->view().IsVideoKeyFrame();
+      break;
+    }
+  }
+  hub.Close();
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  bench::Report("FlvRelayHub publish, " + to_string(count) + " subscribers",
+                seconds, tags, static_cast<uint64_t>(data.size()));
+  cout << "late subscriber: " << primed << " tags queued on subscribe, "
+       << (keyframe_first ? "starts" : "doesn't start")
+       << " with a keyframe" << endl;
+  cout << "tag buffers: " << hub.pool()->allocations() << " allocated, "
+       << hub.pool()->reuses() << " reused" << endl;
+  for (int i = 0; i < count; ++i) {
+    if (received[i] != tags || i == 0) {
+      cout << "subscriber " << i << ": received " << received[i] << "/" << tags
+           << ", dropped " << subscribers[i]->dropped_tags() << " in "
+           << subscribers[i]->drops() << " overflows" << endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+// Feeds a FLV file to `FlvStreamDemuxer` in randomly sized chunks, verifies
+// the emitted tags are identical to whole-file parsing, then measures the
+// throughput.
+//
+// Usage: flv_stream_demuxer_bench <flv_file> [max_chunk_bytes] [iterations]
+
+#include <stdlib.h>
+
+#include <random>
+
+#include "FlvStreamDemuxer.h"
+#include "bench_utils.h"
+
+using namespace std;
+
+struct TagRecord {
+  uint8_t tag_type;
+  uint32_t timestamp;
+  uint32_t data_size;
+  uint64_t hash; // FNV-1a of the whole tag
+
+  bool operator==(const TagRecord &o) const {
+    return tag_type == o.tag_type && timestamp == o.timestamp &&
+           data_size == o.data_size && hash == o.hash;
+  }
+};
+
+static uint64_t Fnv1a(const char *p, int len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (int i = 0; i < len; ++i) {
+    h = (h ^ static_cast<uint8_t>(p[i])) * 1099511628211ULL;
+  }
+  return h;
+}
+
+static vector<int> RandomChunks(size_t total, int max_chunk, unsigned seed) {
+  mt19937 rng(seed);
+  uniform_int_distribution<int> dist(1, max_chunk);
+  vector<int> chunks;
+  while (total > 0) {
+    int n = static_cast<int>(min<size_t>(dist(rng), total));
+    chunks.push_back(n);
+    total -= n;
+  }
+  return chunks;
+}
+
+static bool Collect(const vector<char> &data, const vector<int> &chunks,
+                    vector<TagRecord> *records) {
+  FlvStreamDemuxer demuxer([records](const FlvTagView &view) {
+    records->push_back(TagRecord{view.tag_type, view.timestamp, view.data_size,
+                                 Fnv1a(view.tag_pointer, view.tag_length())});
+  });
+  const char *p = data.data();
+  for (int n : chunks) {
+    if (demuxer.Feed(p, n) != kFlvErrorOK) {
+      return false;
+    }
+    p += n;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cout << "Usage:" << endl;
+    cout << "flv_stream_demuxer_bench <flv_file> [max_chunk_bytes] [iterations]"
+         << endl;
+    return 0;
+  }
+  int max_chunk = argc > 2 ? atoi(argv[2]) : 64 * 1024;
+  int iterations = argc > 3 ? atoi(argv[3]) : 10;
+
+  vector<char> data;
+  if (!bench::LoadFile(argv[1], &data)) {
+    return -1;
+  }
+
+  // correctness: whole file vs random chunks
+  vector<TagRecord> whole, chunked;
+  if (!Collect(data, vector<int>{static_cast<int>(data.size())}, &whole) ||
+      !Collect(data, RandomChunks(data.size(), max_chunk, 1), &chunked)) {
+    cout << "Demux failed" << endl;
+    return -1;
+  }
+  if (whole.empty() || whole != chunked) {
+    cout << "Mismatch: whole file " << whole.size() << " tags, chunked "
+         << chunked.size() << " tags" << endl;
+    return -1;
+  }
+  cout << "verified " << whole.size() << " tags, max chunk " << max_chunk
+       << " bytes" << endl;
+
+  // throughput
+  vector<int> chunks = RandomChunks(data.size(), max_chunk, 2);
+  uint64_t tags = 0;
+  bench::Stopwatch sw;
+  for (int i = 0; i < iterations; ++i) {
+    FlvStreamDemuxer demuxer([&tags](const FlvTagView &view) { ++tags; });
+    const char *p = data.data();
+    for (int n : chunks) {
+      demuxer.Feed(p, n);
+      p += n;
+    }
+  }
+  bench::Report("FlvStreamDemuxer", sw.ElapsedSeconds(), tags,
+                static_cast<uint64_t>(data.size()) * iterations);
+  return 0;
+}
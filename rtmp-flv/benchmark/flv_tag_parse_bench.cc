@@ -0,0 +1,99 @@
+// Compares the legacy throwing `FlvTag` against the non-allocating
+// `FlvTagView::TryParse` by walking all tags of a FLV file in memory.
+//
+// Usage: flv_tag_parse_bench <flv_file> [iterations]
+
+#include <stdlib.h>
+
+#include "FlvHeader.h"
+#include "FlvTag.h"
+#include "FlvTagView.h"
+#include "bench_utils.h"
+
+using namespace std;
+
+struct WalkResult {
+  uint64_t tags{0};
+  uint64_t checksum{0};
+};
+
+static WalkResult WalkWithFlvTag(char *buff, int len) {
+  WalkResult r;
+  int offset = FlvHeader::kFlvHeaderLength + FlvTag::kPreviousTagSizeTypeLength;
+  while (offset < len) {
+    try {
+      FlvTag ft(buff + offset, len - offset);
+      r.checksum += ft.view().timestamp + ft.GetTagDataLength();
+      ++r.tags;
+      offset += ft.cost_bytes() + FlvTag::kPreviousTagSizeTypeLength;
+    } catch (FlvException &e) {
+      break;
+    }
+  }
+  return r;
+}
+
+static WalkResult WalkWithFlvTagView(const char *buff, int len) {
+  WalkResult r;
+  int offset = FlvHeader::kFlvHeaderLength + FlvTag::kPreviousTagSizeTypeLength;
+  FlvTagView view;
+  while (offset < len) {
+    FlvTagParseResult result =
+        FlvTagView::TryParse(buff + offset, len - offset, &view);
+    if (result.status != kFlvErrorOK) {
+      break;
+    }
+    r.checksum += view.timestamp + view.data_length;
+    ++r.tags;
+    offset += result.consumed + FlvTag::kPreviousTagSizeTypeLength;
+  }
+  return r;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cout << "Usage:" << endl;
+    cout << "flv_tag_parse_bench <flv_file> [iterations]" << endl;
+    return 0;
+  }
+  int iterations = argc > 2 ? atoi(argv[2]) : 10;
+
+  vector<char> data;
+  if (!bench::LoadFile(argv[1], &data)) {
+    return -1;
+  }
+  int len = static_cast<int>(data.size());
+  FlvHeader fh(data.data(), len);
+  if (!fh.Verify()) {
+    cout << "Invalid FLV header" << endl;
+    return -1;
+  }
+
+  WalkResult legacy, view;
+  bench::Stopwatch sw_legacy;
+  for (int i = 0; i < iterations; ++i) {
+    legacy = WalkWithFlvTag(data.data(), len);
+  }
+  double legacy_seconds = sw_legacy.ElapsedSeconds();
+
+  bench::Stopwatch sw_view;
+  for (int i = 0; i < iterations; ++i) {
+    view = WalkWithFlvTagView(data.data(), len);
+  }
+  double view_seconds = sw_view.ElapsedSeconds();
+
+  if (legacy.tags != view.tags || legacy.checksum != view.checksum) {
+    cout << "Mismatch: FlvTag " << legacy.tags << " tags, FlvTagView "
+         << view.tags << " tags" << endl;
+    return -1;
+  }
+
+  cout << "tags per iteration: " << view.tags << ", iterations: " << iterations
+       << endl;
+  bench::Report("FlvTag", legacy_seconds, legacy.tags * iterations,
+                static_cast<uint64_t>(len) * iterations);
+  bench::Report("FlvTagView", view_seconds, view.tags * iterations,
+                static_cast<uint64_t>(len) * iterations);
+  cout << "speedup: " << legacy_seconds / view_seconds << "x" << endl;
+  return 0;
+}
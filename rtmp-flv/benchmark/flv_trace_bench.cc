@@ -0,0 +1,93 @@
+// Per tag cost on the receiving thread of `FlvTag::Dump` (iostream, flushed
+// per line) versus `FlvTraceWriter` in binary and NDJSON format, the trace
+// writer encodes and writes on its own thread. Output goes to /dev/null.
+//
+// Usage: flv_trace_bench <flv_file> [iterations]
+
+#include <stdlib.h>
+
+#include <fstream>
+
+#include "FlvCommon.h"
+#include "FlvHeader.h"
+#include "FlvTag.h"
+#include "FlvTagView.h"
+#include "FlvTrace.h"
+#include "bench_utils.h"
+
+using namespace std;
+
+static void RunTrace(const string &name, FlvTraceFormat format,
+                     const vector<FlvTagView> &views, int iterations) {
+  FlvTraceWriter::Options options;
+  options.format = format;
+  FlvTraceWriter writer;
+  if (!writer.Open("/dev/null", options)) {
+    cout << "Open /dev/null failed" << endl;
+    return;
+  }
+  bench::Stopwatch sw;
+  for (int i = 0; i < iterations; ++i) {
+    for (auto &view : views) {
+      writer.Write(FlvTraceRecord::FromView(
+          view, 0, FlvCommonUtils::GetMonotonicTimeMicroseconds()));
+    }
+  }
+  double seconds = sw.ElapsedSeconds();
+  writer.Close();
+
+  uint64_t tags = views.size() * iterations;
+  cout << name << ": " << seconds * 1e9 / tags << " ns/tag, "
+       << writer.records() << " written, " << writer.dropped() << " dropped"
+       << endl;
+  if (writer.records() + writer.dropped() != tags) {
+    cout << name << ": records lost" << endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cout << "Usage:" << endl;
+    cout << "flv_trace_bench <flv_file> [iterations]" << endl;
+    return 0;
+  }
+  int iterations = argc > 2 ? atoi(argv[2]) : 20;
+
+  vector<char> data;
+  if (!bench::LoadFile(argv[1], &data)) {
+    return -1;
+  }
+  int len = static_cast<int>(data.size());
+  int offset = FlvHeader::kFlvHeaderLength + FlvTag::kPreviousTagSizeTypeLength;
+  vector<FlvTagView> views;
+  FlvTagView view;
+  while (offset < len) {
+    FlvTagParseResult result =
+        FlvTagView::TryParse(data.data() + offset, len - offset, &view);
+    if (result.status != kFlvErrorOK) {
+      break;
+    }
+    views.push_back(view);
+    offset += result.consumed + FlvTag::kPreviousTagSizeTypeLength;
+  }
+  cout << argv[1] << ": " << views.size() << " tags x " << iterations
+       << " iterations" << endl;
+
+  // `Dump` writes to std::cout, send it to /dev/null for the measurement
+  ofstream null_stream("/dev/null");
+  streambuf *cout_buffer = cout.rdbuf(null_stream.rdbuf());
+  bench::Stopwatch sw;
+  for (int i = 0; i < iterations; ++i) {
+    for (auto &v : views) {
+      FlvTag(v).Dump();
+    }
+  }
+  double seconds = sw.ElapsedSeconds();
+  cout.rdbuf(cout_buffer);
+  cout << "Dump: " << seconds * 1e9 / (views.size() * iterations)
+       << " ns/tag" << endl;
+
+  RunTrace("TraceBinary", kFlvTraceFormatBinary, views, iterations);
+  RunTrace("TraceNdjson", kFlvTraceFormatNdjson, views, iterations);
+  return 0;
+}
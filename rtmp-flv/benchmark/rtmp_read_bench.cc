@@ -0,0 +1,75 @@
+// Pulls the same RTMP stream through librtmp (`RTMP_Read` + FlvStreamDemuxer)
+// and through the in-tree RTMPChunkStream, reports CPU time spent per MB of
+// received data for each. The stream should be live for the whole run, e.g.
+// pushed to the nginx-rtmp of this repo by `ffmpeg -re ... -f flv`.
+//
+// Usage: rtmp_read_bench <rtmp_url> [seconds_per_mode]
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include "RTMPSession.h"
+#include "bench_utils.h"
+
+using namespace std;
+
+static double CpuSeconds() {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec +
+         ru.ru_stime.tv_usec / 1e6;
+}
+
+static bool Run(const string &url, RTMPSessionMode mode, double seconds) {
+  const string name =
+      mode == kRTMPSessionModeNative ? "native chunk stream" : "librtmp";
+  try {
+    RTMPSession session(url, mode);
+    session.Connect();
+
+    uint64_t tags = 0;
+    uint64_t payload_bytes = 0;
+    function<FlvTagCallback> on_tag = [&](const FlvTagView &view) {
+      ++tags;
+      payload_bytes += view.data_length;
+    };
+
+    uint64_t bytes = 0;
+    double cpu_start = CpuSeconds();
+    bench::Stopwatch sw;
+    while (sw.ElapsedSeconds() < seconds) {
+      int n = session.ReadTags(on_tag);
+      if (n <= 0) {
+        break;
+      }
+      bytes += n;
+    }
+    double elapsed = sw.ElapsedSeconds();
+    double cpu = CpuSeconds() - cpu_start;
+    session.Close();
+
+    bench::Report(name, elapsed, tags, bytes);
+    cout << name << ": " << tags << " tags, " << payload_bytes
+         << " payload bytes, cpu " << cpu * 1000 << " ms, "
+         << (bytes ? cpu * 1000 / (bytes / (1024.0 * 1024)) : 0)
+         << " cpu ms/MB" << endl;
+  } catch (RTMPSessionErrorCode e) {
+    cout << name << ": connect failed, error code " << static_cast<int>(e)
+         << endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cout << "Usage: rtmp_read_bench <rtmp_url> [seconds_per_mode]" << endl;
+    return 0;
+  }
+  double seconds = argc > 2 ? atof(argv[2]) : 10;
+
+  bool ok = Run(argv[1], kRTMPSessionModeLibrtmp, seconds);
+  ok = Run(argv[1], kRTMPSessionModeNative, seconds) && ok;
+  return ok ? 0 : -1;
+}
@@ -0,0 +1,113 @@
+// libFuzzer target for everything that parses untrusted ingest data: FLV
+// header and tags via both the throwing classes and `FlvTagView`, the
+// streaming demuxer with input split at fuzzer chosen points, AMF script data,
+// codec configs/frames of the elementary stream converters and the NAL
+// scanner. Build with `-DENABLE_FUZZER=ON` and clang, run e.g.
+//   ./flv_parser_fuzzer -dict=flv.dict corpus/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <iostream>
+#include <streambuf>
+#include <vector>
+
+#include "FlvAmf.h"
+#include "FlvEsExtractor.h"
+#include "FlvHeader.h"
+#include "FlvNalScanner.h"
+#include "FlvStreamDemuxer.h"
+#include "FlvTag.h"
+#include "FlvTagView.h"
+
+namespace {
+
+// `Dump` writes to std::cout, discard it
+class NullBuffer : public std::streambuf {
+protected:
+  int overflow(int c) override { return c; }
+};
+
+void ParseTag(const FlvTagView &view, FlvAvcAnnexBConverter *avc,
+              FlvAacAdtsConverter *aac) {
+  static std::vector<struct iovec> iov;
+  static FlvNalUnit units[64];
+
+  FlvTag(view).Dump();
+  if (view.GetTagType() == kFlyTagTypeScriptData) {
+    FlvMetaDataCollector collector;
+    if (collector.Collect(view.data_pointer, view.data_length) ==
+        kFlvErrorOK) {
+      collector.meta_data().Dump();
+    }
+  } else if (view.GetTagType() == kFlyTagTypeVideo) {
+    iov.clear();
+    avc->Convert(view, &iov);
+    if (avc->has_config()) {
+      FlvNalScanner::ScanAvcc(view.data_pointer, view.data_length,
+                              avc->nalu_length_size(), units, 64);
+    }
+    FlvNalScanner::ScanAnnexB(view.data_pointer, view.data_length, units, 64);
+  } else {
+    iov.clear();
+    aac->Convert(view, &iov);
+  }
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  // leaked, std::cout is flushed after static destructors at exit
+  static bool silenced = [] {
+    std::cout.rdbuf(new NullBuffer);
+    return true;
+  }();
+  (void)silenced;
+
+  if (size > 16 * 1024 * 1024) {
+    return 0;
+  }
+  // the legacy classes take non-const buffers
+  std::vector<char> buff(data, data + size);
+  int len = static_cast<int>(size);
+
+  // whole buffer, throwing classes
+  try {
+    FlvHeader header(buff.data(), len);
+    header.Verify();
+    header.Dump();
+  } catch (FlvException &e) {
+  }
+  int offset = FlvHeader::kFlvHeaderLength + FlvTag::kPreviousTagSizeTypeLength;
+  while (offset < len) {
+    try {
+      FlvTag tag(buff.data() + offset, len - offset);
+      tag.Dump();
+      offset += tag.cost_bytes() + FlvTag::kPreviousTagSizeTypeLength;
+    } catch (FlvException &e) {
+      break;
+    }
+  }
+
+  // streaming, split at a point chosen by the last byte so that every prefix
+  // length gets exercised as a partial tag
+  FlvAvcAnnexBConverter avc;
+  FlvAacAdtsConverter aac;
+  FlvStreamDemuxer demuxer(
+      [&](const FlvTagView &view) { ParseTag(view, &avc, &aac); },
+      [](FlvHeader &header) { header.Dump(); });
+  int split = size > 0 ? data[size - 1] % (len + 1) : 0;
+  if (demuxer.Feed(buff.data(), split) == kFlvErrorOK) {
+    demuxer.Feed(buff.data() + split, len - split);
+  }
+
+  // raw RTMP message payloads
+  for (uint8_t tag_type : {kFlyTagTypeAudio, kFlyTagTypeVideo}) {
+    FlvTagView view;
+    if (FlvTagView::FromPayload(tag_type, 0, buff.data(), len, &view) ==
+        kFlvErrorOK) {
+      ParseTag(view, &avc, &aac);
+    }
+  }
+  return 0;
+}
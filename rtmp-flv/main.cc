@@ -2,50 +2,156 @@
 
 #include <assert.h>
 #include <netdb.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
 
 using namespace std;
 
+#include "FlvAmf.h"
+#include "FlvAsyncFileWriter.h"
 #include "FlvCommon.h"
+#include "FlvEsExtractor.h"
 #include "FlvHeader.h"
+#include "FlvHlsSegmenter.h"
+#include "FlvStreamDemuxer.h"
+#include "FlvStreamStats.h"
 #include "FlvTag.h"
+#include "FlvTimestampRebaser.h"
+#include "FlvTrace.h"
 #include "RTMPSession.h"
+#ifdef __linux__
+#include "RTMPSessionManager.h"
+#endif
 
 #define DUMP_FLV_FILE
 
-// TODO: fix raw dump
-//   currently raw audio can not play due to missed ADTS header
-//   raw video can not play due to no sps/pps headers as well as NALU start
-//   header
+// elementary streams, i.e. ADTS AAC and Annex-B H.264
 // #define DUMP_RAW_AUDIO_FILE
 // #define DUMP_RAW_VIDEO_FILE
 
+// re-establish the session with backoff when it drops, tag timestamps are
+// rebased so that everything downstream of the demuxer stays monotonic
+#define AUTO_RECONNECT
+
+// one binary record per received tag, convert with tools/flv_trace_dump
+#define TRACE_TAGS
+
+// live HLS (MPEG-TS segments + rolling playlist) into ./hls/, e.g. served by
+// the `/hls` location of nginx/nginx.conf instead of its own hls module
+// #define DUMP_HLS
+
+#ifdef __linux__
+// monitor many streams from one process, only statistics are printed
+static int PullStreams(int urls, char *url[]) {
+  int loops = std::min<int>(urls, std::thread::hardware_concurrency());
+  std::vector<std::unique_ptr<FlvStreamStats>> stats(urls);
+  for (auto &s : stats) {
+    s.reset(new FlvStreamStats);
+  }
+  // updated from the loop threads, read lock-free below
+  RTMPSessionManager manager(
+      loops, [&stats](int stream, const FlvTagView &view) {
+        stats[stream]->OnTag(view);
+      });
+  for (int i = 0; i < urls; ++i) {
+    try {
+      manager.AddStream(url[i]);
+    } catch (RTMPSessionErrorCode e) {
+      cout << "Init RTMP session " << url[i] << " failed, error code "
+           << static_cast<int>(e) << endl;
+      return -1;
+    }
+  }
+  if (!manager.Start()) {
+    cout << "Start RTMP session manager failed" << endl;
+    return -1;
+  }
+
+  std::vector<uint64_t> last_bytes(manager.stream_count(), 0);
+  while (manager.active_streams() > 0) {
+    sleep(1);
+    std::vector<std::pair<std::string, FlvStreamStatsSnapshot>> snapshots;
+    for (int i = 0; i < manager.stream_count(); ++i) {
+      RTMPStreamStats stream_stats = manager.stream_stats(i);
+      cout << "[" << stream_stats.url << " kbps:"
+           << (stream_stats.bytes - last_bytes[i]) * 8 / 1000
+           << " tags:" << stream_stats.tags;
+      if (stream_stats.closed) {
+        cout << " closed, err: " << stream_stats.error;
+      }
+      cout << "]" << endl;
+      last_bytes[i] = stream_stats.bytes;
+      snapshots.emplace_back(stream_stats.url, stats[i]->Snapshot());
+    }
+
+    // for e.g. node_exporter's textfile collector
+    {
+      std::ofstream prom("rtmp_flv_stats.prom.tmp");
+      FlvStreamStats::DumpPrometheus(snapshots, prom);
+    }
+    rename("rtmp_flv_stats.prom.tmp", "rtmp_flv_stats.prom");
+  }
+  manager.Wait();
+  return 0;
+}
+#endif
+
 int main(int argc, char *argv[]) {
   if (argc < 2) {
     cout << "Usage:" << endl;
-    cout << "librtmp_test <rtmp_url>" << endl;
+    cout << "librtmp_test <rtmp_url> [rtmp_url ...]" << endl;
     return 0;
   }
+#ifdef __linux__
+  if (argc > 2) {
+    return PullStreams(argc - 1, argv + 1);
+  }
+#endif
 
 #ifdef DUMP_FLV_FILE
-  FILE *fp = fopen("test.flv", "wb");
-  if (!fp) {
+  // written from a separate thread, the receive loop doesn't wait for disk.
+  // Tags are re-serialised with rebased timestamps, so that the file stays
+  // a single valid FLV across reconnects.
+  FlvAsyncFileWriter flv_writer;
+  if (!flv_writer.Open("test.flv")) {
     cout << "Open file test.flv failed" << endl;
     return -1;
   }
+  bool flv_header_written = false;
+  bool flv_write_failed = false;
 #endif
+#if defined(DUMP_RAW_AUDIO_FILE) || defined(DUMP_RAW_VIDEO_FILE)
+  std::string aac_file, h264_file;
 #ifdef DUMP_RAW_AUDIO_FILE
-  FILE *fp_aac = fopen("test.aac", "wb");
-  if (!fp_aac) {
-    cout << "Open file test.aac failed" << endl;
+  aac_file = "test.aac";
+#endif
+#ifdef DUMP_RAW_VIDEO_FILE
+  h264_file = "test.h264";
+#endif
+  FlvEsExtractor es_extractor;
+  if (!es_extractor.Open(h264_file, aac_file)) {
+    cout << "Open file " << h264_file << " " << aac_file << " failed" << endl;
     return -1;
   }
 #endif
-#ifdef DUMP_RAW_VIDEO_FILE
-  FILE *fp_h264 = fopen("test.h264", "wb");
-  if (!fp_h264) {
-    cout << "Open file test.h264 failed" << endl;
+
+#ifdef DUMP_HLS
+  FlvHlsSegmenterOptions hls_options;
+  hls_options.directory = "hls";
+  mkdir(hls_options.directory.c_str(), 0755);
+  FlvHlsSegmenter hls_segmenter(hls_options);
+#endif
+
+#ifdef TRACE_TAGS
+  // encoded and written from a separate thread, unlike `FlvTag::Dump`
+  FlvTraceWriter trace_writer;
+  if (!trace_writer.Open("test.trace")) {
+    cout << "Open file test.trace failed" << endl;
     return -1;
   }
 #endif
@@ -63,105 +169,148 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 
+  // parse flv, partial tags are carried over by the demuxer across reads
+  auto on_header = [&](FlvHeader &fh) {
+    fh.Dump();
+#ifdef DUMP_FLV_FILE
+    if (!flv_header_written) { // only the first connection's
+      char header[FlvHeader::kFlvHeaderLength +
+                  FlvTag::kPreviousTagSizeTypeLength]{
+          'F', 'L', 'V', 1, 0, 0, 0, 0, FlvHeader::kFlvHeaderLength,
+          0,   0,   0,   0}; // PreviousTagSize0
+      header[4] = static_cast<char>((fh.AudioExist() ? 0x04 : 0) |
+                                    (fh.VideoExist() ? 0x01 : 0));
+      flv_write_failed = !flv_writer.Write(header, sizeof(header));
+      flv_header_written = true;
+    }
+#endif
+  };
+  FlvTimestampRebaser rebaser;
+  FlvMetaDataCollector meta_data_collector;
+  FlvStreamStats stream_stats;
+  auto on_tag = [&](const FlvTagView &received) {
+    FlvTagView view = received;
+    view.timestamp = rebaser.Rebase(view.tag_type, view.timestamp);
+
+    stream_stats.OnTag(view);
+
+#ifdef DUMP_FLV_FILE
+    char tag_header[FlvTagView::kTagHeaderLength];
+    char previous_tag_size[FlvTag::kPreviousTagSizeTypeLength];
+    view.WriteHeader(tag_header);
+    FlvCommonUtils::WriteUInt32BE(view.tag_length(), previous_tag_size);
+    if (!flv_write_failed &&
+        !(flv_writer.Write(tag_header, sizeof(tag_header)) &&
+          flv_writer.Write(view.body_pointer(), view.data_size) &&
+          flv_writer.Write(previous_tag_size, sizeof(previous_tag_size)))) {
+      cout << "Write file test.flv failed" << endl;
+      flv_write_failed = true;
+    }
+#endif
+
+#ifdef TRACE_TAGS
+    trace_writer.Write(FlvTraceRecord::FromView(
+        view, 0, FlvCommonUtils::GetMonotonicTimeMicroseconds()));
+#endif
+
+    if (view.GetTagType() == kFlyTagTypeScriptData &&
+        meta_data_collector.Collect(view.data_pointer, view.data_length) ==
+            kFlvErrorOK) {
+      meta_data_collector.meta_data().Dump();
+    }
+
+#if defined(DUMP_RAW_AUDIO_FILE) || defined(DUMP_RAW_VIDEO_FILE)
+    FlvErrorCode es_err = es_extractor.OnTag(view);
+    if (es_err != kFlvErrorOK) {
+      cout << "extract elementary stream failed, err: " << es_err << endl;
+    }
+#endif
+#ifdef DUMP_HLS
+    FlvErrorCode hls_err = hls_segmenter.OnTag(view);
+    if (hls_err != kFlvErrorOK) {
+      cout << "HLS segmenting failed, err: " << hls_err << endl;
+    }
+#endif
+  };
+  FlvStreamDemuxer demuxer(on_tag, on_header);
+
   unsigned long long thisRecvedBytes = 0;
   int buff_size = 5 * 1000 * 1000; // 5MB
   char *buff = new char[buff_size];
   memset(buff, 0, buff_size);
 
-  int64_t start_time_us = FlvCommonUtils::GetCurrentTimeMillseconds();
-  int nRead = 0;
-  bool first_read = true;
-  int offset = 0;
-  bool next_previous_tag_size = true;
-  while (nRead = rtmp_session->Read(buff + offset, buff_size - offset)) {
-    cout << "this recv bytes: " << nRead << endl;
-
+  int64_t start_time_us = FlvCommonUtils::GetMonotonicTimeMicroseconds();
+  while (true) {
+    int nRead = rtmp_session->Read(buff, buff_size);
+    FlvErrorCode err = kFlvErrorOK;
+    if (nRead > 0) {
+      cout << "this recv bytes: " << nRead << endl;
+      err = demuxer.Feed(buff, nRead);
+      if (err != kFlvErrorOK) {
+        cout << "FLV demux failed, err: " << err
+             << ", parsed bytes: " << demuxer.parsed_bytes() << endl;
+      }
+    } else {
+      cout << "RTMP read returned " << nRead << endl;
+    }
 #ifdef DUMP_FLV_FILE
-    int nWrite = fwrite(buff + offset, 1, nRead, fp);
-    assert(nWrite == nRead);
-#endif
-
-    // parse flv
-    int useful_bytes = nRead + offset;
-    offset = 0;
-    while (offset < useful_bytes) {
-      try {
-        if (first_read) {
-          FlvHeader fh(buff + offset, useful_bytes - offset);
-          assert(fh.Verify());
-          fh.Dump();
-          offset += fh.cost_bytes();
-        }
-        first_read = false;
-
-        if (next_previous_tag_size) {
-          cout << "previous tag size: "
-               << FlvTag::FetchPreviousTagSize(buff + offset,
-                                               useful_bytes - offset)
-               << endl;
-          offset += FlvTag::kPreviousTagSizeTypeLength;
-        } else {
-          FlvTag ft(buff + offset, useful_bytes - offset);
-          ft.Dump();
-
-#ifdef DUMP_RAW_AUDIO_FILE
-          if (ft.GetTagType() == kFlyTagTypeAudio && ft.GetTagDataLength()) {
-            // TODO: write的ES文件是否正确?? 待验证
-            int es_write =
-                fwrite(ft.GetDataPointer(), 1, ft.GetTagDataLength(), fp_aac);
-            assert(es_write == ft.GetTagDataLength());
-          }
+    if (flv_write_failed) {
+      break;
+    }
 #endif
-#ifdef DUMP_RAW_VIDEO_FILE
-          if (ft.GetTagType() == kFlyTagTypeVideo && ft.GetTagDataLength()) {
-            // TODO: write的ES文件是否正确?? 待验证
-            int es_write =
-                fwrite(ft.GetDataPointer(), 1, ft.GetTagDataLength(), fp_h264);
-            assert(es_write == ft.GetTagDataLength());
-          }
-#endif
-          offset += ft.cost_bytes(); // for header
-        }
-        next_previous_tag_size = !next_previous_tag_size;
-      } catch (FlvException &e) {
-        // cout << "FlvException catched, err:" << e.ErrorCode() << ", msg:" <<
-        // e.msg() << endl;
-        cout << e << endl;
-        cout << "useful bytes: " << useful_bytes << ", offset: " << offset
-             << endl;
-        break;
+    if (nRead <= 0 || err != kFlvErrorOK) {
+#ifdef AUTO_RECONNECT
+      if (rtmp_session->Reconnect()) {
+        // a new FlvHeader follows, timestamps restart wherever they like
+        demuxer.Reset();
+        rebaser.Reset();
+        const RTMPReconnectStats &rs = rtmp_session->reconnect_stats();
+        cout << "[reconnected gap ms:" << rs.last_gap_ms
+             << " reconnects:" << rs.reconnects << " attempts:" << rs.attempts
+             << " max gap ms:" << rs.max_gap_ms
+             << " total gap ms:" << rs.total_gap_ms << "]" << endl;
+        continue;
       }
-    }
-    if (offset >= useful_bytes) {
-      offset = 0;
+      cout << "Reconnect failed" << endl;
+#endif
+      break;
     }
 
     //码率统计
     thisRecvedBytes += nRead;
-    int64_t curr_time_us = FlvCommonUtils::GetCurrentTimeMillseconds();
+    int64_t curr_time_us = FlvCommonUtils::GetMonotonicTimeMicroseconds();
     int64_t delta_us = curr_time_us - start_time_us;
     if (delta_us >= 1000000) {
-      cout << "[rtmp recv kbps:" << thisRecvedBytes * 8 * 1000 / delta_us << "]"
-           << endl;
+      FlvStreamStatsSnapshot ss = stream_stats.Snapshot();
+      cout << "[rtmp recv kbps:" << thisRecvedBytes * 8 * 1000 / delta_us
+           << " video kbps:" << ss.video_bitrate_bps / 1000
+           << " fps:" << ss.video_fps << " gop:" << ss.gop_frames
+           << " keyframe interval ms:" << ss.keyframe_interval_ms
+           << " jitter ms:" << ss.video_jitter_ms
+           << " av drift ms:" << ss.av_drift_ms
+           << " latency ms:" << ss.latency_ms << "]" << endl;
       start_time_us = curr_time_us;
       thisRecvedBytes = 0;
     }
   }
 
 #ifdef DUMP_FLV_FILE
-  if (fp) {
-    fclose(fp);
-  }
+  flv_writer.Close();
+  FlvAsyncFileWriter::Stats ws = flv_writer.stats();
+  cout << "[flv writer bytes:" << ws.bytes_written
+       << " max queue depth:" << ws.max_queue_depth << " stalls:" << ws.stalls
+       << " stall us:" << ws.stall_us << "]" << endl;
 #endif
-#ifdef DUMP_RAW_AUDIO_FILE
-  if (fp_aac) {
-    fclose(fp_aac);
-  }
+#if defined(DUMP_RAW_AUDIO_FILE) || defined(DUMP_RAW_VIDEO_FILE)
+  es_extractor.Close();
 #endif
-#ifdef DUMP_RAW_VIDEO_FILE
-  if (fp_h264) {
-    fclose(fp_h264);
-  }
+#ifdef DUMP_HLS
+  hls_segmenter.Close();
+#endif
+#ifdef TRACE_TAGS
+  trace_writer.Close();
+  cout << "[trace records:" << trace_writer.records()
+       << " dropped:" << trace_writer.dropped() << "]" << endl;
 #endif
 
   if (buff) {
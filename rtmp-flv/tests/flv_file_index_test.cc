@@ -0,0 +1,58 @@
+#include <stdio.h>
+
+#include <string>
+
+#include "FlvFileIndex.h"
+#include "test_utils.h"
+
+// A recording as written by encoders: the AVC sequence header and the end of
+// sequence tag are flagged as keyframes as well, only the IDR frames are seek
+// points.
+static void TestIndexesOnlyPictures() {
+  std::string flv = test::FlvFileHeader();
+  test::AppendTag(&flv, kFlyTagTypeVideo, 0,
+                  test::AvcPayload(kFlvFrameTypeKeyFrame,
+                                   kFlvAVCPacketTypeAVCSequenceHeader,
+                                   std::string("\x01\x64\x00\x1f\xff", 5)));
+  size_t idr0 = test::AppendTag(
+      &flv, kFlyTagTypeVideo, 0,
+      test::AvcPayload(kFlvFrameTypeKeyFrame, kFlvAVCPacketTypeAVCNALU,
+                       test::AvccNalu(5)));
+  test::AppendTag(&flv, kFlyTagTypeVideo, 40,
+                  test::AvcPayload(kFlvFrameTypeInterFrame,
+                                   kFlvAVCPacketTypeAVCNALU,
+                                   test::AvccNalu(1)));
+  size_t idr1 = test::AppendTag(
+      &flv, kFlyTagTypeVideo, 80,
+      test::AvcPayload(kFlvFrameTypeKeyFrame, kFlvAVCPacketTypeAVCNALU,
+                       test::AvccNalu(5)));
+  test::AppendTag(&flv, kFlyTagTypeVideo, 120,
+                  test::AvcPayload(kFlvFrameTypeKeyFrame,
+                                   kFlvAVCPakcetTypeAVCEndOfSequence));
+
+  const std::string file = "flv_file_index_test.flv";
+  EXPECT(test::WriteFile(file, flv));
+
+  FlvFileIndex index;
+  EXPECT(index.Build(file) == kFlvErrorOK);
+  EXPECT(index.tags() == 5);
+  EXPECT(index.previous_tag_size_mismatches() == 0);
+  EXPECT(index.size() == 2);
+  if (index.size() == 2) {
+    EXPECT(index.entries()[0].offset == idr0);
+    EXPECT(index.entries()[0].timestamp == 0);
+    EXPECT(index.entries()[1].offset == idr1);
+    EXPECT(index.entries()[1].timestamp == 80);
+  }
+
+  // seeking past the end lands on the last IDR, not on the EOS tag
+  const FlvKeyframeEntry *entry = index.Seek(1000);
+  EXPECT(entry && entry->offset == idr1);
+
+  remove(file.c_str());
+}
+
+int main() {
+  TestIndexesOnlyPictures();
+  return test::Result("flv_file_index_test");
+}
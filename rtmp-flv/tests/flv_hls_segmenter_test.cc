@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#include "FlvHlsSegmenter.h"
+#include "test_utils.h"
+
+namespace {
+
+const char kName[] = "flv_hls_segmenter_test";
+
+// baseline 1920x1080 SPS/PPS, the content doesn't matter to the segmenter
+const char kAvcConfig[] = "\x01\x42\xc0\x28\xff\xe1\x00\x04\x67\x42\xc0\x28"
+                          "\x01\x00\x04\x68\xce\x3c\x80";
+
+FlvErrorCode SendVideo(FlvHlsSegmenter *segmenter, uint32_t timestamp,
+                       FlvFrameType frame_type, FlvAVCPacketType packet_type,
+                       const std::string &body) {
+  std::string payload = test::AvcPayload(frame_type, packet_type, body);
+  FlvTagView view;
+  FlvErrorCode err =
+      FlvTagView::FromPayload(kFlyTagTypeVideo, timestamp, payload.data(),
+                              static_cast<int>(payload.size()), &view);
+  return err != kFlvErrorOK ? err : segmenter->OnTag(view);
+}
+
+// EXT-X-TARGETDURATION of the playlist on disk, the longest EXTINF in it
+// rounded up in `*max_extinf`
+int TargetDuration(int *max_extinf) {
+  std::ifstream m3u8(std::string(kName) + ".m3u8");
+  std::string line;
+  int target = -1;
+  *max_extinf = 0;
+  while (std::getline(m3u8, line)) {
+    if (line.compare(0, 22, "#EXT-X-TARGETDURATION:") == 0) {
+      target = atoi(line.c_str() + 22);
+    } else if (line.compare(0, 8, "#EXTINF:") == 0) {
+      int extinf = static_cast<int>(atof(line.c_str() + 8) + 0.999);
+      *max_extinf = std::max(*max_extinf, extinf);
+    }
+  }
+  return target;
+}
+
+// A long GOP leaving the playlist window must not lower the target duration.
+void TestTargetDurationNeverDecreases() {
+  FlvHlsSegmenterOptions options;
+  options.name = kName;
+  options.target_duration_ms = 2000;
+  options.playlist_segments = 2;
+  options.keep_segments = 0;
+
+  FlvHlsSegmenter segmenter(options);
+  EXPECT(SendVideo(&segmenter, 0, kFlvFrameTypeKeyFrame,
+                   kFlvAVCPacketTypeAVCSequenceHeader,
+                   std::string(kAvcConfig, sizeof(kAvcConfig) - 1)) ==
+         kFlvErrorOK);
+
+  // keyframes at 0 and then every 2s from 5s on, i.e. a 5s first segment
+  int last_target = 0;
+  for (uint32_t timestamp = 0; timestamp <= 17000; timestamp += 500) {
+    bool key =
+        timestamp == 0 || (timestamp >= 5000 && timestamp % 2000 == 1000);
+    EXPECT(SendVideo(&segmenter, timestamp,
+                     key ? kFlvFrameTypeKeyFrame : kFlvFrameTypeInterFrame,
+                     kFlvAVCPacketTypeAVCNALU,
+                     test::AvccNalu(key ? 5 : 1)) == kFlvErrorOK);
+    if (segmenter.segments() < 2) {
+      continue; // no playlist yet
+    }
+    int max_extinf = 0;
+    int target = TargetDuration(&max_extinf);
+    EXPECT(target >= last_target);
+    EXPECT(target >= max_extinf);
+    last_target = target;
+  }
+  segmenter.Close();
+
+  int max_extinf = 0;
+  EXPECT(TargetDuration(&max_extinf) == 5);
+  EXPECT(max_extinf == 2); // the 5s segment has left the window
+
+  for (uint64_t i = 0; i < segmenter.segments(); ++i) {
+    unlink((std::string(kName) + "-" + std::to_string(i) + ".ts").c_str());
+  }
+  unlink((std::string(kName) + ".m3u8").c_str());
+}
+
+} // namespace
+
+int main() {
+  TestTargetDurationNeverDecreases();
+  return test::Result(kName);
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+
+#include <string>
+
+#include "FlvTagView.h"
+#include "test_utils.h"
+
+namespace {
+
+struct VideoTagHeaderVector {
+  const char *name;
+  std::string body; // video tag data
+  FlvErrorCode status;
+  int frame_type{0};
+  int is_ex_header{0};
+  int packet_type{0}; // AVCPacketType if legacy AVC
+  uint32_t fourcc{0};
+  int composition_time{0};
+  int cost_bytes{0}; // offset of `data_pointer`
+  bool sequence_header{false};
+  bool frame{false};
+};
+
+// One vector per Enhanced RTMP PacketType, legacy AVC and truncated input,
+// decoded the way tags of a RTMP message payload are.
+void TestVideoTagHeaders() {
+  using S = std::string;
+  const VideoTagHeaderVector vectors[] = {
+      {"AVC sequence header", S("\x17\x00\x00\x00\x00\x01\x64", 7),
+       kFlvErrorOK, 1, 0, 0, 0, 0, 5, true, false},
+      {"AVC NALU, cts -33", S("\x27\x01\xFF\xFF\xDF\x00\x00\x00\x02", 9),
+       kFlvErrorOK, 2, 0, 1, 0, -33, 5, false, true},
+      {"HEVC SequenceStart", S("\x90hvc1\x01\x01", 7), kFlvErrorOK, 1, 1,
+       kFlvVideoPacketTypeSequenceStart, kFlvVideoFourCCHEVC, 0, 5, true,
+       false},
+      {"HEVC CodedFrames, cts 66", S("\x91hvc1\x00\x00\x42\x00\x00", 10),
+       kFlvErrorOK, 1, 1, kFlvVideoPacketTypeCodedFrames, kFlvVideoFourCCHEVC,
+       66, 8, false, true},
+      {"HEVC CodedFramesX", S("\xA3hvc1\x00\x00", 7), kFlvErrorOK, 2, 1,
+       kFlvVideoPacketTypeCodedFramesX, kFlvVideoFourCCHEVC, 0, 5, false, true},
+      {"AV1 SequenceEnd", S("\x92" "av01", 5), kFlvErrorOK, 1, 1,
+       kFlvVideoPacketTypeSequenceEnd, kFlvVideoFourCCAV1, 0, 5, false, false},
+      {"AV1 CodedFrames", S("\x91" "av01\x12\x00", 7), kFlvErrorOK, 1, 1,
+       kFlvVideoPacketTypeCodedFrames, kFlvVideoFourCCAV1, 0, 5, false, true},
+      {"AV1 MPEG2TSSequenceStart", S("\x95" "av01\x80", 6), kFlvErrorOK, 1, 1,
+       kFlvVideoPacketTypeMPEG2TSSequenceStart, kFlvVideoFourCCAV1, 0, 5,
+       false, false},
+      {"VP9 CodedFramesX", S("\xA3vp09\x82", 6), kFlvErrorOK, 2, 1,
+       kFlvVideoPacketTypeCodedFramesX, kFlvVideoFourCCVP9, 0, 5, false, true},
+      {"Metadata", S("\xD4hvc1\x02", 6), kFlvErrorOK, 5, 1,
+       kFlvVideoPacketTypeMetadata, kFlvVideoFourCCHEVC, 0, 5, false, false},
+      {"command frame", S("\xD1\x01", 2), kFlvErrorOK, 5, 1,
+       kFlvVideoPacketTypeCodedFrames, 0, 0, 2, false, false},
+      {"truncated FourCC", S("\x90hvc", 4), kFlvErrorTagDataSizeInvalid},
+      {"truncated HEVC cts", S("\x91hvc1\x00\x00", 7),
+       kFlvErrorTagDataSizeInvalid},
+      {"Multitrack, skipped", S("\x96\x00hvc1", 6), kFlvErrorOK, 1, 1, 6, 0, 0,
+       1, false, false},
+  };
+
+  for (auto &v : vectors) {
+    FlvTagView view;
+    FlvErrorCode err = FlvTagView::FromPayload(
+        kFlyTagTypeVideo, 0, v.body.data(), static_cast<int>(v.body.size()),
+        &view);
+    bool ok = err == v.status;
+    if (ok && err == kFlvErrorOK) {
+      const FlvVideoTagHeaderFields &f = view.video;
+      int packet_type = f.is_ex_header ? f.packet_type : f.avc_packet_type;
+      ok = f.frame_type == v.frame_type && f.is_ex_header == v.is_ex_header &&
+           packet_type == v.packet_type && f.fourcc == v.fourcc &&
+           f.composition_time == v.composition_time &&
+           view.data_pointer == v.body.data() + v.cost_bytes &&
+           view.IsVideoSequenceHeader() == v.sequence_header &&
+           view.IsVideoFrame() == v.frame;
+    }
+    if (!ok) {
+      fprintf(stderr, "video tag header vector \"%s\" failed, err %d\n",
+              v.name, err);
+    }
+    EXPECT(ok);
+  }
+}
+
+} // namespace
+
+int main() {
+  TestVideoTagHeaders();
+  return test::Result("flv_video_tag_header_test");
+}
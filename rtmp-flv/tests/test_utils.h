@@ -0,0 +1,95 @@
+#ifndef FLV_TEST_UTILS_H_
+#define FLV_TEST_UTILS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <fstream>
+#include <string>
+
+#include "FlvTagHeader.h"
+#include "FlvTagView.h"
+
+namespace test {
+
+inline int &Failures() {
+  static int failures = 0;
+  return failures;
+}
+
+#define EXPECT(cond)                                                           \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: EXPECT(%s) failed\n", __FILE__, __LINE__,        \
+              #cond);                                                          \
+      ++test::Failures();                                                      \
+    }                                                                          \
+  } while (0)
+
+inline void AppendUint(std::string *out, uint32_t value, int bytes) {
+  for (int i = bytes - 1; i >= 0; --i) {
+    out->push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+  }
+}
+
+// FLV header with audio and video flags, followed by PreviousTagSize0
+inline std::string FlvFileHeader() {
+  std::string out("FLV\x01\x05", 5);
+  AppendUint(&out, 9, 4);
+  AppendUint(&out, 0, 4);
+  return out;
+}
+
+// Appends a tag and its PreviousTagSize, returns the offset of the tag.
+inline size_t AppendTag(std::string *out, FlvTagType type, uint32_t timestamp,
+                        const std::string &payload) {
+  size_t offset = out->size();
+  out->push_back(static_cast<char>(type));
+  AppendUint(out, static_cast<uint32_t>(payload.size()), 3);
+  AppendUint(out, timestamp & 0xFFFFFF, 3);
+  out->push_back(static_cast<char>(timestamp >> 24));
+  AppendUint(out, 0, 3); // stream id
+  out->append(payload);
+  AppendUint(out, static_cast<uint32_t>(out->size() - offset), 4);
+  return offset;
+}
+
+// AVC VideoTagHeader followed by `body`
+inline std::string AvcPayload(FlvFrameType frame_type,
+                              FlvAVCPacketType packet_type,
+                              const std::string &body = std::string()) {
+  std::string out;
+  out.push_back(static_cast<char>((frame_type << 4) | kFlvCodecIDAVC));
+  out.push_back(static_cast<char>(packet_type));
+  AppendUint(&out, 0, 3); // composition time
+  out.append(body);
+  return out;
+}
+
+// length prefixed NAL unit of `nal_unit_type`
+inline std::string AvccNalu(uint8_t nal_unit_type) {
+  std::string out;
+  AppendUint(&out, 4, 4);
+  out.push_back(static_cast<char>(0x60 | nal_unit_type));
+  out.append("\x88\x84\x00", 3);
+  return out;
+}
+
+inline bool WriteFile(const std::string &path, const std::string &data) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(data.data(), data.size());
+  return static_cast<bool>(out);
+}
+
+inline int Result(const char *name) {
+  if (Failures()) {
+    fprintf(stderr, "%s: %d failures\n", name, Failures());
+    return 1;
+  }
+  printf("%s: passed\n", name);
+  return 0;
+}
+
+} // namespace test
+
+#endif
@@ -0,0 +1,68 @@
+// Builds the keyframe index sidecar of a recorded FLV file, or looks up a
+// timestamp in an existing one.
+//
+// Usage:
+//   flv_index <flv_file> [index_file]            build, default <flv_file>.idx
+//   flv_index -s <index_file> <timestamp_ms>     seek
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <iostream>
+
+#include "FlvFileIndex.h"
+
+using namespace std;
+
+static void PrintEntry(const FlvKeyframeEntry *e) {
+  cout << "timestamp " << e->timestamp << " ms, offset " << e->offset
+       << ", frame type " << static_cast<int>(e->frame_type) << endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || (0 == strcmp(argv[1], "-s") && argc < 4)) {
+    cout << "Usage:" << endl;
+    cout << "flv_index <flv_file> [index_file]" << endl;
+    cout << "flv_index -s <index_file> <timestamp_ms>" << endl;
+    return 0;
+  }
+
+  FlvFileIndex index;
+  if (0 == strcmp(argv[1], "-s")) {
+    if (!index.Load(argv[2])) {
+      cout << "Load index " << argv[2] << " failed" << endl;
+      return -1;
+    }
+    const FlvKeyframeEntry *e = index.Seek(strtoul(argv[3], NULL, 10));
+    if (!e) {
+      cout << "No keyframe" << endl;
+      return -1;
+    }
+    PrintEntry(e);
+    return 0;
+  }
+
+  string flv_file = argv[1];
+  string index_file = argc > 2 ? argv[2] : flv_file + ".idx";
+
+  auto start = chrono::steady_clock::now();
+  FlvErrorCode err = index.Build(flv_file);
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  if (err != kFlvErrorOK) {
+    cout << "Build index of " << flv_file << " failed, err: " << err << endl;
+    return -1;
+  }
+  cout << "indexed " << index.tags() << " tags, " << index.size()
+       << " keyframes, " << index.flv_file_size() / seconds / (1024 * 1024)
+       << " MB/s, previous tag size mismatches "
+       << index.previous_tag_size_mismatches() << endl;
+
+  if (!index.Save(index_file)) {
+    cout << "Save index " << index_file << " failed" << endl;
+    return -1;
+  }
+  cout << "saved to " << index_file << endl;
+  return 0;
+}
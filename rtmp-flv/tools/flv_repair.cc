@@ -0,0 +1,125 @@
+// Repairs and re-indexes a recorded FLV file: corrupted bytes found by
+// `FlvVerifier` are skipped, truncated tails dropped, DataSize/PreviousTagSize
+// rewritten, timestamps rebased onto a continuous timeline starting at 0 and
+// an onMetaData with a keyframe index (keyframes.filepositions/times) written
+// at the head of the output.
+// The input is memory mapped, tags are walked twice: tag headers only to count
+// keyframes for the index, then once more to write them out with `writev`
+// straight from the mapping.
+//
+// Usage: flv_repair <input_flv> <output_flv> [--keep-timestamps]
+
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#include "FlvHeader.h"
+#include "FlvMappedFile.h"
+#include "FlvTag.h"
+#include "FlvVerifier.h"
+#include "FlvWriter.h"
+
+using namespace std;
+
+// Calls `fn` for every tag of `file` that survives the `issues`.
+static void WalkTags(const FlvMappedFile &file,
+                     const vector<FlvVerifyIssue> &issues,
+                     const function<void(const FlvTagView &)> &fn) {
+  const char *data = file.data();
+  uint64_t len = file.size();
+  uint64_t p = FlvCommonUtils::ReadUInt32BE(data + 5) + // DataOffset
+               FlvTag::kPreviousTagSizeTypeLength;
+  size_t i = 0;
+  FlvTagView view;
+  while (p < len) {
+    while (i < issues.size() && issues[i].offset < p) {
+      ++i;
+    }
+    if (i < issues.size() && issues[i].offset == p &&
+        issues[i].type == kFlvVerifyIssueCorruption) {
+      p += issues[i].value;
+      continue;
+    }
+    int remain = static_cast<int>(
+        min<uint64_t>(len - p, FlvTagView::kTagHeaderLength + 0xFFFFFF));
+    FlvTagParseResult result = FlvTagView::TryParse(data + p, remain, &view);
+    if (result.status != kFlvErrorOK) {
+      break; // truncated
+    }
+    fn(view);
+    p += result.consumed + FlvTag::kPreviousTagSizeTypeLength;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    cout << "Usage:" << endl;
+    cout << "flv_repair <input_flv> <output_flv> [--keep-timestamps]" << endl;
+    return 0;
+  }
+  bool keep_timestamps = argc > 3 && 0 == strcmp(argv[3], "--keep-timestamps");
+  auto start = chrono::steady_clock::now();
+
+  FlvVerifier verifier(thread::hardware_concurrency());
+  FlvVerifyReport report;
+  FlvErrorCode err = verifier.Verify(argv[1], &report);
+  if (err != kFlvErrorOK) {
+    cout << "Verify " << argv[1] << " failed, err: " << err << endl;
+    return -1;
+  }
+  uint64_t skipped_bytes = 0;
+  for (auto &issue : report.issues) {
+    if (issue.type == kFlvVerifyIssueCorruption ||
+        issue.type == kFlvVerifyIssueTruncated) {
+      skipped_bytes += issue.value;
+    }
+  }
+
+  FlvMappedFile input;
+  if (!input.Open(argv[1], true)) {
+    cout << "Open " << argv[1] << " failed" << endl;
+    return -1;
+  }
+  uint32_t keyframes = 0;
+  bool has_audio = false;
+  bool has_video = false;
+  WalkTags(input, report.issues, [&](const FlvTagView &view) {
+    has_audio |= view.GetTagType() == kFlyTagTypeAudio;
+    has_video |= view.GetTagType() == kFlyTagTypeVideo;
+    keyframes += view.IsVideoKeyFrame() && view.IsVideoFrame();
+  });
+
+  FlvWriterOptions options;
+  options.rebase_timestamps = !keep_timestamps;
+  options.keyframe_index_capacity = keyframes;
+  options.batch_tags = 64; // the mapping outlives the writer
+  FlvWriter writer(options);
+  if (!writer.Open(argv[2], has_audio, has_video)) {
+    cout << "Open " << argv[2] << " failed" << endl;
+    return -1;
+  }
+  WalkTags(input, report.issues, [&](const FlvTagView &view) {
+    if (err == kFlvErrorOK) {
+      err = writer.Write(view);
+    }
+  });
+  if (!writer.Close() || err != kFlvErrorOK) {
+    cout << "Write " << argv[2] << " failed" << endl;
+    return -1;
+  }
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  cout << report.issues.size() << " issues, " << skipped_bytes
+       << " bytes skipped" << endl;
+  cout << writer.tags() << " tags, " << writer.bytes() << " bytes, "
+       << writer.keyframes() << " keyframes indexed, "
+       << writer.rebaser().discontinuities() << " discontinuities, "
+       << writer.rebaser().clamped() << " timestamps clamped" << endl;
+  cout << seconds * 1000 << " ms, " << input.size() / seconds / (1024 * 1024)
+       << " MB/s" << endl;
+  return 0;
+}
@@ -0,0 +1,52 @@
+// Converts a binary tag trace written by `FlvTraceWriter` to NDJSON on stdout,
+// one object per tag, e.g. for `jq` or loading into a dataframe.
+//
+// Usage: flv_trace_dump <trace_file> [stream]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+
+#include "FlvMappedFile.h"
+#include "FlvTrace.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cout << "Usage:" << endl;
+    cout << "flv_trace_dump <trace_file> [stream]" << endl;
+    return 0;
+  }
+  bool filter_stream = argc > 2;
+  uint32_t stream = filter_stream ? strtoul(argv[2], nullptr, 10) : 0;
+
+  FlvMappedFile file;
+  if (!file.Open(argv[1], true)) {
+    cerr << "Open " << argv[1] << " failed" << endl;
+    return -1;
+  }
+  const FlvTraceFileHeader *header =
+      reinterpret_cast<const FlvTraceFileHeader *>(file.data());
+  if (file.size() < sizeof(FlvTraceFileHeader) || !header->Verify()) {
+    cerr << "Invalid trace file " << argv[1] << endl;
+    return -1;
+  }
+  size_t count =
+      (file.size() - sizeof(FlvTraceFileHeader)) / sizeof(FlvTraceRecord);
+  const FlvTraceRecord *records = reinterpret_cast<const FlvTraceRecord *>(
+      file.data() + sizeof(FlvTraceFileHeader));
+
+  char line[256];
+  for (size_t i = 0; i < count; ++i) {
+    if (filter_stream && records[i].stream != stream) {
+      continue;
+    }
+    int n = FlvTraceRecord::FormatJson(records[i], line, sizeof(line));
+    if (n > 0 && n < static_cast<int>(sizeof(line))) {
+      fwrite(line, 1, n, stdout);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,58 @@
+// Verifies a recorded FLV file in parallel and reports corruption, size
+// mismatches, timestamp regressions and truncation.
+//
+// Usage: flv_verify <flv_file> [threads]
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "FlvVerifier.h"
+
+using namespace std;
+
+static const char *IssueName(FlvVerifyIssueType type) {
+  switch (type) {
+  case kFlvVerifyIssueCorruption:
+    return "corruption";
+  case kFlvVerifyIssueSizeMismatch:
+    return "size mismatch";
+  case kFlvVerifyIssueTimestampRegression:
+    return "timestamp regression";
+  case kFlvVerifyIssueTruncated:
+    return "truncated";
+  }
+  return "unknown";
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cout << "Usage:" << endl;
+    cout << "flv_verify <flv_file> [threads]" << endl;
+    return 0;
+  }
+  int threads = argc > 2 ? atoi(argv[2]) : thread::hardware_concurrency();
+
+  FlvVerifier verifier(threads);
+  FlvVerifyReport report;
+  auto start = chrono::steady_clock::now();
+  FlvErrorCode err = verifier.Verify(argv[1], &report);
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  if (err != kFlvErrorOK) {
+    cout << "Verify " << argv[1] << " failed, err: " << err << endl;
+    return -1;
+  }
+
+  for (auto &issue : report.issues) {
+    cout << "offset " << issue.offset << ": " << IssueName(issue.type)
+         << ", value " << issue.value << ", expected " << issue.expected
+         << endl;
+  }
+  cout << report.tags << " tags, " << report.issues.size() << " issues, "
+       << threads << " threads, " << seconds * 1000 << " ms, "
+       << report.bytes / seconds / (1024 * 1024) << " MB/s" << endl;
+  return report.ok() ? 0 : 1;
+}
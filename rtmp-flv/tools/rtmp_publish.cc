@@ -0,0 +1,394 @@
+// Publishes an FLV file to an RTMP server in real time, by default looping
+// forever, optionally as many simulated publishers at once to load test an
+// ingest server, e.g. the local nginx-rtmp.
+// The file is memory mapped and parsed once, all publishers send tags straight
+// from the mapping. A few worker threads drive all publishers: every tag that
+// is due within the next `kSendAheadMs` is written to the session's send
+// buffer, then each publisher's batch goes out with one `send`, and the worker
+// sleeps until the earliest next tag. Loops continue the timeline instead of
+// restarting at 0. A publisher that fails is reconnected from the start of the
+// file after a jittered delay. The blocking handshakes run on a connect thread
+// of each worker, so a slow or refused connect never delays the tags of the
+// other publishers.
+// Stream names are suffixed with "_<index>" if there is more than one.
+//
+// Usage: rtmp_publish <flv_file> <rtmp_url> [publishers] [threads]
+//                     [--librtmp] [--once]
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FlvMappedFile.h"
+#include "FlvTag.h"
+#include "FlvTagPacer.h"
+#include "FlvTimestampRebaser.h"
+#include "RTMPSession.h"
+
+using namespace std;
+
+namespace {
+
+// tags due within this window are sent together
+const int64_t kSendAheadMs = 20;
+// a tag sent later than this counts as late, i.e. the box is overloaded
+const int64_t kLateMs = 100;
+const int64_t kRetryMinMs = 1000;
+const int64_t kRetryMaxMs = 2000;
+const int kReportIntervalS = 5;
+
+atomic<bool> g_stop{false};
+
+struct Stats {
+  atomic<uint64_t> tags{0};
+  atomic<uint64_t> bytes{0};
+  atomic<uint64_t> late_tags{0};
+  atomic<int64_t> max_late_us{0};
+  atomic<uint64_t> failures{0};
+  atomic<int> publishing{0};
+  atomic<int> connecting{0};
+  atomic<int> finished{0};
+};
+
+struct Publisher {
+  string url;
+  unique_ptr<RTMPSession> session;
+  bool connecting{false}; // owned by the connect thread meanwhile
+  bool publishing{false};
+  int64_t retry_us{0};
+  bool finished{false};
+
+  FlvTimestampRebaser rebaser; // one timeline across loops
+  FlvTagPacer pacer;
+  size_t next{0}; // index of the tag after `pending`
+  FlvTagView pending;
+  int64_t due_us{0};
+  int64_t max_due_us{0}; // audio/video interleaving is not lateness
+};
+
+class Worker {
+public:
+  Worker(const vector<FlvTagView> &tags, RTMPSessionMode mode, bool loop,
+         Stats *stats)
+      : tags_(tags), mode_(mode), loop_(loop), stats_(stats) {}
+
+  void Add(const string &url) {
+    publishers_.emplace_back(new Publisher);
+    publishers_.back()->url = url;
+  }
+
+  void Run() {
+    thread connector(&Worker::connectLoop, this);
+    while (!g_stop) {
+      finishConnects();
+      int64_t now = FlvCommonUtils::GetMonotonicTimeMicroseconds();
+      int64_t wake = now + 100 * 1000;
+      for (auto &p : publishers_) {
+        if (!p->finished && !p->connecting) {
+          wake = min(wake, poll(p.get(), now));
+        }
+      }
+      now = FlvCommonUtils::GetMonotonicTimeMicroseconds();
+      if (wake > now) {
+        // a finished connect wakes it up early
+        unique_lock<mutex> lock(mutex_);
+        connected_cv_.wait_for(lock, chrono::microseconds(wake - now),
+                               [this] { return !connected_.empty(); });
+      }
+    }
+
+    {
+      lock_guard<mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    connect_cv_.notify_one();
+    connector.join(); // after an ongoing handshake
+    finishConnects();
+    for (auto &p : publishers_) {
+      if (p->session) {
+        p->session->Flush();
+        p->session->Close();
+      }
+    }
+  }
+
+private:
+  // sends whatever is due, returns when it wants to be polled again
+  int64_t poll(Publisher *p, int64_t now) {
+    if (!p->session) {
+      if (now >= p->retry_us) {
+        startConnect(p);
+      }
+      return p->retry_us;
+    }
+
+    bool sent = false;
+    while (!p->finished && p->due_us <= now + kSendAheadMs * 1000) {
+      p->max_due_us = max(p->max_due_us, p->due_us);
+      int64_t late_us = now - p->max_due_us;
+      if (late_us > kLateMs * 1000) {
+        ++stats_->late_tags;
+      }
+      int64_t max_late_us = stats_->max_late_us;
+      while (late_us > max_late_us &&
+             !stats_->max_late_us.compare_exchange_weak(max_late_us, late_us)) {
+      }
+
+      if (!p->session->WriteTag(p->pending)) {
+        fail(p, now);
+        return p->retry_us;
+      }
+      sent = true;
+      ++stats_->tags;
+      stats_->bytes += p->pending.tag_length();
+      prepare(p);
+    }
+    if (sent && !p->session->Flush()) {
+      fail(p, now);
+      return p->retry_us;
+    }
+    if (p->finished) {
+      p->session->Close();
+      p->session.reset();
+      p->publishing = false;
+      --stats_->publishing;
+      ++stats_->finished;
+    }
+    return p->due_us;
+  }
+
+  // hands `p` to the connect thread, the worker skips it until then
+  void startConnect(Publisher *p) {
+    p->connecting = true;
+    ++stats_->connecting;
+    {
+      lock_guard<mutex> lock(mutex_);
+      to_connect_.push_back(p);
+    }
+    connect_cv_.notify_one();
+  }
+
+  // connect thread, one blocking handshake at a time
+  void connectLoop() {
+    unique_lock<mutex> lock(mutex_);
+    while (true) {
+      connect_cv_.wait(lock,
+                       [this] { return stopping_ || !to_connect_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      Publisher *p = to_connect_.front();
+      to_connect_.pop_front();
+      lock.unlock();
+
+      unique_ptr<RTMPSession> session;
+      try {
+        session.reset(new RTMPSession(p->url, mode_, kRTMPSessionRolePublish));
+        session->Connect();
+      } catch (RTMPSessionErrorCode e) {
+        session.reset();
+      }
+      p->session = std::move(session); // nullptr if failed
+
+      lock.lock();
+      connected_.push_back(p);
+      connected_cv_.notify_one();
+    }
+  }
+
+  // takes back the publishers the connect thread is done with
+  void finishConnects() {
+    vector<Publisher *> done;
+    {
+      lock_guard<mutex> lock(mutex_);
+      done.swap(connected_);
+    }
+    for (Publisher *p : done) {
+      p->connecting = false;
+      --stats_->connecting;
+      if (!p->session) {
+        fail(p, FlvCommonUtils::GetMonotonicTimeMicroseconds());
+        continue;
+      }
+      p->publishing = true;
+      ++stats_->publishing;
+
+      // start over, sequence headers come first
+      p->next = 0;
+      p->rebaser.Reset();
+      p->pacer.Reset();
+      p->max_due_us = 0;
+      prepare(p);
+    }
+  }
+
+  void fail(Publisher *p, int64_t now) {
+    if (p->publishing) {
+      --stats_->publishing;
+    }
+    p->publishing = false;
+    p->session.reset();
+    ++stats_->failures;
+    uniform_int_distribution<int64_t> delay(kRetryMinMs, kRetryMaxMs);
+    p->retry_us = now + delay(random_) * 1000;
+  }
+
+  // next tag of `p` with its output timestamp and due time
+  void prepare(Publisher *p) {
+    if (p->next == tags_.size()) {
+      if (!loop_) {
+        p->finished = true;
+        return;
+      }
+      p->next = 0;
+      p->rebaser.Reset(); // continue after the last tag
+    }
+    p->pending = tags_[p->next++];
+    p->pending.timestamp =
+        p->rebaser.Rebase(p->pending.tag_type, p->pending.timestamp);
+    p->due_us = p->pacer.DueTime(p->pending.timestamp);
+  }
+
+private:
+  const vector<FlvTagView> &tags_;
+  const RTMPSessionMode mode_;
+  const bool loop_;
+  Stats *stats_;
+  vector<unique_ptr<Publisher>> publishers_;
+  mt19937 random_{random_device()()};
+
+  // worker <-> connect thread
+  mutex mutex_;
+  condition_variable connect_cv_;
+  condition_variable connected_cv_;
+  deque<Publisher *> to_connect_;
+  vector<Publisher *> connected_; // connected or failed
+  bool stopping_{false};
+};
+
+void OnSignal(int) { g_stop = true; }
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    cout << "Usage:" << endl;
+    cout << "rtmp_publish <flv_file> <rtmp_url> [publishers] [threads] "
+            "[--librtmp] [--once]"
+         << endl;
+    return 0;
+  }
+  int publishers = 1;
+  int threads = 0;
+  RTMPSessionMode mode = kRTMPSessionModeNative;
+  bool loop = true;
+  int positional = 0;
+  for (int i = 3; i < argc; ++i) {
+    if (0 == strcmp(argv[i], "--librtmp")) {
+      mode = kRTMPSessionModeLibrtmp;
+    } else if (0 == strcmp(argv[i], "--once")) {
+      loop = false;
+    } else if (positional++ == 0) {
+      publishers = max(atoi(argv[i]), 1);
+    } else {
+      threads = max(atoi(argv[i]), 1);
+    }
+  }
+  if (threads == 0) {
+    threads = static_cast<int>(
+        min<unsigned>(publishers, max(thread::hardware_concurrency(), 1u)));
+  }
+  threads = min(threads, publishers);
+
+  FlvMappedFile file;
+  if (!file.Open(argv[1])) {
+    cout << "Open " << argv[1] << " failed" << endl;
+    return -1;
+  }
+  vector<FlvTagView> tags;
+  const char *data = file.data();
+  uint64_t len = file.size();
+  uint64_t p = len > 9 ? FlvCommonUtils::ReadUInt32BE(data + 5) +
+                             FlvTag::kPreviousTagSizeTypeLength
+                       : len;
+  while (p < len) {
+    FlvTagView view;
+    int remain = static_cast<int>(
+        min<uint64_t>(len - p, FlvTagView::kTagHeaderLength + 0xFFFFFF));
+    FlvTagParseResult result = FlvTagView::TryParse(data + p, remain, &view);
+    if (result.status != kFlvErrorOK) {
+      break; // truncated or corrupted, publish what's before
+    }
+    tags.push_back(view);
+    p += result.consumed + FlvTag::kPreviousTagSizeTypeLength;
+  }
+  if (tags.empty()) {
+    cout << "No tags in " << argv[1] << endl;
+    return -1;
+  }
+
+  signal(SIGINT, OnSignal);
+  signal(SIGTERM, OnSignal);
+  signal(SIGPIPE, SIG_IGN); // librtmp sends without MSG_NOSIGNAL
+
+  Stats stats;
+  vector<unique_ptr<Worker>> workers;
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back(new Worker(tags, mode, loop, &stats));
+  }
+  for (int i = 0; i < publishers; ++i) {
+    string url = argv[2];
+    if (publishers > 1) {
+      url += "_" + to_string(i);
+    }
+    workers[i % threads]->Add(url);
+  }
+  cout << tags.size() << " tags, " << publishers << " publishers on "
+       << threads << " threads" << endl;
+
+  vector<thread> worker_threads;
+  for (auto &w : workers) {
+    worker_threads.emplace_back(&Worker::Run, w.get());
+  }
+
+  auto start = chrono::steady_clock::now();
+  uint64_t last_tags = 0;
+  uint64_t last_bytes = 0;
+  while (!g_stop) {
+    for (int i = 0; i < kReportIntervalS * 10 && !g_stop; ++i) {
+      this_thread::sleep_for(chrono::milliseconds(100));
+      g_stop = g_stop || stats.finished == publishers;
+    }
+    uint64_t tags_sent = stats.tags;
+    uint64_t bytes = stats.bytes;
+    double seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << static_cast<int>(seconds) << "s: " << stats.publishing << "/"
+         << publishers << " publishing, " << stats.connecting
+         << " connecting, "
+         << (tags_sent - last_tags) / kReportIntervalS << " tags/s, "
+         << (bytes - last_bytes) * 8 / kReportIntervalS / 1000 << " kbps, "
+         << stats.late_tags << " late tags, max late "
+         << stats.max_late_us / 1000 << " ms, " << stats.failures
+         << " failures" << endl;
+    last_tags = tags_sent;
+    last_bytes = bytes;
+  }
+  for (auto &t : worker_threads) {
+    t.join();
+  }
+  return 0;
+}